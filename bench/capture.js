@@ -0,0 +1,26 @@
+// Times captureActiveWindow() on the current display.
+//   node bench/capture.js [iterations]
+const native = require('node-gyp-build')(require('path').join(__dirname, '..'));
+
+const iterations = Number(process.argv[2] ?? 50);
+const rows = [];
+for (const maxWidth of [0, 1280, 640, 320]) {
+  let first = null;
+  const started = process.hrtime.bigint();
+  for (let i = 0; i < iterations; i += 1) {
+    const shot = native.captureActiveWindow({ maxWidth });
+    if (!shot) {
+      console.error('capture failed (no X11 display or active window?)');
+      process.exit(1);
+    }
+    first = first ?? shot;
+  }
+  const elapsedMs = Number(process.hrtime.bigint() - started) / 1e6;
+  rows.push({
+    maxWidth: maxWidth || 'full',
+    source: `${first.bounds.width}x${first.bounds.height}`,
+    output: `${first.width}x${first.height}`,
+    msPerCapture: Number((elapsedMs / iterations).toFixed(2)),
+  });
+}
+console.table(rows);
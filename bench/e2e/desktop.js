@@ -0,0 +1,137 @@
+// A private desktop for the end-to-end scripts: Xvfb, a session bus with its own AT-SPI
+// bus, a window manager and the GTK fixture (fixture.py). Everything started here is
+// killed when the process exits. Needs Xvfb, dbus-daemon, at-spi2-core, the window
+// manager and python3-gi with GTK 3.
+const { spawn } = require('child_process');
+const fs = require('fs');
+const path = require('path');
+const readline = require('readline');
+
+const children = [];
+process.on('exit', () => {
+  for (const child of children.reverse()) {
+    if (child.exitCode === null) {
+      child.kill('SIGTERM');
+    }
+  }
+});
+for (const signal of ['SIGINT', 'SIGTERM']) {
+  process.on(signal, () => process.exit(130));
+}
+
+function fail(message) {
+  console.error(`e2e: ${message}`);
+  process.exit(1);
+}
+
+function start(command, args, spawnOptions) {
+  const child = spawn(command, args, { stdio: ['ignore', 'ignore', 'inherit'], ...spawnOptions });
+  child.on('error', (error) => fail(`${command}: ${error.message}`));
+  children.push(child);
+  return child;
+}
+
+function firstLine(stream, what) {
+  return new Promise((resolve, reject) => {
+    let buffered = '';
+    const timer = setTimeout(() => reject(new Error(`timed out waiting for ${what}`)), 10000);
+    stream.setEncoding('utf8');
+    stream.on('data', function onData(chunk) {
+      buffered += chunk;
+      const newline = buffered.indexOf('\n');
+      if (newline >= 0) {
+        clearTimeout(timer);
+        stream.off('data', onData);
+        resolve(buffered.slice(0, newline).trim());
+      }
+    });
+  });
+}
+
+function findBusLauncher() {
+  const candidates = [
+    process.env.WIN_TRACE_ATSPI_LAUNCHER,
+    '/usr/libexec/at-spi-bus-launcher',
+    '/usr/lib/at-spi2-core/at-spi-bus-launcher',
+    '/usr/lib/at-spi2/at-spi-bus-launcher',
+    '/usr/lib/x86_64-linux-gnu/at-spi-bus-launcher',
+  ];
+  const found = candidates.find((candidate) => candidate && fs.existsSync(candidate));
+  if (!found) {
+    fail('at-spi-bus-launcher not found; set WIN_TRACE_ATSPI_LAUNCHER');
+  }
+  return found;
+}
+
+// Starts the desktop and points this process's DISPLAY and session bus at it, so require
+// the addon afterwards. Resolves with send(command), which writes one fixture command and
+// resolves with the CLOCK_MONOTONIC time (ns) the fixture applied it at.
+async function startDesktop({ windows = 3, depth = 40, breadth = 5, wm = 'openbox' } = {}) {
+  const xvfb = start('Xvfb', ['-displayfd', '3', '-screen', '0', '1280x800x24', '-nolisten', 'tcp'], {
+    stdio: ['ignore', 'ignore', 'inherit', 'pipe'],
+  });
+  const display = `:${await firstLine(xvfb.stdio[3], 'Xvfb')}`;
+
+  const bus = start('dbus-daemon', ['--session', '--nofork', '--print-address=1'], {
+    stdio: ['ignore', 'pipe', 'inherit'],
+  });
+  const busAddress = await firstLine(bus.stdout, 'dbus-daemon');
+
+  const env = { ...process.env, DISPLAY: display, DBUS_SESSION_BUS_ADDRESS: busAddress, NO_AT_BRIDGE: '0' };
+  delete env.AT_SPI_BUS_ADDRESS;
+  start(findBusLauncher(), ['--launch-immediately', '--a11y=1'], { env });
+  start(wm, [], { env });
+
+  const fixture = start(
+    'python3',
+    [
+      path.join(__dirname, 'fixture.py'),
+      '--windows', String(windows),
+      '--depth', String(depth),
+      '--breadth', String(breadth),
+    ],
+    { env, stdio: ['pipe', 'pipe', 'inherit'] },
+  );
+  const lines = readline.createInterface({ input: fixture.stdout });
+  const pending = [];
+  let ready;
+  const readyPromise = new Promise((resolve) => {
+    ready = resolve;
+  });
+  lines.on('line', (line) => {
+    if (line === 'ready') {
+      ready();
+    } else if (line.startsWith('ok ')) {
+      pending.shift()(BigInt(line.slice(3)));
+    }
+  });
+  fixture.on('exit', (code) => fail(`fixture exited with code ${code}`));
+  await readyPromise;
+
+  // The addon reads both when it first touches X11 and AT-SPI, i.e. after this.
+  Object.assign(process.env, { DISPLAY: display, DBUS_SESSION_BUS_ADDRESS: busAddress });
+  delete process.env.AT_SPI_BUS_ADDRESS;
+
+  return (command) =>
+    new Promise((resolve) => {
+      pending.push(resolve);
+      fixture.stdin.write(`${command}\n`);
+    });
+}
+
+// Parses --name value pairs over defaults; numbers stay numbers.
+function parseOptions(defaults) {
+  const options = { ...defaults };
+  for (let i = 2; i < process.argv.length; i += 2) {
+    const name = process.argv[i].replace(/^--/, '');
+    if (!(name in defaults) || process.argv[i + 1] === undefined) {
+      console.error(`unknown or incomplete option ${process.argv[i]}`);
+      process.exit(2);
+    }
+    const value = process.argv[i + 1];
+    options[name] = typeof defaults[name] === 'number' ? Number(value) : value;
+  }
+  return options;
+}
+
+module.exports = { startDesktop, parseOptions, fail };
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+# GTK fixture for bench/e2e/run.js: browser-like windows, each an address-bar entry below a
+# deep widget tree, driven by one command per line on stdin:
+#   focus <window>          present the window (the window manager sets _NET_ACTIVE_WINDOW)
+#   url <window> <url>      replace the address bar text
+#   churn <window>          replace the deep tree with new widgets (new accessible objects,
+#                           like a browser loading a page)
+# Prints "ready" once the windows are mapped, then "ok <CLOCK_MONOTONIC ns>" as each
+# command is applied.
+import argparse
+import ctypes
+import sys
+import time
+
+import gi
+
+gi.require_version('Gtk', '3.0')
+from gi.repository import GLib, Gtk  # noqa: E402
+
+PR_SET_NAME = 15
+
+
+def parse_args():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--windows', type=int, default=3)
+    parser.add_argument('--depth', type=int, default=40)
+    parser.add_argument('--breadth', type=int, default=5)
+    # /proc/<pid>/comm decides whether win-trace looks for a URL at all.
+    parser.add_argument('--process-name', default='chromium')
+    return parser.parse_args()
+
+
+def deep_tree(depth, breadth):
+    # A chain of boxes, each with `breadth` labels beside the next box. The address bar
+    # goes after it, so the URL search has to walk past every node.
+    root = Gtk.Box(orientation=Gtk.Orientation.VERTICAL)
+    box = root
+    for level in range(depth):
+        for index in range(breadth):
+            box.pack_start(Gtk.Label(label=f'item {level}.{index}'), False, False, 0)
+        child = Gtk.Box(orientation=Gtk.Orientation.HORIZONTAL)
+        box.pack_start(child, False, False, 0)
+        box = child
+    return root
+
+
+def make_window(index, args):
+    window = Gtk.Window(title=f'Fixture window {index}')
+    window.set_default_size(640, 480)
+    window.connect('destroy', Gtk.main_quit)
+    layout = Gtk.Box(orientation=Gtk.Orientation.VERTICAL)
+    scrolled = Gtk.ScrolledWindow()
+    scrolled.add(deep_tree(args.depth, args.breadth))
+    layout.pack_start(scrolled, True, True, 0)
+    entry = Gtk.Entry()
+    entry.get_accessible().set_name('Address and search bar')
+    entry.set_text('about:blank')
+    layout.pack_start(entry, False, False, 0)
+    window.add(layout)
+    window.show_all()
+    return window, entry, scrolled
+
+
+def main():
+    args = parse_args()
+    ctypes.CDLL(None).prctl(PR_SET_NAME, args.process_name.encode()[:15], 0, 0, 0)
+    windows = [make_window(index, args) for index in range(args.windows)]
+
+    def reply(line):
+        sys.stdout.write(line + '\n')
+        sys.stdout.flush()
+
+    def on_command(channel, condition):
+        line = channel.readline()
+        if not line:
+            Gtk.main_quit()
+            return False
+        parts = line.split(maxsplit=2)
+        window, entry, scrolled = windows[int(parts[1])]
+        if parts[0] == 'focus':
+            window.present_with_time(Gtk.get_current_event_time())
+        elif parts[0] == 'url':
+            entry.set_text(parts[2].strip())
+        elif parts[0] == 'churn':
+            scrolled.get_child().destroy()
+            scrolled.add(deep_tree(args.depth, args.breadth))
+            scrolled.show_all()
+        # Flush the X requests now rather than at the next main loop iteration.
+        window.get_display().flush()
+        reply(f'ok {time.monotonic_ns()}')
+        return True
+
+    GLib.io_add_watch(GLib.IOChannel.unix_new(sys.stdin.fileno()), GLib.IO_IN | GLib.IO_HUP,
+                      on_command)
+    def announce():
+        reply('ready')
+        return False
+
+    GLib.idle_add(announce)
+    Gtk.main()
+
+
+if __name__ == '__main__':
+    main()
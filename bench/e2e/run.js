@@ -0,0 +1,115 @@
+// End-to-end latency of getActiveWindow() on a private desktop (desktop.js). The harness
+// switches focus between fixture windows and changes their address bars, and measures the
+// time from each change until getActiveWindow() reports it.
+//   node bench/e2e/run.js [--iterations 200] [--windows 3] [--depth 40] [--breadth 5]
+//                        [--wm openbox] [--budget-p50 100] [--budget-p99 500] [--timeout 5000]
+// Exits 1 when a change is never reported or a percentile exceeds its budget (ms), so it
+// can gate merges in CI.
+const path = require('path');
+const { startDesktop, parseOptions, fail } = require('./desktop');
+
+const options = parseOptions({
+  iterations: 200,
+  windows: 3,
+  depth: 40,
+  breadth: 5,
+  wm: 'openbox',
+  'budget-p50': 100,
+  'budget-p99': 500,
+  timeout: 5000,
+});
+
+// Polls until accept(info) holds; yields between calls so the fixture's reply is read.
+async function waitFor(getActiveWindow, accept, timeoutMs) {
+  const deadline = process.hrtime.bigint() + BigInt(timeoutMs) * 1000000n;
+  for (;;) {
+    const info = getActiveWindow();
+    const now = process.hrtime.bigint();
+    if (info && accept(info)) {
+      return now;
+    }
+    if (now > deadline) {
+      return null;
+    }
+    await new Promise(setImmediate);
+  }
+}
+
+function percentile(sorted, fraction) {
+  return sorted[Math.max(0, Math.ceil(fraction * sorted.length) - 1)];
+}
+
+async function main() {
+  const send = await startDesktop(options);
+  const { getActiveWindow } = require(path.join(__dirname, '..', '..'));
+  const title = (index) => `Fixture window ${index}`;
+  const urls = Array.from({ length: options.windows }, () => 'about:blank');
+
+  // One change, timed from when the fixture applied it (node's hrtime is CLOCK_MONOTONIC too).
+  async function measure(command, accept, timeoutMs) {
+    const [changedAt, seenAt] = await Promise.all([
+      send(command),
+      waitFor(getActiveWindow, accept, timeoutMs),
+    ]);
+    return seenAt === null ? null : Math.max(0, Number(seenAt - changedAt) / 1e6);
+  }
+
+  // Warm-up, not measured: the first lookup loads the AT-SPI plugin and walks the bus.
+  let focused = 0;
+  urls[0] = 'https://example.test/warmup';
+  await send(`url 0 ${urls[0]}`);
+  if ((await measure('focus 0', (info) => info.url === urls[0], 30000)) === null) {
+    fail('the fixture window never became active with its URL; is the window manager running?');
+  }
+
+  const samples = { focus: [], url: [] };
+  let missed = 0;
+  for (let i = 0; i < options.iterations; i += 1) {
+    let latency;
+    if (i % 2 === 0) {
+      focused = (focused + 1) % options.windows;
+      const expected = focused;
+      latency = await measure(
+        `focus ${expected}`,
+        (info) => info.title === title(expected) && info.url === urls[expected],
+        options.timeout,
+      );
+      samples.focus.push(latency);
+    } else {
+      const url = `https://example.test/${i}`;
+      urls[focused] = url;
+      latency = await measure(`url ${focused} ${url}`, (info) => info.url === url, options.timeout);
+      samples.url.push(latency);
+    }
+    if (latency === null) {
+      missed += 1;
+    }
+  }
+
+  let failed = missed > 0;
+  const rows = {};
+  for (const [kind, values] of Object.entries(samples)) {
+    const sorted = values.filter((value) => value !== null).sort((a, b) => a - b);
+    if (sorted.length === 0) {
+      rows[kind] = { samples: 0, missed: values.length };
+      continue;
+    }
+    const p50 = percentile(sorted, 0.5);
+    const p99 = percentile(sorted, 0.99);
+    const ok = p50 <= options['budget-p50'] && p99 <= options['budget-p99'];
+    failed = failed || !ok;
+    rows[kind] = {
+      samples: sorted.length,
+      missed: values.length - sorted.length,
+      p50Ms: Number(p50.toFixed(2)),
+      p99Ms: Number(p99.toFixed(2)),
+      maxMs: Number(sorted[sorted.length - 1].toFixed(2)),
+      ok,
+    };
+  }
+  console.table(rows);
+  console.log(`budgets: p50 <= ${options['budget-p50']} ms, p99 <= ${options['budget-p99']} ms`);
+  process.exit(failed ? 1 : 0);
+}
+
+main().catch((error) => fail(error.message));
@@ -0,0 +1,83 @@
+// Memory soak for the AT-SPI proxy cap: runs getActiveWindow() lookups against the fixture
+// on a private desktop (desktop.js) while the fixture keeps replacing its widget tree, the
+// way a browser does while the user visits pages, and checks that RSS and libatspi's live
+// proxies stay flat.
+//   node bench/e2e/soak.js [--lookups 100000] [--churn-every 100] [--max-proxies 20000]
+//                          [--max-growth-mb 16] [--sample-every 5000] [--depth 40] [--breadth 5]
+// RSS growth is the highest RSS after the first 10% of lookups (the warm-up) minus RSS at
+// that point. Exits 1 when it exceeds --max-growth-mb or live proxies end above the cap.
+const path = require('path');
+const { startDesktop, parseOptions, fail } = require('./desktop');
+
+const options = parseOptions({
+  lookups: 100000,
+  'churn-every': 100,
+  'max-proxies': 20000,
+  'max-growth-mb': 16,
+  'sample-every': 5000,
+  depth: 40,
+  breadth: 5,
+  wm: 'openbox',
+});
+
+async function main() {
+  const send = await startDesktop({ ...options, windows: 1 });
+  const addon = require(path.join(__dirname, '..', '..'));
+  addon.setAccessibilityCacheLimit(options['max-proxies']);
+
+  await send('url 0 https://example.test/soak');
+  await send('focus 0');
+  const deadline = Date.now() + 30000;
+  while (addon.getActiveWindow()?.url !== 'https://example.test/soak') {
+    if (Date.now() > deadline) {
+      fail('the fixture window never became active with its URL; is the window manager running?');
+    }
+    await new Promise((resolve) => setTimeout(resolve, 100));
+  }
+
+  const warmup = Math.floor(options.lookups / 10);
+  let baselineRss = 0;
+  let peakRss = 0;
+  let misses = 0;
+  const rows = [];
+  for (let i = 1; i <= options.lookups; i += 1) {
+    if (i % options['churn-every'] === 0) {
+      await send('churn 0');
+      await send(`url 0 https://example.test/${i}`);
+    }
+    if (!addon.getActiveWindow()?.url) {
+      misses += 1;
+    }
+    const rss = process.memoryUsage().rss;
+    if (i === warmup) {
+      baselineRss = rss;
+    } else if (i > warmup) {
+      peakRss = Math.max(peakRss, rss);
+    }
+    if (i % options['sample-every'] === 0 || i === options.lookups) {
+      const cache = addon.getAccessibilityCacheStats() ?? {};
+      rows.push({
+        lookups: i,
+        rssMb: Number((rss / 1048576).toFixed(1)),
+        liveProxies: cache.liveProxies,
+        evicted: cache.evicted,
+        trims: cache.trims,
+        misses,
+      });
+    }
+  }
+
+  console.table(rows);
+  const growthMb = (peakRss - baselineRss) / 1048576;
+  const liveProxies = addon.getAccessibilityCacheStats()?.liveProxies ?? 0;
+  // A trim leaves referenced proxies and only runs again half a cap later.
+  const proxiesOk = liveProxies <= options['max-proxies'] * 1.5;
+  const growthOk = growthMb <= options['max-growth-mb'];
+  console.log(
+    `RSS growth after warm-up: ${growthMb.toFixed(1)} MB (limit ${options['max-growth-mb']}), ` +
+      `live proxies: ${liveProxies} (cap ${options['max-proxies']})`,
+  );
+  process.exit(proxiesOk && growthOk ? 0 : 1);
+}
+
+main().catch((error) => fail(error.message));
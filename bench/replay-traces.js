@@ -0,0 +1,36 @@
+// Replays recorded lookup traces as a regression test.
+//   node bench/replay-traces.js <dir> [budgetMs]
+// Fails (exit code 1) when a replay finds a different URL than the recording, or when its
+// instant replay takes longer than budgetMs.
+const fs = require('fs');
+const path = require('path');
+const native = require('node-gyp-build')(path.join(__dirname, '..'));
+
+const dir = process.argv[2];
+if (!dir) {
+  console.error('usage: node bench/replay-traces.js <dir> [budgetMs]');
+  process.exit(2);
+}
+const budgetMs = process.argv[3] === undefined ? Infinity : Number(process.argv[3]);
+
+let failed = false;
+const rows = [];
+for (const name of fs.readdirSync(dir).filter((file) => file.endsWith('.trace')).sort()) {
+  const file = path.join(dir, name);
+  const instant = native.replayLookupTrace(file, { timing: 'instant' });
+  const original = native.replayLookupTrace(file, { timing: 'original' });
+  const ok = instant.matches && instant.elapsedMs <= budgetMs;
+  failed = failed || !ok;
+  rows.push({
+    trace: name,
+    ok,
+    url: instant.url,
+    calls: `${instant.calls}/${instant.recordedCalls}`,
+    misses: instant.misses,
+    searchMs: Number(instant.elapsedMs.toFixed(2)),
+    replayMs: Number(original.elapsedMs.toFixed(1)),
+    recordedMs: Number(original.recordedMs.toFixed(1)),
+  });
+}
+console.table(rows);
+process.exit(failed ? 1 : 0);
@@ -0,0 +1,32 @@
+// Measures what require('win-trace') costs a fresh process.
+//   node bench/startup.js [runs]
+// Each run spawns node, times the require and reports the RSS growth it caused and
+// whether libatspi/GLib got mapped (they should not be until a browser URL is needed).
+const { execFileSync } = require('child_process');
+const path = require('path');
+
+const runs = Number(process.argv[2] ?? 20);
+const probe = `
+const fs = require('fs');
+const before = process.memoryUsage().rss;
+const started = process.hrtime.bigint();
+require(${JSON.stringify(path.join(__dirname, '..'))});
+const elapsedMs = Number(process.hrtime.bigint() - started) / 1e6;
+const maps = fs.readFileSync('/proc/self/maps', 'utf8');
+console.log(JSON.stringify({
+  elapsedMs,
+  rssKb: (process.memoryUsage().rss - before) / 1024,
+  atspiMapped: maps.includes('libatspi'),
+}));
+`;
+
+const samples = [];
+for (let i = 0; i < runs; i += 1) {
+  samples.push(JSON.parse(execFileSync(process.execPath, ['-e', probe], { encoding: 'utf8' })));
+}
+const median = (values) => values.sort((a, b) => a - b)[Math.floor(values.length / 2)];
+console.table({
+  requireMs: Number(median(samples.map((s) => s.elapsedMs)).toFixed(2)),
+  rssGrowthKb: Math.round(median(samples.map((s) => s.rssKb))),
+  atspiMapped: samples.some((s) => s.atspiMapped),
+});
@@ -0,0 +1,28 @@
+// Runs the browser URL lookup against synthetic accessibility trees.
+//   node bench/tree-search.js [latencyUs]
+// latencyUs is spent on every simulated AT-SPI call (default 0: pure traversal cost).
+// Each shape is measured with the document URL strategy and with the address-bar search
+// alone (documentUrl: false).
+const native = require('node-gyp-build')(require('path').join(__dirname, '..'));
+
+const latencyUs = Number(process.argv[2] ?? 0);
+const shapes = ['chromium', 'firefox'];
+const sizes = [1000, 5000, 20000, 50000, 100000, 200000];
+
+const rows = [];
+for (const shape of shapes) {
+  for (const documentUrl of [true, false]) {
+    for (const nodes of sizes) {
+      const result = native.benchmarkTreeSearch({ shape, nodes, latencyUs, documentUrl });
+      rows.push({
+        shape,
+        nodes,
+        source: result.source,
+        nodesVisited: result.nodesVisited,
+        calls: result.calls,
+        elapsedMs: Number(result.elapsedMs.toFixed(2)),
+      });
+    }
+  }
+}
+console.table(rows);
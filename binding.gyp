@@ -5,9 +5,32 @@
       "sources": [
         "src/addon.cc",
         "src/active_window.cc",
-        "src/browser_url.cc"
+        "src/activity_tracker.cc",
+        "src/app_breaker.cc",
+        "src/browser_url.cc",
+        "src/debug_log.cc",
+        "src/display_session.cc",
+        "src/focus_publisher.cc",
+        "src/geometry_tracker.cc",
+        "src/idle_monitor.cc",
+        "src/lookup_probes.cc",
+        "src/lookup_trace.cc",
+        "src/negative_cache.cc",
+        "src/pixel_kernels.cc",
+        "src/process_tree.cc",
+        "src/synthetic_tree.cc",
+        "src/thread_pool.cc",
+        "src/title_index.cc",
+        "src/tracker_core.cc",
+        "src/url_search.cc",
+        "src/usage_aggregator.cc",
+        "src/window_classifier.cc",
+        "src/window_capture.cc",
+        "src/window_frames.cc",
+        "src/window_icon.cc"
       ],
       "include_dirs": [
+        "include",
         "<!(node -p \"require('node-addon-api').include_dir\")"
       ],
       "dependencies": [
@@ -19,7 +42,8 @@
       "conditions": [
         ["OS=='win'", {
           "libraries": [
-            "uiautomationcore.lib"
+            "uiautomationcore.lib",
+            "re2.lib"
           ],
           "cflags_cc": ["/std:c++17"],
           "msvs_settings": {
@@ -29,16 +53,60 @@
           }
         }],
         ["OS=='linux'", {
+          "sources": [
+            "src/atspi_env.cc",
+            "src/atspi_loader.cc",
+            "src/desktop_entries.cc",
+            "src/sandbox_pids.cc",
+            "src/x11_event_loop.cc",
+            "src/x11_util.cc"
+          ],
           "libraries": [
             "-lX11",
-            "<!@(pkg-config --libs atspi-2)"
+            "-lXext",
+            "-lXss",
+            "-lXdamage",
+            "-lXfixes",
+            "-ldl",
+            "<!@(pkg-config --libs re2)"
           ],
           "cflags": [
-            "<!@(pkg-config --cflags atspi-2)"
+            "<!@(pkg-config --cflags re2)"
+          ],
+          "dependencies": [
+            "win_trace_atspi"
+          ],
+          "defines": [
+            "WIN_TRACE_HAVE_XIO_EXIT_HANDLER=<!(pkg-config --atleast-version=1.7 x11 && echo 1 || echo 0)"
           ],
           "cflags_cc": ["-std=c++17"]
         }]
       ]
     }
+  ],
+  "conditions": [
+    ["OS=='linux'", {
+      "targets": [
+        {
+          # libatspi and GLib, loaded by the addon on the first browser URL lookup.
+          "target_name": "win_trace_atspi",
+          "type": "loadable_module",
+          "product_extension": "so",
+          "sources": [
+            "src/atspi_plugin.cc",
+            "src/atspi_tree.cc",
+            "src/debug_log.cc"
+          ],
+          "libraries": [
+            "<!@(pkg-config --libs atspi-2)"
+          ],
+          "cflags": [
+            "<!@(pkg-config --cflags atspi-2)",
+            "-fvisibility=hidden"
+          ],
+          "cflags_cc": ["-std=c++17"]
+        }
+      ]
+    }]
   ]
 }
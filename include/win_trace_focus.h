@@ -0,0 +1,194 @@
+/*
+ * Reader side of the win-trace focus segment (Linux, C99 or C++).
+ *
+ * A process running win-trace's focus publisher keeps the current active window in a POSIX
+ * shared-memory object, by default "/win-trace-focus-<uid>" (mode 0600). Readers map it
+ * read-only, copy a consistent snapshot without locking (a seqlock: the sequence is odd
+ * while the publisher writes) and can sleep until the next change on a futex.
+ *
+ *     struct win_trace_focus_segment* segment = win_trace_focus_open(NULL);
+ *     struct win_trace_focus_snapshot snapshot;
+ *     uint32_t seen = 0;
+ *     while (segment) {
+ *         if (win_trace_focus_read(segment, &snapshot) == 1 && snapshot.sequence != seen) {
+ *             seen = snapshot.sequence;
+ *             printf("%s\n", win_trace_focus_string(&snapshot, snapshot.record.title));
+ *         }
+ *         win_trace_focus_wait(segment, seen, 1000);
+ *     }
+ *
+ * The layout only grows: fields are appended to the record and `version` is bumped, so a
+ * reader built against version N accepts any segment with version >= N.
+ *
+ * A publisher always creates a new segment, so a reader that sees publisher_pid 0 should
+ * close and open again to follow the next publisher.
+ */
+#ifndef WIN_TRACE_FOCUS_H
+#define WIN_TRACE_FOCUS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WIN_TRACE_FOCUS_MAGIC 0x53465457u /* "WTFS" little-endian */
+#define WIN_TRACE_FOCUS_VERSION 1
+#define WIN_TRACE_FOCUS_NAME_PREFIX "/win-trace-focus-"
+#define WIN_TRACE_FOCUS_STRING_BYTES 8192
+
+/* record.flags */
+#define WIN_TRACE_FOCUS_HAS_WINDOW 0x1u /* clear: no window could be read */
+#define WIN_TRACE_FOCUS_HAS_URL 0x2u
+
+/* A NUL-terminated UTF-8 string in the snapshot's string area (truncated if too long). */
+struct win_trace_focus_string_ref {
+    uint32_t offset;
+    uint32_t length; /* bytes, without the NUL */
+};
+
+struct win_trace_focus_record {
+    uint64_t window_id;
+    uint64_t memory_usage;
+    int64_t published_ms; /* CLOCK_REALTIME */
+    int64_t x;
+    int64_t y;
+    int64_t width;
+    int64_t height;
+    uint32_t process_id;
+    uint32_t flags;
+    struct win_trace_focus_string_ref process_name;
+    struct win_trace_focus_string_ref exe_path;
+    struct win_trace_focus_string_ref title;
+    struct win_trace_focus_string_ref url;
+};
+
+struct win_trace_focus_segment {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size; /* bytes of the whole segment */
+    uint32_t publisher_pid; /* 0 once the publisher has stopped */
+    uint32_t sequence; /* seqlock and futex word; odd while a write is in progress */
+    uint32_t reserved;
+    struct win_trace_focus_record record;
+    char strings[WIN_TRACE_FOCUS_STRING_BYTES];
+};
+
+struct win_trace_focus_snapshot {
+    uint32_t sequence;
+    uint32_t publisher_pid;
+    struct win_trace_focus_record record;
+    char strings[WIN_TRACE_FOCUS_STRING_BYTES];
+};
+
+static inline const char* win_trace_focus_string(const struct win_trace_focus_snapshot* snapshot,
+                                                 struct win_trace_focus_string_ref ref) {
+    if (ref.offset >= WIN_TRACE_FOCUS_STRING_BYTES ||
+        ref.length >= WIN_TRACE_FOCUS_STRING_BYTES - ref.offset) {
+        return "";
+    }
+    return snapshot->strings + ref.offset;
+}
+
+/*
+ * Copies the current snapshot. Returns 1 on success, 0 when the publisher kept writing
+ * through every retry (try again), -1 when the segment is not a compatible focus segment.
+ */
+static inline int win_trace_focus_read(const struct win_trace_focus_segment* segment,
+                                       struct win_trace_focus_snapshot* snapshot) {
+    int attempt;
+    if (segment->magic != WIN_TRACE_FOCUS_MAGIC || segment->version < WIN_TRACE_FOCUS_VERSION ||
+        segment->size < sizeof(struct win_trace_focus_segment)) {
+        return -1;
+    }
+    for (attempt = 0; attempt < 64; ++attempt) {
+        uint32_t before = __atomic_load_n(&segment->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1u) {
+            continue;
+        }
+        memcpy(&snapshot->record, &segment->record, sizeof(snapshot->record));
+        memcpy(snapshot->strings, segment->strings, sizeof(snapshot->strings));
+        snapshot->publisher_pid = __atomic_load_n(&segment->publisher_pid, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&segment->sequence, __ATOMIC_RELAXED) == before) {
+            snapshot->sequence = before;
+            snapshot->strings[WIN_TRACE_FOCUS_STRING_BYTES - 1] = '\0';
+            return 1;
+        }
+    }
+    return 0;
+}
+
+#ifdef __linux__
+
+/*
+ * Maps the segment read-only; name NULL means this user's default. NULL on failure, and
+ * for a segment owned by another user, accessible to anyone else, or too small to map
+ * (another user could have created it under the predictable name).
+ */
+static inline struct win_trace_focus_segment* win_trace_focus_open(const char* name) {
+    char defaultName[64];
+    struct win_trace_focus_segment* segment;
+    struct stat info;
+    int fd;
+    if (!name) {
+        snprintf(defaultName, sizeof(defaultName), "%s%u", WIN_TRACE_FOCUS_NAME_PREFIX,
+                 (unsigned)getuid());
+        name = defaultName;
+    }
+    fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &info) != 0 || info.st_uid != geteuid() || (info.st_mode & 077) != 0 ||
+        info.st_size < (off_t)sizeof(*segment)) {
+        close(fd);
+        return NULL;
+    }
+    segment = (struct win_trace_focus_segment*)mmap(NULL, sizeof(*segment), PROT_READ,
+                                                    MAP_SHARED, fd, 0);
+    close(fd);
+    return segment == MAP_FAILED ? NULL : segment;
+}
+
+static inline void win_trace_focus_close(struct win_trace_focus_segment* segment) {
+    if (segment) {
+        munmap(segment, sizeof(*segment));
+    }
+}
+
+/*
+ * Sleeps until the sequence differs from seen (the last snapshot's sequence) or timeoutMs
+ * passes; negative waits forever. Returns at once if a change already happened.
+ */
+static inline void win_trace_focus_wait(const struct win_trace_focus_segment* segment,
+                                        uint32_t seen, int timeoutMs) {
+    struct timespec timeout;
+    if (timeoutMs >= 0) {
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_nsec = (long)(timeoutMs % 1000) * 1000000L;
+    }
+    syscall(SYS_futex, &segment->sequence, FUTEX_WAIT, seen, timeoutMs >= 0 ? &timeout : NULL,
+            NULL, 0);
+}
+
+#endif /* __linux__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WIN_TRACE_FOCUS_H */
@@ -9,8 +9,9 @@ function normalizeWebsite(url) {
   }
 }
 
-function getActiveWindow() {
-  const info = native.getActiveWindow();
+// options.processTreeMemory adds the PSS/USS of the window's whole process tree.
+function getActiveWindow(options = {}) {
+  const info = native.getActiveWindow(options);
   if (!info) {
     return null;
   }
@@ -18,4 +19,124 @@ function getActiveWindow() {
   return info;
 }
 
-module.exports = { getActiveWindow };
+function createUsageAggregator(options = {}) {
+  const aggregator = new native.UsageAggregator(options);
+  return {
+    record(info, timestamp) {
+      aggregator.record(info ?? null, timestamp);
+    },
+    sample(timestamp) {
+      const info = aggregator.sample(timestamp);
+      if (info) {
+        info.website = info.url ? normalizeWebsite(info.url) : null;
+      }
+      return info;
+    },
+    query({ from, to, groupBy = 'app', bucket = 'hour' } = {}) {
+      return aggregator.query({ from, to, groupBy, bucket });
+    },
+    clear() {
+      aggregator.clear();
+    },
+  };
+}
+
+function openDisplaySession(displayName) {
+  const session = new native.DisplaySession(displayName);
+  return {
+    display: session.display,
+    async getActiveWindow() {
+      const info = await session.getActiveWindow();
+      if (info) {
+        info.website = info.url ? normalizeWebsite(info.url) : null;
+      }
+      return info;
+    },
+    close() {
+      session.close();
+    },
+  };
+}
+
+function startIdleMonitor(options = {}, listener) {
+  if (typeof options === 'function') {
+    return native.startIdleMonitor({}, options);
+  }
+  return native.startIdleMonitor(options, listener);
+}
+
+// Calls listener with each poll of the process-wide tracker (or null when no window could
+// be read). Returns a function that ends the subscription.
+function subscribeActiveWindow(listener, { intervalMs = 1000 } = {}) {
+  const id = native.subscribeActiveWindow((info) => {
+    if (info) {
+      info.website = info.url ? normalizeWebsite(info.url) : null;
+    }
+    listener(info);
+  }, { intervalMs });
+  return () => native.unsubscribeActiveWindow(id);
+}
+
+// RE2 has no per-pattern flags argument; the i flag becomes an inline group.
+function patternSource(pattern) {
+  if (pattern instanceof RegExp) {
+    return pattern.flags.includes('i') ? `(?i:${pattern.source})` : pattern.source;
+  }
+  return pattern ?? '';
+}
+
+// rules: [{ category, processName?, title?, url?, caseInsensitive? }] with RE2 patterns
+// (strings or RegExp). A rule matches when all of its patterns match; the first match wins.
+function createClassifier(rules, { cacheSize = 4096 } = {}) {
+  const nativeRules = rules.map((rule) => ({
+    processName: patternSource(rule.processName),
+    title: patternSource(rule.title),
+    url: patternSource(rule.url),
+    caseInsensitive: Boolean(rule.caseInsensitive),
+  }));
+  const classifier = new native.WindowClassifier(nativeRules, { cacheSize });
+  const categoryOf = (index) => (index >= 0 ? rules[index].category : null);
+  return {
+    classify(info) {
+      return categoryOf(classifier.classify(info));
+    },
+    getActiveWindow() {
+      const info = classifier.getActiveWindow();
+      if (!info) {
+        return null;
+      }
+      info.category = categoryOf(info.rule);
+      delete info.rule;
+      info.website = info.url ? normalizeWebsite(info.url) : null;
+      return info;
+    },
+    stats() {
+      return classifier.stats();
+    },
+  };
+}
+
+module.exports = {
+  getActiveWindow,
+  subscribeActiveWindow,
+  createUsageAggregator,
+  createClassifier,
+  openDisplaySession,
+  startIdleMonitor,
+  stopIdleMonitor: native.stopIdleMonitor,
+  getIdleState: native.getIdleState,
+  captureActiveWindow: native.captureActiveWindow,
+  getWindowIcon: native.getWindowIcon,
+  setAccessibilityTimeouts: native.setAccessibilityTimeouts,
+  setAccessibilityCacheLimit: native.setAccessibilityCacheLimit,
+  getAccessibilityCacheStats: native.getAccessibilityCacheStats,
+  setLookupRecording: native.setLookupRecording,
+  replayLookupTrace: native.replayLookupTrace,
+  setTraceEventFile: native.setTraceEventFile,
+  startGeometryTracking: native.startGeometryTracking,
+  stopGeometryTracking: native.stopGeometryTracking,
+  startFocusPublisher: native.startFocusPublisher,
+  stopFocusPublisher: native.stopFocusPublisher,
+  startActivityTracking: native.startActivityTracking,
+  stopActivityTracking: native.stopActivityTracking,
+};
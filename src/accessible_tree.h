@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+enum class AccessibleRole {
+    Other,
+    Application,
+    Frame,
+    Window,
+    Panel,
+    ToolBar,
+    Entry,
+    Text,
+    DocumentWeb,
+};
+
+enum AccessibleState : uint32_t {
+    kStateEditable = 1u << 0,
+    kStateFocusable = 1u << 1,
+    kStateEnabled = 1u << 2,
+    kStateFocused = 1u << 3,
+    kStateShowing = 1u << 4,
+    kStateActive = 1u << 5,
+};
+
+// Screen rectangle in pixels.
+struct AccessibleRect {
+    long x = 0;
+    long y = 0;
+    long width = 0;
+    long height = 0;
+};
+
+struct AccessibleTreeStats {
+    uint64_t calls = 0;  // every query that would be a D-Bus round trip on AT-SPI
+    uint64_t refs = 0;   // node handles handed out
+    // Calls the backend gave up on because the application did not answer in time.
+    uint64_t timeouts = 0;
+};
+
+// The accessibility tree as the URL search sees it. Handles are opaque and reference
+// counted: every method returning a Node hands the caller a reference it must Unref
+// (NodeRef does that). The public methods count calls and forward to the backend, so
+// traversal cost can be measured the same way on libatspi and on synthetic trees.
+class AccessibleTree {
+   public:
+    using Node = void*;
+
+    virtual ~AccessibleTree() = default;
+
+    Node Ref(Node node) {
+        ++stats_.refs;
+        return DoRef(node);
+    }
+    void Unref(Node node) { DoUnref(node); }
+
+    int DesktopCount() {
+        ++stats_.calls;
+        return DoDesktopCount();
+    }
+    Node Desktop(int index) {
+        ++stats_.calls;
+        ++stats_.refs;
+        return DoDesktop(index);
+    }
+    AccessibleRole Role(Node node) {
+        ++stats_.calls;
+        return DoRole(node);
+    }
+    // False when the state set is unavailable.
+    bool States(Node node, uint32_t& states) {
+        ++stats_.calls;
+        return DoStates(node, states);
+    }
+    std::string Name(Node node) {
+        ++stats_.calls;
+        return DoName(node);
+    }
+    Node Parent(Node node) {
+        ++stats_.calls;
+        ++stats_.refs;
+        return DoParent(node);
+    }
+    int ChildCount(Node node) {
+        ++stats_.calls;
+        return DoChildCount(node);
+    }
+    Node ChildAt(Node node, int index) {
+        ++stats_.calls;
+        ++stats_.refs;
+        return DoChildAt(node, index);
+    }
+    int ProcessId(Node node) {
+        ++stats_.calls;
+        return DoProcessId(node);
+    }
+    // False when the node has no text interface.
+    bool Text(Node node, std::string& value) {
+        ++stats_.calls;
+        return DoText(node, value);
+    }
+
+    // Document interface attribute (e.g. "DocURL"); false when absent.
+    bool DocumentAttribute(Node node, const std::string& name, std::string& value) {
+        ++stats_.calls;
+        return DoDocumentAttribute(node, name, value);
+    }
+    // Screen extents; false when the node has no component interface.
+    bool Extents(Node node, AccessibleRect& rect) {
+        ++stats_.calls;
+        return DoExtents(node, rect);
+    }
+
+    // Key of the application owning node (its bus name on AT-SPI), answered without a
+    // round trip; empty when the backend cannot tell.
+    std::string ApplicationId(Node node) { return DoApplicationId(node); }
+
+    const AccessibleTreeStats& stats() const { return stats_; }
+    void ResetStats() { stats_ = AccessibleTreeStats(); }
+
+   protected:
+    virtual Node DoRef(Node node) = 0;
+    virtual void DoUnref(Node node) = 0;
+    virtual int DoDesktopCount() = 0;
+    virtual Node DoDesktop(int index) = 0;
+    virtual AccessibleRole DoRole(Node node) = 0;
+    virtual bool DoStates(Node node, uint32_t& states) = 0;
+    virtual std::string DoName(Node node) = 0;
+    virtual Node DoParent(Node node) = 0;
+    virtual int DoChildCount(Node node) = 0;
+    virtual Node DoChildAt(Node node, int index) = 0;
+    virtual int DoProcessId(Node node) = 0;
+    virtual bool DoText(Node node, std::string& value) = 0;
+    virtual bool DoDocumentAttribute(Node node, const std::string& name, std::string& value) = 0;
+    virtual bool DoExtents(Node, AccessibleRect&) { return false; }
+    virtual std::string DoApplicationId(Node) { return std::string(); }
+
+    void NoteTimeout() { ++stats_.timeouts; }
+
+   private:
+    AccessibleTreeStats stats_;
+};
+
+// Owns one reference to a node.
+class NodeRef {
+   public:
+    NodeRef() = default;
+    NodeRef(AccessibleTree* tree, AccessibleTree::Node adopted)
+        : tree_(adopted ? tree : nullptr), node_(adopted) {}
+    ~NodeRef() { reset(); }
+
+    NodeRef(NodeRef&& other) noexcept : tree_(other.tree_), node_(other.node_) {
+        other.tree_ = nullptr;
+        other.node_ = nullptr;
+    }
+    NodeRef& operator=(NodeRef&& other) noexcept {
+        if (this != &other) {
+            reset();
+            tree_ = other.tree_;
+            node_ = other.node_;
+            other.tree_ = nullptr;
+            other.node_ = nullptr;
+        }
+        return *this;
+    }
+    NodeRef(const NodeRef&) = delete;
+    NodeRef& operator=(const NodeRef&) = delete;
+
+    AccessibleTree::Node get() const { return node_; }
+    explicit operator bool() const { return node_ != nullptr; }
+
+    NodeRef Share() const { return node_ ? NodeRef(tree_, tree_->Ref(node_)) : NodeRef(); }
+    AccessibleTree::Node release() {
+        AccessibleTree::Node node = node_;
+        tree_ = nullptr;
+        node_ = nullptr;
+        return node;
+    }
+    void reset() {
+        if (node_) {
+            tree_->Unref(node_);
+        }
+        tree_ = nullptr;
+        node_ = nullptr;
+    }
+
+   private:
+    AccessibleTree* tree_ = nullptr;
+    AccessibleTree::Node node_ = nullptr;
+};
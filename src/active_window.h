@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #ifdef _WIN32
@@ -13,6 +14,23 @@ struct WindowBounds {
     long height = 0;
 };
 
+// Window-manager decorations around the client area (_NET_FRAME_EXTENTS on X11).
+struct FrameExtents {
+    long left = 0;
+    long right = 0;
+    long top = 0;
+    long bottom = 0;
+};
+
+// Summed over a process and its descendants; uss counts only private pages, pss splits
+// shared pages among the processes mapping them.
+struct ProcessTreeMemory {
+    uint64_t rss = 0;
+    uint64_t pss = 0;
+    uint64_t uss = 0;
+    uint32_t processes = 0;
+};
+
 struct OwnerInfo {
     std::string name;
     std::string bundleId;
@@ -25,11 +43,76 @@ struct ActiveWindowInfo {
     std::string exePath;
     std::string title;
     std::string browserUrl;  // empty when URL is unavailable
+    // For browsers without a URL: LookupFailureName() of the reason (negative_cache.h).
+    const char* urlFailure = nullptr;
     WindowBounds bounds;
+    FrameExtents frameExtents;
     OwnerInfo owner;
+    // From the application's .desktop entry when one matched the window (Linux); empty
+    // otherwise. owner.bundleId is appId when set, else the process name.
+    std::string appId;
+    std::string appName;
+    std::string appIcon;
     unsigned long processId = 0;
     uint64_t windowId = 0;
     uint64_t memoryUsage = 0;
+    // Last content-activity interval; only set while activity tracking follows the window.
+    bool hasActivity = false;
+    uint64_t damagedPixels = 0;
+    double activityScore = 0;
+    // Only set when ActiveWindowQueryOptions::processTreeMemory was requested.
+    bool hasTreeMemory = false;
+    ProcessTreeMemory treeMemory;
+};
+
+struct ActiveWindowQueryOptions {
+    // Geometry and activity tracking follow $DISPLAY only; other connections must not use
+    // their caches.
+    bool useEventCaches = false;
+    // libatspi talks to a single accessibility bus per process; callers on other
+    // sessions' displays turn the URL lookup off.
+    bool queryBrowserUrl = true;
+    // Also sum PSS/USS over the window's whole process tree (Linux).
+    bool processTreeMemory = false;
 };
 
 bool GetActiveWindowInfo(ActiveWindowInfo& info);
+bool GetActiveWindowInfo(ActiveWindowInfo& info, const ActiveWindowQueryOptions& options);
+
+// Bounds on the browser URL lookup's accessibility calls (Linux). Each call waits at most
+// callMs once its application has run for startupMs; an application whose call ran out
+// is skipped for backoffMs, doubling per repeated timeout up to maxBackoffMs.
+struct AccessibilityTimeouts {
+    int callMs = 500;
+    int startupMs = 2000;
+    uint32_t backoffMs = 5000;
+    uint32_t maxBackoffMs = 300000;
+};
+
+void SetAccessibilityTimeouts(const AccessibilityTimeouts& timeouts);
+
+// libatspi keeps a proxy object per accessible it has seen (Linux). After each lookup the
+// proxies beyond maxProxies that nothing uses are dropped; 20000 by default.
+struct AccessibilityCacheStats {
+    uint64_t liveProxies = 0;
+    uint64_t applications = 0;
+    uint64_t evicted = 0;
+    uint64_t trims = 0;
+};
+
+void SetAccessibleProxyLimit(size_t maxProxies);
+// False until the first browser lookup has loaded AT-SPI.
+bool GetAccessibilityCacheStats(AccessibilityCacheStats& stats);
+
+// While dir is non-empty, every browser lookup writes a LookupTrace (see lookup_trace.h)
+// into it. Starts from $WIN_TRACE_RECORD_DIR. Linux only.
+void SetLookupRecordDir(const std::string& dir);
+
+#ifdef __linux__
+typedef struct _XDisplay Display;
+
+// Collects the active window of an already open connection. Safe to call from any thread
+// as long as each Display is used by one thread at a time.
+bool GetActiveWindowInfoOnDisplay(Display* display, const ActiveWindowQueryOptions& options,
+                                  ActiveWindowInfo& info);
+#endif
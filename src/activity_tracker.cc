@@ -0,0 +1,273 @@
+#include "activity_tracker.h"
+
+#ifdef __linux__
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xdamage.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+#include "debug_log.h"
+#include "x11_event_loop.h"
+#include "x11_util.h"
+
+namespace {
+
+const uint32_t kMinIntervalMs = 100;
+
+int64_t SteadyNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+class ActivityHandler : public X11EventLoop::Handler {
+   public:
+    ActivityHandler(uint32_t intervalMs, activity_tracker::Listener listener)
+        : intervalMs_(intervalMs), listener_(std::move(listener)) {}
+
+    bool Attach(Display* display) {
+        int errorBase = 0;
+        if (!XDamageQueryExtension(display, &damageEventBase_, &errorBase)) {
+            DebugLog("XDamage unavailable; content activity disabled");
+            return false;
+        }
+        // Announces the client's version; the server rejects DAMAGE requests before it.
+        int major = 1;
+        int minor = 1;
+        XDamageQueryVersion(display, &major, &minor);
+        root_ = DefaultRootWindow(display);
+        activeAtom_ = CachedAtom(display, "_NET_ACTIVE_WINDOW");
+        X11EventLoop::Get().AddInputMask(display, root_, PropertyChangeMask);
+        attached_ = true;
+        Follow(display, QueryActiveWindow(display));
+        return true;
+    }
+
+    void Detach(Display* display) {
+        if (!attached_) {
+            return;
+        }
+        Unfollow(display);
+        X11EventLoop::Get().RemoveInputMask(display, root_, PropertyChangeMask);
+        attached_ = false;
+    }
+
+    void OnEvent(Display* display, XEvent& event) override {
+        if (event.type == damageEventBase_ + XDamageNotify) {
+            const auto& damage = reinterpret_cast<const XDamageNotifyEvent&>(event);
+            if (damage.damage == damage_) {
+                Accumulate(damage);
+            }
+            return;
+        }
+        switch (event.type) {
+            case PropertyNotify:
+                if (event.xproperty.window == root_ && event.xproperty.atom == activeAtom_) {
+                    Window active = QueryActiveWindow(display);
+                    if (active != client_) {
+                        Follow(display, active);
+                    }
+                }
+                break;
+            case DestroyNotify:
+                if (event.xdestroywindow.window == client_) {
+                    // The server already freed the damage object with its drawable.
+                    damage_ = 0;
+                    Unfollow(display);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    int64_t NextTimerMs() override {
+        if (client_ == 0) {
+            return -1;
+        }
+        int64_t remaining = intervalStartMs_ + intervalMs_ - SteadyNowMs();
+        return remaining > 0 ? remaining : 0;
+    }
+
+    void OnTimer(Display*) override {
+        if (client_ != 0) {
+            Publish();
+        }
+    }
+
+    bool Last(uint64_t windowId, ActivitySample& sample) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (last_.windowId == 0 || last_.windowId != windowId) {
+            return false;
+        }
+        sample = last_;
+        return true;
+    }
+
+   private:
+    void Follow(Display* display, Window client) {
+        Unfollow(display);
+        if (client == 0) {
+            return;
+        }
+        client_ = client;
+        X11EventLoop::Get().AddInputMask(display, client_, StructureNotifyMask);
+        // Raw rectangles: every report carries its area, and nothing has to be subtracted
+        // from the damage region to re-arm it, so watching costs no round trips.
+        damage_ = XDamageCreate(display, client_, XDamageReportRawRectangles);
+        windowArea_ = 0;
+        ResetInterval();
+        DebugLog("Tracking content activity of window 0x%lx", client_);
+    }
+
+    void Unfollow(Display* display) {
+        if (damage_ != 0) {
+            XDamageDestroy(display, damage_);
+            damage_ = 0;
+        }
+        if (client_ != 0) {
+            X11EventLoop::Get().RemoveInputMask(display, client_, StructureNotifyMask);
+        }
+        client_ = 0;
+        std::lock_guard<std::mutex> lock(mutex_);
+        last_ = ActivitySample();
+    }
+
+    void Accumulate(const XDamageNotifyEvent& damage) {
+        long left = std::max<long>(damage.area.x, 0);
+        long top = std::max<long>(damage.area.y, 0);
+        long right = std::min<long>(damage.area.x + damage.area.width, damage.geometry.width);
+        long bottom = std::min<long>(damage.area.y + damage.area.height, damage.geometry.height);
+        if (right > left && bottom > top) {
+            damagedPixels_ += static_cast<uint64_t>(right - left) * (bottom - top);
+        }
+        ++damageEvents_;
+        windowArea_ = static_cast<uint64_t>(damage.geometry.width) * damage.geometry.height;
+    }
+
+    void ResetInterval() {
+        intervalStartMs_ = SteadyNowMs();
+        damagedPixels_ = 0;
+        damageEvents_ = 0;
+    }
+
+    void Publish() {
+        ActivitySample sample;
+        sample.windowId = static_cast<uint64_t>(client_);
+        // Reports overlap, so the raw sum can pass the window area; only that much can change.
+        sample.damagedPixels =
+            windowArea_ != 0 ? std::min(damagedPixels_, windowArea_) : damagedPixels_;
+        sample.damageEvents = damageEvents_;
+        sample.intervalMs = static_cast<uint32_t>(SteadyNowMs() - intervalStartMs_);
+        if (windowArea_ != 0) {
+            sample.activityScore =
+                static_cast<double>(sample.damagedPixels) / static_cast<double>(windowArea_);
+        }
+        ResetInterval();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            last_ = sample;
+        }
+        if (listener_) {
+            listener_(sample);
+        }
+    }
+
+    const uint32_t intervalMs_;
+    activity_tracker::Listener listener_;
+
+    // Loop thread only.
+    bool attached_ = false;
+    int damageEventBase_ = 0;
+    Window root_ = 0;
+    Atom activeAtom_ = None;
+    Window client_ = 0;
+    Damage damage_ = 0;
+    int64_t intervalStartMs_ = 0;
+    uint64_t damagedPixels_ = 0;
+    uint32_t damageEvents_ = 0;
+    uint64_t windowArea_ = 0;
+
+    std::mutex mutex_;
+    ActivitySample last_;
+};
+
+std::mutex gTrackerMutex;
+std::unique_ptr<ActivityHandler> gHandler;
+
+}  // namespace
+
+namespace activity_tracker {
+
+bool Start(uint32_t intervalMs, Listener listener) {
+    std::lock_guard<std::mutex> lock(gTrackerMutex);
+    X11EventLoop& loop = X11EventLoop::Get();
+    if (!loop.Start()) {
+        return false;
+    }
+    if (gHandler) {
+        ActivityHandler* previous = gHandler.get();
+        loop.RemoveHandler(previous, [previous](Display* display) { previous->Detach(display); });
+        gHandler.reset();
+    }
+
+    auto handler = std::make_unique<ActivityHandler>(std::max(intervalMs, kMinIntervalMs),
+                                                     std::move(listener));
+    ActivityHandler* raw = handler.get();
+    bool attached = false;
+    loop.AddHandler(raw, [raw, &attached](Display* display) { attached = raw->Attach(display); });
+    if (!attached) {
+        loop.RemoveHandler(raw, [raw](Display* display) { raw->Detach(display); });
+        return false;
+    }
+    gHandler = std::move(handler);
+    return true;
+}
+
+void Stop() {
+    std::lock_guard<std::mutex> lock(gTrackerMutex);
+    if (!gHandler) {
+        return;
+    }
+    ActivityHandler* raw = gHandler.get();
+    X11EventLoop::Get().RemoveHandler(raw, [raw](Display* display) { raw->Detach(display); });
+    gHandler.reset();
+}
+
+bool Running() {
+    std::lock_guard<std::mutex> lock(gTrackerMutex);
+    return gHandler != nullptr;
+}
+
+bool LastSample(uint64_t windowId, ActivitySample& sample) {
+    std::lock_guard<std::mutex> lock(gTrackerMutex);
+    return gHandler && gHandler->Last(windowId, sample);
+}
+
+}  // namespace activity_tracker
+
+#else
+
+namespace activity_tracker {
+
+bool Start(uint32_t, Listener) {
+    return false;
+}
+
+void Stop() {}
+
+bool Running() {
+    return false;
+}
+
+bool LastSample(uint64_t, ActivitySample&) {
+    return false;
+}
+
+}  // namespace activity_tracker
+
+#endif  // __linux__
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+struct ActivitySample {
+    uint64_t windowId = 0;
+    // Area of every damage report in the interval, clipped to the window and summed without
+    // merging overlaps, then capped at the window area: an upper bound on the pixels that
+    // changed. A playing video reaches the cap quickly.
+    uint64_t damagedPixels = 0;
+    uint32_t damageEvents = 0;
+    // damagedPixels relative to the window area.
+    double activityScore = 0;
+    uint32_t intervalMs = 0;
+};
+
+// Measures how much of the focused window's content changes, from XDamage reports on the
+// X11 event loop: no image data is read. Damage is summed over fixed intervals; the
+// listener gets each completed interval on a background thread. A focus change discards
+// the partial interval, so every sample covers a single window.
+namespace activity_tracker {
+
+using Listener = std::function<void(const ActivitySample&)>;
+
+bool Start(uint32_t intervalMs, Listener listener);
+void Stop();
+bool Running();
+
+// Last completed interval; returns false unless windowId is the window currently followed.
+bool LastSample(uint64_t windowId, ActivitySample& sample);
+
+}  // namespace activity_tracker
@@ -1,19 +1,52 @@
 #include <napi.h>
 
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+
+#ifdef __linux__
+#include <X11/Xlib.h>
+#endif
+
 #include "active_window.h"
+#include "display_session.h"
+#include "geometry_tracker.h"
+#include "focus_publisher.h"
+#include "idle_monitor.h"
+#include "lookup_probes.h"
+#include "lookup_trace.h"
+#include "synthetic_tree.h"
+#include "tracker_core.h"
+#include "url_search.h"
+#include "usage_aggregator.h"
+#include "window_capture.h"
+#include "window_classifier.h"
+#include "window_icon.h"
 
-Napi::Value GetActiveWindowWrapped(const Napi::CallbackInfo& info) {
-    Napi::Env env = info.Env();
-    ActiveWindowInfo windowInfo;
-    if (!GetActiveWindowInfo(windowInfo)) {
-        return env.Null();
-    }
+namespace {
 
+int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+Napi::Object ToJsObject(Napi::Env env, const ActiveWindowInfo& windowInfo) {
     Napi::Object result = Napi::Object::New(env);
     result.Set("processName", windowInfo.processName);
     result.Set("exePath", windowInfo.exePath);
     result.Set("title", windowInfo.title);
-    result.Set("appName", windowInfo.processName);
+    result.Set("appName",
+               windowInfo.appName.empty() ? windowInfo.processName : windowInfo.appName);
+    result.Set("appId", windowInfo.appId.empty() ? env.Null()
+                                                 : Napi::String::New(env, windowInfo.appId));
+    result.Set("appIcon", windowInfo.appIcon.empty()
+                              ? env.Null()
+                              : Napi::String::New(env, windowInfo.appIcon));
     result.Set("processId", Napi::Number::New(env, static_cast<double>(windowInfo.processId)));
     result.Set("id", Napi::Number::New(env, static_cast<double>(windowInfo.windowId)));
     result.Set("memoryUsage",
@@ -26,6 +59,13 @@ Napi::Value GetActiveWindowWrapped(const Napi::CallbackInfo& info) {
     bounds.Set("height", windowInfo.bounds.height);
     result.Set("bounds", bounds);
 
+    Napi::Object frameExtents = Napi::Object::New(env);
+    frameExtents.Set("left", windowInfo.frameExtents.left);
+    frameExtents.Set("right", windowInfo.frameExtents.right);
+    frameExtents.Set("top", windowInfo.frameExtents.top);
+    frameExtents.Set("bottom", windowInfo.frameExtents.bottom);
+    result.Set("frameExtents", frameExtents);
+
     Napi::Object owner = Napi::Object::New(env);
     owner.Set("name", windowInfo.owner.name);
     owner.Set("processId",
@@ -34,18 +74,1105 @@ Napi::Value GetActiveWindowWrapped(const Napi::CallbackInfo& info) {
     owner.Set("path", windowInfo.owner.path);
     result.Set("owner", owner);
 
+    if (windowInfo.hasActivity) {
+        result.Set("damagedPixels",
+                   Napi::Number::New(env, static_cast<double>(windowInfo.damagedPixels)));
+        result.Set("activityScore", Napi::Number::New(env, windowInfo.activityScore));
+    } else {
+        result.Set("damagedPixels", env.Null());
+        result.Set("activityScore", env.Null());
+    }
+
+    if (windowInfo.hasTreeMemory) {
+        Napi::Object tree = Napi::Object::New(env);
+        tree.Set("rss", Napi::Number::New(env, static_cast<double>(windowInfo.treeMemory.rss)));
+        tree.Set("pss", Napi::Number::New(env, static_cast<double>(windowInfo.treeMemory.pss)));
+        tree.Set("uss", Napi::Number::New(env, static_cast<double>(windowInfo.treeMemory.uss)));
+        tree.Set("processes", Napi::Number::New(env, windowInfo.treeMemory.processes));
+        result.Set("processTreeMemory", tree);
+    } else {
+        result.Set("processTreeMemory", env.Null());
+    }
+
     if (windowInfo.browserUrl.empty()) {
         result.Set("url", env.Null());
     } else {
         result.Set("url", windowInfo.browserUrl);
     }
+    result.Set("urlError", windowInfo.urlFailure ? Napi::String::New(env, windowInfo.urlFailure)
+                                                 : env.Null());
 
     return result;
 }
 
-Napi::Object Init(Napi::Env env, Napi::Object exports) {
-    exports.Set("getActiveWindow", Napi::Function::New(env, GetActiveWindowWrapped));
-    return exports;
+std::string GetStringField(const Napi::Object& object, const char* name) {
+    Napi::Value value = object.Get(name);
+    return value.IsString() ? value.As<Napi::String>().Utf8Value() : std::string();
+}
+
+// Accepts either a native sample or the object returned by getActiveWindow().
+void FromJsObject(const Napi::Object& object, ActiveWindowInfo& windowInfo) {
+    windowInfo.processName = GetStringField(object, "processName");
+    if (windowInfo.processName.empty()) {
+        windowInfo.processName = GetStringField(object, "appName");
+    }
+    windowInfo.title = GetStringField(object, "title");
+    windowInfo.browserUrl = GetStringField(object, "url");
+}
+
+Napi::Object IdleStateToJs(Napi::Env env, const IdleState& state) {
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("idle", Napi::Boolean::New(env, state.idle));
+    result.Set("locked", Napi::Boolean::New(env, state.locked));
+    result.Set("screenOff", Napi::Boolean::New(env, state.screenOff));
+    result.Set("idleMs", Napi::Number::New(env, static_cast<double>(state.idleMs)));
+    return result;
+}
+
+int64_t TimestampArg(const Napi::CallbackInfo& info, size_t index) {
+    if (info.Length() > index && !info[index].IsUndefined() && !info[index].IsNull()) {
+        return info[index].ToNumber().As<Napi::Number>().Int64Value();
+    }
+    return NowMs();
+}
+
+class UsageAggregatorWrap : public Napi::ObjectWrap<UsageAggregatorWrap> {
+   public:
+    static Napi::Function Define(Napi::Env env) {
+        return DefineClass(env, "UsageAggregator",
+                           {InstanceMethod("record", &UsageAggregatorWrap::Record),
+                            InstanceMethod("sample", &UsageAggregatorWrap::Sample),
+                            InstanceMethod("query", &UsageAggregatorWrap::Query),
+                            InstanceMethod("clear", &UsageAggregatorWrap::Clear)});
+    }
+
+    explicit UsageAggregatorWrap(const Napi::CallbackInfo& info)
+        : Napi::ObjectWrap<UsageAggregatorWrap>(info) {
+        UsageAggregatorOptions options;
+        if (info.Length() > 0 && info[0].IsObject()) {
+            Napi::Object config = info[0].As<Napi::Object>();
+            auto readMs = [&](const char* name, int64_t& target) {
+                Napi::Value value = config.Get(name);
+                if (value.IsNumber()) {
+                    target = value.As<Napi::Number>().Int64Value();
+                }
+            };
+            readMs("maxSampleGapMs", options.maxSampleGapMs);
+            readMs("utcOffsetMinutes", options.utcOffsetMinutes);
+            Napi::Value retention = config.Get("retentionMs");
+            if (retention.IsObject()) {
+                Napi::Object retentionObject = retention.As<Napi::Object>();
+                auto readRetention = [&](const char* name, int64_t& target) {
+                    Napi::Value value = retentionObject.Get(name);
+                    if (value.IsNumber()) {
+                        target = value.As<Napi::Number>().Int64Value();
+                    }
+                };
+                readRetention("minute", options.minuteRetentionMs);
+                readRetention("hour", options.hourRetentionMs);
+                readRetention("day", options.dayRetentionMs);
+            }
+        }
+        aggregator_ = std::make_unique<UsageAggregator>(options);
+    }
+
+   private:
+    Napi::Value Record(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        int64_t timestamp = TimestampArg(info, 1);
+        if (info.Length() == 0 || info[0].IsNull() || info[0].IsUndefined()) {
+            aggregator_->RecordGap(timestamp);
+            return env.Undefined();
+        }
+        if (!info[0].IsObject()) {
+            Napi::TypeError::New(env, "record() expects a window info object or null")
+                .ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        ActiveWindowInfo windowInfo;
+        FromJsObject(info[0].As<Napi::Object>(), windowInfo);
+        aggregator_->Record(windowInfo, timestamp);
+        return env.Undefined();
+    }
+
+    Napi::Value Sample(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        int64_t timestamp = TimestampArg(info, 0);
+        // Skip the X11/AT-SPI work entirely while nobody is in front of the screen.
+        if (idle_monitor::IsAway()) {
+            aggregator_->RecordGap(timestamp);
+            return env.Null();
+        }
+        ActiveWindowInfo windowInfo;
+        if (!GetActiveWindowInfo(windowInfo)) {
+            aggregator_->RecordGap(timestamp);
+            return env.Null();
+        }
+        aggregator_->Record(windowInfo, timestamp);
+        return ToJsObject(env, windowInfo);
+    }
+
+    Napi::Value Query(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() == 0 || !info[0].IsObject()) {
+            Napi::TypeError::New(env, "query() expects an options object")
+                .ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        Napi::Object options = info[0].As<Napi::Object>();
+        UsageQuery query;
+        Napi::Value from = options.Get("from");
+        Napi::Value to = options.Get("to");
+        query.from = from.IsUndefined() ? 0 : from.ToNumber().As<Napi::Number>().Int64Value();
+        query.to =
+            to.IsUndefined() ? NowMs() + 1 : to.ToNumber().As<Napi::Number>().Int64Value();
+
+        Napi::Value bucket = options.Get("bucket");
+        if (!bucket.IsUndefined() &&
+            (!bucket.IsString() ||
+             !ParseUsageBucket(bucket.As<Napi::String>().Utf8Value(), query.bucket))) {
+            Napi::TypeError::New(env, "bucket must be 'minute', 'hour' or 'day'")
+                .ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+
+        Napi::Value groupBy = options.Get("groupBy");
+        if (!groupBy.IsUndefined()) {
+            query.groupBy = 0;
+            bool valid = true;
+            if (groupBy.IsString()) {
+                valid = ParseUsageGroupBy(groupBy.As<Napi::String>().Utf8Value(), query.groupBy);
+            } else if (groupBy.IsArray()) {
+                Napi::Array names = groupBy.As<Napi::Array>();
+                for (uint32_t i = 0; i < names.Length() && valid; ++i) {
+                    Napi::Value name = names.Get(i);
+                    valid = name.IsString() &&
+                            ParseUsageGroupBy(name.As<Napi::String>().Utf8Value(), query.groupBy);
+                }
+            } else {
+                valid = false;
+            }
+            if (!valid) {
+                Napi::TypeError::New(env,
+                                     "groupBy must be 'app', 'website', 'title' or an array of them")
+                    .ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+        }
+
+        std::vector<UsageRow> rows = aggregator_->Query(query);
+        Napi::Array result = Napi::Array::New(env, rows.size());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            const UsageRow& row = rows[i];
+            Napi::Object entry = Napi::Object::New(env);
+            entry.Set("from", Napi::Number::New(env, static_cast<double>(row.bucketStart)));
+            entry.Set("to", Napi::Number::New(env, static_cast<double>(row.bucketEnd)));
+            if (query.groupBy & kGroupByApp) {
+                entry.Set("app", row.app);
+            }
+            if (query.groupBy & kGroupByWebsite) {
+                if (row.website.empty()) {
+                    entry.Set("website", env.Null());
+                } else {
+                    entry.Set("website", row.website);
+                }
+            }
+            if (query.groupBy & kGroupByTitle) {
+                entry.Set("title", row.title);
+            }
+            entry.Set("durationMs", Napi::Number::New(env, static_cast<double>(row.durationMs)));
+            entry.Set("samples", Napi::Number::New(env, static_cast<double>(row.samples)));
+            result.Set(static_cast<uint32_t>(i), entry);
+        }
+        return result;
+    }
+
+    Napi::Value Clear(const Napi::CallbackInfo& info) {
+        aggregator_->Clear();
+        return info.Env().Undefined();
+    }
+
+    std::unique_ptr<UsageAggregator> aggregator_;
+};
+
+// Rules arrive as [{ processName, title, url, caseInsensitive }] with RE2 pattern strings;
+// the JS wrapper maps the returned rule index to the caller's category.
+class WindowClassifierWrap : public Napi::ObjectWrap<WindowClassifierWrap> {
+   public:
+    static Napi::Function Define(Napi::Env env) {
+        return DefineClass(env, "WindowClassifier",
+                           {InstanceMethod("classify", &WindowClassifierWrap::Classify),
+                            InstanceMethod("getActiveWindow", &WindowClassifierWrap::GetActiveWindow),
+                            InstanceMethod("stats", &WindowClassifierWrap::Stats)});
+    }
+
+    explicit WindowClassifierWrap(const Napi::CallbackInfo& info)
+        : Napi::ObjectWrap<WindowClassifierWrap>(info) {
+        Napi::Env env = info.Env();
+        if (info.Length() == 0 || !info[0].IsArray()) {
+            Napi::TypeError::New(env, "WindowClassifier expects an array of rules")
+                .ThrowAsJavaScriptException();
+            return;
+        }
+        size_t cacheSize = 4096;
+        if (info.Length() > 1 && info[1].IsObject()) {
+            Napi::Value value = info[1].As<Napi::Object>().Get("cacheSize");
+            if (value.IsNumber()) {
+                double number = value.As<Napi::Number>().DoubleValue();
+                cacheSize = number > 0 ? static_cast<size_t>(number) : 0;
+            }
+        }
+
+        Napi::Array array = info[0].As<Napi::Array>();
+        std::vector<ClassifierRule> rules(array.Length());
+        for (uint32_t i = 0; i < array.Length(); ++i) {
+            Napi::Value entry = array.Get(i);
+            if (!entry.IsObject()) {
+                Napi::TypeError::New(env, "rule " + std::to_string(i) + " is not an object")
+                    .ThrowAsJavaScriptException();
+                return;
+            }
+            Napi::Object rule = entry.As<Napi::Object>();
+            rules[i].processName = GetStringField(rule, "processName");
+            rules[i].title = GetStringField(rule, "title");
+            rules[i].url = GetStringField(rule, "url");
+            Napi::Value caseInsensitive = rule.Get("caseInsensitive");
+            rules[i].caseInsensitive =
+                caseInsensitive.IsBoolean() && caseInsensitive.As<Napi::Boolean>().Value();
+        }
+
+        classifier_ = std::make_unique<WindowClassifier>(cacheSize);
+        std::string error;
+        if (!classifier_->Compile(rules, error)) {
+            Napi::TypeError::New(env, "Invalid rule: " + error).ThrowAsJavaScriptException();
+        }
+    }
+
+   private:
+    // classify(info) -> rule index, or -1. Accepts a native sample or a getActiveWindow() result.
+    // Throws when RE2 gives up on a field rather than reporting "no rule".
+    Napi::Value Classify(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() == 0 || !info[0].IsObject()) {
+            Napi::TypeError::New(env, "classify() expects a window info object")
+                .ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        ActiveWindowInfo windowInfo;
+        FromJsObject(info[0].As<Napi::Object>(), windowInfo);
+        int rule = ClassifyInfo(windowInfo);
+        if (rule == WindowClassifier::kMatchFailed) {
+            Napi::Error::New(env, "Classifier " + classifier_->lastError())
+                .ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        return Napi::Number::New(env, rule);
+    }
+
+    // Queries and classifies without converting the strings to JS and back; the result
+    // carries the rule index as `rule`, and `categoryError` when matching failed.
+    Napi::Value GetActiveWindow(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        ActiveWindowInfo windowInfo;
+        if (!GetActiveWindowInfo(windowInfo)) {
+            return env.Null();
+        }
+        Napi::Object result = ToJsObject(env, windowInfo);
+        int rule = ClassifyInfo(windowInfo);
+        result.Set("rule", Napi::Number::New(env, rule));
+        if (rule == WindowClassifier::kMatchFailed) {
+            result.Set("categoryError", Napi::String::New(env, classifier_->lastError()));
+        }
+        return result;
+    }
+
+    Napi::Value Stats(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("rules", Napi::Number::New(env, static_cast<double>(classifier_->ruleCount())));
+        result.Set("lookups",
+                   Napi::Number::New(env, static_cast<double>(classifier_->stats().lookups)));
+        result.Set("cacheHits",
+                   Napi::Number::New(env, static_cast<double>(classifier_->stats().cacheHits)));
+        result.Set("matchErrors",
+                   Napi::Number::New(env, static_cast<double>(classifier_->stats().matchErrors)));
+        return result;
+    }
+
+    int ClassifyInfo(const ActiveWindowInfo& windowInfo) {
+        return classifier_->Classify(windowInfo.processName, windowInfo.title,
+                                     windowInfo.browserUrl);
+    }
+
+    std::unique_ptr<WindowClassifier> classifier_;
+};
+
+class DisplaySessionWrap : public Napi::ObjectWrap<DisplaySessionWrap> {
+   public:
+    static Napi::Function Define(Napi::Env env) {
+        return DefineClass(env, "DisplaySession",
+                           {InstanceMethod("getActiveWindow", &DisplaySessionWrap::GetActiveWindow),
+                            InstanceMethod("close", &DisplaySessionWrap::Close)});
+    }
+
+    explicit DisplaySessionWrap(const Napi::CallbackInfo& info)
+        : Napi::ObjectWrap<DisplaySessionWrap>(info) {
+        Napi::Env env = info.Env();
+        if (info.Length() == 0 || !info[0].IsString()) {
+            Napi::TypeError::New(env, "DisplaySession expects a display name such as ':1'")
+                .ThrowAsJavaScriptException();
+            return;
+        }
+        std::string error;
+        session_ = DisplaySession::Open(info[0].As<Napi::String>().Utf8Value(), error);
+        if (!session_) {
+            Napi::Error::New(env, error).ThrowAsJavaScriptException();
+            return;
+        }
+        info.This().As<Napi::Object>().Set("display", session_->name());
+    }
+
+   private:
+    struct PendingQuery {
+        bool ok = false;
+        ActiveWindowInfo info;
+    };
+
+    Napi::Value GetActiveWindow(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        auto deferred = std::make_shared<Napi::Promise::Deferred>(env);
+        if (!session_) {
+            deferred->Reject(Napi::Error::New(env, "Display session is closed").Value());
+            return deferred->Promise();
+        }
+        // One short-lived TSFN per query carries the result back to this thread and keeps
+        // the process alive only while a query is outstanding.
+        Napi::ThreadSafeFunction tsfn = Napi::ThreadSafeFunction::New(
+            env, Napi::Function::New(env, [](const Napi::CallbackInfo&) {}),
+            "win-trace session", 0, 1);
+        session_->QueryAsync([tsfn, deferred](bool ok, const ActiveWindowInfo& windowInfo) {
+            auto* pending = new PendingQuery{ok, windowInfo};
+            napi_status status = tsfn.BlockingCall(
+                pending, [deferred](Napi::Env callEnv, Napi::Function, PendingQuery* data) {
+                    if (data->ok) {
+                        deferred->Resolve(ToJsObject(callEnv, data->info));
+                    } else {
+                        deferred->Resolve(callEnv.Null());
+                    }
+                    delete data;
+                });
+            if (status != napi_ok) {
+                delete pending;
+            }
+            tsfn.Release();
+        });
+        return deferred->Promise();
+    }
+
+    // Drops our reference only; an in-flight query keeps the session alive and the
+    // connection closes when it finishes, so JS never blocks on a slow lookup here.
+    Napi::Value Close(const Napi::CallbackInfo& info) {
+        session_.reset();
+        return info.Env().Undefined();
+    }
+
+    std::shared_ptr<DisplaySession> session_;
+};
+
+Napi::Object GeometryUpdateToJs(Napi::Env env, const GeometryUpdate& update) {
+    Napi::Object event = Napi::Object::New(env);
+    event.Set("id", Napi::Number::New(env, static_cast<double>(update.windowId)));
+    Napi::Object bounds = Napi::Object::New(env);
+    bounds.Set("x", update.bounds.x);
+    bounds.Set("y", update.bounds.y);
+    bounds.Set("width", update.bounds.width);
+    bounds.Set("height", update.bounds.height);
+    event.Set("bounds", bounds);
+    Napi::Object extents = Napi::Object::New(env);
+    extents.Set("left", update.frameExtents.left);
+    extents.Set("right", update.frameExtents.right);
+    extents.Set("top", update.frameExtents.top);
+    extents.Set("bottom", update.frameExtents.bottom);
+    event.Set("frameExtents", extents);
+    return event;
+}
+
+Napi::Object ActivitySampleToJs(Napi::Env env, const ActivitySample& sample) {
+    Napi::Object event = Napi::Object::New(env);
+    event.Set("id", Napi::Number::New(env, static_cast<double>(sample.windowId)));
+    event.Set("damagedPixels", Napi::Number::New(env, static_cast<double>(sample.damagedPixels)));
+    event.Set("damageEvents", Napi::Number::New(env, sample.damageEvents));
+    event.Set("activityScore", Napi::Number::New(env, sample.activityScore));
+    event.Set("intervalMs", Napi::Number::New(env, sample.intervalMs));
+    return event;
+}
+
+struct WindowResult {
+    bool ok = false;
+    ActiveWindowInfo info;
+};
+
+Napi::Value WindowResultToJs(Napi::Env env, const WindowResult& result) {
+    if (!result.ok) {
+        return env.Null();
+    }
+    return ToJsObject(env, result.info);
+}
+
+// Core listener that copies each event over to tsfn's JS thread. Events are dropped when
+// that thread is behind (queue full) or shutting down.
+template <typename Event, typename ToJs>
+std::function<void(const Event&)> ForwardTo(Napi::ThreadSafeFunction tsfn, ToJs toJs) {
+    return [tsfn, toJs](const Event& event) {
+        auto* copy = new Event(event);
+        napi_status status = tsfn.NonBlockingCall(
+            copy, [toJs](Napi::Env callEnv, Napi::Function jsCallback, Event* data) {
+                jsCallback.Call({toJs(callEnv, *data)});
+                delete data;
+            });
+        if (status != napi_ok) {
+            delete copy;
+        }
+    };
+}
+
+void ReleaseCallback(Napi::ThreadSafeFunction& callback) {
+    if (callback) {
+        callback.Release();
+        callback = Napi::ThreadSafeFunction();
+    }
+}
+
+// What one environment has subscribed to in the shared core. Touched only on that
+// environment's JS thread; shared with the cleanup hook so whichever of the hook and
+// the instance-data finalizer runs first can drop everything.
+struct EnvSubscriptions {
+    uint64_t idleId = 0;
+    Napi::ThreadSafeFunction idleCallback;
+    uint64_t geometryId = 0;
+    Napi::ThreadSafeFunction geometryCallback;
+    uint64_t activityId = 0;
+    Napi::ThreadSafeFunction activityCallback;
+    std::map<uint64_t, Napi::ThreadSafeFunction> windowCallbacks;
+    bool publishing = false;
+
+    void StopIdle() {
+        if (idleId != 0) {
+            tracker_core::UnsubscribeIdle(idleId);
+            idleId = 0;
+        }
+        ReleaseCallback(idleCallback);
+    }
+
+    void StopGeometry() {
+        if (geometryId != 0) {
+            tracker_core::UnsubscribeGeometry(geometryId);
+            geometryId = 0;
+        }
+        ReleaseCallback(geometryCallback);
+    }
+
+    void StopActivity() {
+        if (activityId != 0) {
+            tracker_core::UnsubscribeActivity(activityId);
+            activityId = 0;
+        }
+        ReleaseCallback(activityCallback);
+    }
+
+    void StopPublisher() {
+        if (publishing) {
+            focus_publisher::Stop();
+            publishing = false;
+        }
+    }
+
+    bool StopWindow(uint64_t id) {
+        auto it = windowCallbacks.find(id);
+        if (it == windowCallbacks.end()) {
+            return false;
+        }
+        tracker_core::UnsubscribeActiveWindow(id);
+        ReleaseCallback(it->second);
+        windowCallbacks.erase(it);
+        return true;
+    }
+
+    void Shutdown() {
+        StopIdle();
+        StopGeometry();
+        StopActivity();
+        StopPublisher();
+        while (!windowCallbacks.empty()) {
+            StopWindow(windowCallbacks.begin()->first);
+        }
+    }
+};
+
+}  // namespace
+
+// getActiveWindow({ processTreeMemory })
+Napi::Value GetActiveWindowWrapped(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    ActiveWindowQueryOptions options;
+    options.useEventCaches = true;
+    if (info.Length() > 0 && info[0].IsObject()) {
+        Napi::Value tree = info[0].As<Napi::Object>().Get("processTreeMemory");
+        options.processTreeMemory = tree.IsBoolean() && tree.As<Napi::Boolean>().Value();
+    }
+    ActiveWindowInfo windowInfo;
+    if (!GetActiveWindowInfo(windowInfo, options)) {
+        return env.Null();
+    }
+    return ToJsObject(env, windowInfo);
 }
 
-NODE_API_MODULE(activewin, Init)
+Napi::Value GetIdleStateWrapped(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    IdleState state;
+    if (!idle_monitor::Query(state)) {
+        return env.Null();
+    }
+    return IdleStateToJs(env, state);
+}
+
+Napi::Value CaptureActiveWindowWrapped(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    CaptureOptions options;
+    if (info.Length() > 0 && info[0].IsObject()) {
+        Napi::Object config = info[0].As<Napi::Object>();
+        Napi::Value maxWidth = config.Get("maxWidth");
+        if (!maxWidth.IsUndefined() &&
+            (!maxWidth.IsNumber() || maxWidth.As<Napi::Number>().DoubleValue() < 0)) {
+            Napi::TypeError::New(env, "maxWidth must be a non-negative number")
+                .ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        if (maxWidth.IsNumber()) {
+            options.maxWidth = maxWidth.As<Napi::Number>().Uint32Value();
+        }
+        Napi::Value windowId = config.Get("windowId");
+        if (windowId.IsNumber()) {
+            options.windowId = static_cast<uint64_t>(windowId.As<Napi::Number>().Int64Value());
+        }
+    }
+
+    CapturedImage image;
+    if (!CaptureActiveWindow(options, image)) {
+        return env.Null();
+    }
+    size_t byteLength = static_cast<size_t>(image.width) * image.height * 4;
+    // Decided at runtime: the same binary can load in Node and in Electron, whose V8
+    // memory cage rejects external backing stores (napi_no_external_buffers_allowed). There
+    // the pixels are copied once and the native buffer freed here, as no finalizer will run.
+    napi_value external = nullptr;
+    napi_status status = napi_create_external_arraybuffer(
+        env, image.pixels, byteLength,
+        [](napi_env, void* pixels, void*) { FreeCapturePixels(static_cast<uint8_t*>(pixels)); },
+        nullptr, &external);
+    Napi::ArrayBuffer data;
+    if (status == napi_ok) {
+        data = Napi::ArrayBuffer(env, external);
+    } else {
+        if (env.IsExceptionPending()) {
+            env.GetAndClearPendingException();
+        }
+        data = Napi::ArrayBuffer::New(env, byteLength);
+        std::memcpy(data.Data(), image.pixels, byteLength);
+        FreeCapturePixels(image.pixels);
+    }
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("width", Napi::Number::New(env, image.width));
+    result.Set("height", Napi::Number::New(env, image.height));
+    result.Set("windowId", Napi::Number::New(env, static_cast<double>(image.windowId)));
+    Napi::Object bounds = Napi::Object::New(env);
+    bounds.Set("x", image.bounds.x);
+    bounds.Set("y", image.bounds.y);
+    bounds.Set("width", image.bounds.width);
+    bounds.Set("height", image.bounds.height);
+    result.Set("bounds", bounds);
+    result.Set("data", data);
+    return result;
+}
+
+// getWindowIcon(id, size): id 0 or null for the active window, size defaults to 32.
+Napi::Value GetWindowIconWrapped(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    uint64_t windowId = 0;
+    uint32_t size = 32;
+    if (info.Length() > 0 && info[0].IsNumber()) {
+        windowId = static_cast<uint64_t>(info[0].As<Napi::Number>().Int64Value());
+    } else if (info.Length() > 0 && !info[0].IsNull() && !info[0].IsUndefined()) {
+        Napi::TypeError::New(env, "getWindowIcon() expects a window id or null")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (info.Length() > 1 && !info[1].IsUndefined()) {
+        double value = info[1].IsNumber() ? info[1].As<Napi::Number>().DoubleValue() : 0;
+        if (!(value >= 1 && value <= 1024)) {
+            Napi::TypeError::New(env, "size must be a number from 1 to 1024")
+                .ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        size = static_cast<uint32_t>(value);
+    }
+
+    WindowIcon icon;
+    if (!GetWindowIcon(windowId, size, icon)) {
+        return env.Null();
+    }
+    // A copy: the cached pixels are shared by every caller.
+    Napi::ArrayBuffer data = Napi::ArrayBuffer::New(env, icon.pixels.size());
+    std::memcpy(data.Data(), icon.pixels.data(), icon.pixels.size());
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("width", Napi::Number::New(env, icon.width));
+    result.Set("height", Napi::Number::New(env, icon.height));
+    result.Set("data", data);
+    return result;
+}
+
+// Builds a synthetic tree and runs the same lookup QueryBrowserUrl runs on AT-SPI.
+Napi::Value BenchmarkTreeSearchWrapped(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    SyntheticTreeOptions options;
+    if (info.Length() > 0 && info[0].IsObject()) {
+        Napi::Object config = info[0].As<Napi::Object>();
+        Napi::Value shape = config.Get("shape");
+        if (!shape.IsUndefined() &&
+            (!shape.IsString() ||
+             !ParseSyntheticShape(shape.As<Napi::String>().Utf8Value(), options.shape))) {
+            Napi::TypeError::New(env, "shape must be 'chromium' or 'firefox'")
+                .ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        auto readCount = [&](const char* name, auto& target) {
+            Napi::Value value = config.Get(name);
+            if (value.IsNumber()) {
+                double number = value.As<Napi::Number>().DoubleValue();
+                target = static_cast<std::remove_reference_t<decltype(target)>>(
+                    number > 0 ? number : 0);
+            }
+        };
+        readCount("nodes", options.nodes);
+        readCount("apps", options.unrelatedApps);
+        readCount("appNodes", options.nodesPerUnrelatedApp);
+        readCount("addressBarDepth", options.addressBarDepth);
+        readCount("latencyUs", options.latencyUs);
+        Napi::Value documentUrl = config.Get("documentUrl");
+        if (documentUrl.IsBoolean()) {
+            options.exposeDocumentUrl = documentUrl.As<Napi::Boolean>().Value();
+        }
+    }
+
+    SyntheticTree tree(options);
+    tree.ResetStats();
+    UrlSearchStats stats;
+    auto started = std::chrono::steady_clock::now();
+    std::string url = FindBrowserUrl(tree, {tree.browserPid()}, tree.processName(),
+                                     tree.windowTitle(), nullptr, &stats);
+    double elapsedMs = std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - started)
+                           .count();
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("url", url.empty() ? env.Null() : Napi::String::New(env, url));
+    static const char* const kSources[] = {"none", "document", "addressBar"};
+    result.Set("source", Napi::String::New(env, kSources[static_cast<int>(stats.source)]));
+    result.Set("treeNodes", Napi::Number::New(env, static_cast<double>(tree.size())));
+    result.Set("nodesVisited", Napi::Number::New(env, static_cast<double>(stats.nodesVisited)));
+    result.Set("calls", Napi::Number::New(env, static_cast<double>(tree.stats().calls)));
+    result.Set("refs", Napi::Number::New(env, static_cast<double>(tree.stats().refs)));
+    result.Set("elapsedMs", Napi::Number::New(env, elapsedMs));
+    return result;
+}
+
+// replayLookupTrace(path, { timing: 'original' | 'instant' }) reruns a recorded lookup:
+// the URL search runs against the recorded answers, and with original timing every
+// recorded step and call takes as long as it did on the user's machine.
+Napi::Value ReplayLookupTraceWrapped(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() == 0 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "replayLookupTrace() expects a trace file path")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    ReplayTiming timing = ReplayTiming::Original;
+    if (info.Length() > 1 && info[1].IsObject()) {
+        Napi::Value value = info[1].As<Napi::Object>().Get("timing");
+        if (value.IsString()) {
+            std::string name = value.As<Napi::String>().Utf8Value();
+            if (name == "instant") {
+                timing = ReplayTiming::Instant;
+            } else if (name != "original") {
+                Napi::TypeError::New(env, "timing must be 'original' or 'instant'")
+                    .ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+        }
+    }
+
+    LookupTrace trace;
+    std::string error;
+    if (!ReadLookupTrace(info[0].As<Napi::String>().Utf8Value(), trace, error)) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    ReplayTree tree(trace, timing);
+    auto started = std::chrono::steady_clock::now();
+    if (timing == ReplayTiming::Original) {
+        for (const TraceStep& step : trace.steps) {
+            SpinMicros(step.micros);
+        }
+    }
+    PidSet pids = {trace.pid};
+    pids.insert(pids.end(), trace.sandboxPids.begin(), trace.sandboxPids.end());
+    WindowScope window;
+    window.bounds = trace.bounds;
+    std::string url = FindBrowserUrl(tree, pids, trace.processName, trace.title, nullptr,
+                                     nullptr, nullptr, &window);
+    double elapsedMs = std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - started)
+                           .count();
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("url", url.empty() ? env.Null() : Napi::String::New(env, url));
+    result.Set("recordedUrl",
+               trace.url.empty() ? env.Null() : Napi::String::New(env, trace.url));
+    result.Set("matches", Napi::Boolean::New(env, url == trace.url));
+    result.Set("calls", Napi::Number::New(env, static_cast<double>(tree.stats().calls)));
+    result.Set("recordedCalls", Napi::Number::New(env, static_cast<double>(trace.calls.size())));
+    result.Set("misses", Napi::Number::New(env, static_cast<double>(tree.misses())));
+    result.Set("elapsedMs", Napi::Number::New(env, elapsedMs));
+    result.Set("recordedMs", Napi::Number::New(env, trace.RecordedMicros() / 1000.0));
+    return result;
+}
+
+// setAccessibilityTimeouts({ callMs, startupMs, backoffMs, maxBackoffMs }); omitted fields
+// take their defaults.
+Napi::Value SetAccessibilityTimeoutsWrapped(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() == 0 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "setAccessibilityTimeouts() expects an options object")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    Napi::Object config = info[0].As<Napi::Object>();
+    AccessibilityTimeouts timeouts;
+    // callMs 0 would switch off the call timer, and with it the circuit breaker.
+    const struct {
+        const char* name;
+        double min;
+        double max;
+    } kFields[] = {{"callMs", 1, 120000}, {"startupMs", 0, 120000}, {"backoffMs", 0, 86400000},
+                   {"maxBackoffMs", 0, 86400000}};
+    double values[4] = {static_cast<double>(timeouts.callMs),
+                        static_cast<double>(timeouts.startupMs),
+                        static_cast<double>(timeouts.backoffMs),
+                        static_cast<double>(timeouts.maxBackoffMs)};
+    for (size_t i = 0; i < 4; ++i) {
+        Napi::Value value = config.Get(kFields[i].name);
+        if (value.IsUndefined()) {
+            continue;
+        }
+        double number = value.IsNumber() ? value.As<Napi::Number>().DoubleValue() : -1;
+        // Negated so NaN is rejected too.
+        if (!(number >= kFields[i].min && number <= kFields[i].max)) {
+            Napi::TypeError::New(env, std::string(kFields[i].name) + " is out of range")
+                .ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        values[i] = number;
+    }
+    timeouts.callMs = static_cast<int>(values[0]);
+    timeouts.startupMs = static_cast<int>(values[1]);
+    timeouts.backoffMs = static_cast<uint32_t>(values[2]);
+    timeouts.maxBackoffMs = static_cast<uint32_t>(values[3]);
+    SetAccessibilityTimeouts(timeouts);
+    return env.Undefined();
+}
+
+// setAccessibilityCacheLimit(maxProxies)
+Napi::Value SetAccessibilityCacheLimitWrapped(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() == 0 || !info[0].IsNumber() || info[0].As<Napi::Number>().DoubleValue() < 0) {
+        Napi::TypeError::New(env, "setAccessibilityCacheLimit() expects a non-negative number")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    SetAccessibleProxyLimit(static_cast<size_t>(info[0].As<Napi::Number>().DoubleValue()));
+    return env.Undefined();
+}
+
+Napi::Value GetAccessibilityCacheStatsWrapped(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    AccessibilityCacheStats stats;
+    if (!GetAccessibilityCacheStats(stats)) {
+        return env.Null();
+    }
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("liveProxies", Napi::Number::New(env, static_cast<double>(stats.liveProxies)));
+    result.Set("applications", Napi::Number::New(env, static_cast<double>(stats.applications)));
+    result.Set("evicted", Napi::Number::New(env, static_cast<double>(stats.evicted)));
+    result.Set("trims", Napi::Number::New(env, static_cast<double>(stats.trims)));
+    return result;
+}
+
+// setLookupRecording(dir) starts writing a trace per browser lookup; null stops.
+Napi::Value SetLookupRecordingWrapped(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() > 0 && info[0].IsString()) {
+        SetLookupRecordDir(info[0].As<Napi::String>().Utf8Value());
+    } else if (info.Length() == 0 || info[0].IsNull() || info[0].IsUndefined()) {
+        SetLookupRecordDir(std::string());
+    } else {
+        Napi::TypeError::New(env, "setLookupRecording() expects a directory or null")
+            .ThrowAsJavaScriptException();
+    }
+    return env.Undefined();
+}
+
+// setTraceEventFile(path) writes each lookup stage to path as Chrome trace events; null
+// closes the file.
+Napi::Value SetTraceEventFileWrapped(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    std::string path;
+    if (info.Length() > 0 && info[0].IsString()) {
+        path = info[0].As<Napi::String>().Utf8Value();
+    } else if (!(info.Length() == 0 || info[0].IsNull() || info[0].IsUndefined())) {
+        Napi::TypeError::New(env, "setTraceEventFile() expects a file path or null")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    std::string error;
+    if (!SetTraceEventFile(path, error)) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+    }
+    return env.Undefined();
+}
+
+// Instance data for one environment (the main thread, a worker_thread, or one of several
+// contexts in an Electron process). Everything process-wide lives in tracker_core and the
+// modules below it; this only tracks what the environment subscribed to.
+class WinTraceAddon : public Napi::Addon<WinTraceAddon> {
+   public:
+    WinTraceAddon(Napi::Env env, Napi::Object exports)
+        : subscriptions_(std::make_shared<EnvSubscriptions>()) {
+#ifdef __linux__
+        // Sessions, the event loop and the sync API use separate connections from several
+        // threads; Xlib needs this before any other call, once per process.
+        static std::once_flag xlibThreads;
+        std::call_once(xlibThreads, []() { XInitThreads(); });
+#endif
+        std::shared_ptr<EnvSubscriptions> subscriptions = subscriptions_;
+        env.AddCleanupHook([subscriptions]() { subscriptions->Shutdown(); });
+
+        DefineAddon(exports,
+                    {InstanceMethod("startIdleMonitor", &WinTraceAddon::StartIdleMonitor),
+                     InstanceMethod("stopIdleMonitor", &WinTraceAddon::StopIdleMonitor),
+                     InstanceMethod("startGeometryTracking", &WinTraceAddon::StartGeometryTracking),
+                     InstanceMethod("stopGeometryTracking", &WinTraceAddon::StopGeometryTracking),
+                     InstanceMethod("startActivityTracking", &WinTraceAddon::StartActivityTracking),
+                     InstanceMethod("stopActivityTracking", &WinTraceAddon::StopActivityTracking),
+                     InstanceMethod("startFocusPublisher", &WinTraceAddon::StartFocusPublisher),
+                     InstanceMethod("stopFocusPublisher", &WinTraceAddon::StopFocusPublisher),
+                     InstanceMethod("subscribeActiveWindow", &WinTraceAddon::SubscribeActiveWindow),
+                     InstanceMethod("unsubscribeActiveWindow",
+                                    &WinTraceAddon::UnsubscribeActiveWindow)});
+        exports.Set("getActiveWindow", Napi::Function::New(env, GetActiveWindowWrapped));
+        exports.Set("getIdleState", Napi::Function::New(env, GetIdleStateWrapped));
+        exports.Set("captureActiveWindow", Napi::Function::New(env, CaptureActiveWindowWrapped));
+        exports.Set("getWindowIcon", Napi::Function::New(env, GetWindowIconWrapped));
+        exports.Set("UsageAggregator", UsageAggregatorWrap::Define(env));
+        exports.Set("DisplaySession", DisplaySessionWrap::Define(env));
+        exports.Set("WindowClassifier", WindowClassifierWrap::Define(env));
+        exports.Set("benchmarkTreeSearch", Napi::Function::New(env, BenchmarkTreeSearchWrapped));
+        exports.Set("replayLookupTrace", Napi::Function::New(env, ReplayLookupTraceWrapped));
+        exports.Set("setAccessibilityTimeouts",
+                    Napi::Function::New(env, SetAccessibilityTimeoutsWrapped));
+        exports.Set("setAccessibilityCacheLimit",
+                    Napi::Function::New(env, SetAccessibilityCacheLimitWrapped));
+        exports.Set("getAccessibilityCacheStats",
+                    Napi::Function::New(env, GetAccessibilityCacheStatsWrapped));
+        exports.Set("setLookupRecording", Napi::Function::New(env, SetLookupRecordingWrapped));
+        exports.Set("setTraceEventFile", Napi::Function::New(env, SetTraceEventFileWrapped));
+    }
+
+    ~WinTraceAddon() { subscriptions_->Shutdown(); }
+
+   private:
+    Napi::Value StartIdleMonitor(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        uint64_t thresholdMs = 60000;
+        Napi::Function callback;
+        for (size_t i = 0; i < info.Length() && i < 2; ++i) {
+            if (info[i].IsFunction()) {
+                callback = info[i].As<Napi::Function>();
+            } else if (info[i].IsObject()) {
+                Napi::Value threshold = info[i].As<Napi::Object>().Get("idleThresholdMs");
+                if (threshold.IsNumber()) {
+                    double value = threshold.As<Napi::Number>().DoubleValue();
+                    thresholdMs = value > 0 ? static_cast<uint64_t>(value) : 0;
+                }
+            }
+        }
+
+        EnvSubscriptions& subscriptions = *subscriptions_;
+        subscriptions.StopIdle();
+        idle_monitor::Listener listener;
+        if (!callback.IsEmpty()) {
+            subscriptions.idleCallback =
+                Napi::ThreadSafeFunction::New(env, callback, "win-trace idle", 0, 1);
+            // Like an unref'd timer: watching presence must not keep the process alive.
+            subscriptions.idleCallback.Unref(env);
+            listener = ForwardTo<IdleState>(subscriptions.idleCallback, IdleStateToJs);
+        }
+        subscriptions.idleId = tracker_core::SubscribeIdle(thresholdMs, std::move(listener));
+        if (subscriptions.idleId == 0) {
+            ReleaseCallback(subscriptions.idleCallback);
+        }
+        return Napi::Boolean::New(env, subscriptions.idleId != 0);
+    }
+
+    Napi::Value StopIdleMonitor(const Napi::CallbackInfo& info) {
+        subscriptions_->StopIdle();
+        return info.Env().Undefined();
+    }
+
+    Napi::Value StartGeometryTracking(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        EnvSubscriptions& subscriptions = *subscriptions_;
+        subscriptions.StopGeometry();
+
+        geometry_tracker::Listener listener;
+        if (info.Length() > 0 && info[0].IsFunction()) {
+            subscriptions.geometryCallback = Napi::ThreadSafeFunction::New(
+                env, info[0].As<Napi::Function>(), "win-trace geometry", 0, 1);
+            subscriptions.geometryCallback.Unref(env);
+            listener = ForwardTo<GeometryUpdate>(subscriptions.geometryCallback, GeometryUpdateToJs);
+        }
+        subscriptions.geometryId = tracker_core::SubscribeGeometry(std::move(listener));
+        if (subscriptions.geometryId == 0) {
+            ReleaseCallback(subscriptions.geometryCallback);
+        }
+        return Napi::Boolean::New(env, subscriptions.geometryId != 0);
+    }
+
+    Napi::Value StopGeometryTracking(const Napi::CallbackInfo& info) {
+        subscriptions_->StopGeometry();
+        return info.Env().Undefined();
+    }
+
+    Napi::Value StartActivityTracking(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        uint32_t intervalMs = 1000;
+        Napi::Function callback;
+        for (size_t i = 0; i < info.Length() && i < 2; ++i) {
+            if (info[i].IsFunction()) {
+                callback = info[i].As<Napi::Function>();
+            } else if (info[i].IsObject()) {
+                Napi::Value interval = info[i].As<Napi::Object>().Get("intervalMs");
+                if (interval.IsNumber()) {
+                    double value = interval.As<Napi::Number>().DoubleValue();
+                    intervalMs = value > 0 ? static_cast<uint32_t>(value) : 0;
+                }
+            }
+        }
+
+        EnvSubscriptions& subscriptions = *subscriptions_;
+        subscriptions.StopActivity();
+        activity_tracker::Listener listener;
+        if (!callback.IsEmpty()) {
+            subscriptions.activityCallback =
+                Napi::ThreadSafeFunction::New(env, callback, "win-trace activity", 0, 1);
+            subscriptions.activityCallback.Unref(env);
+            listener = ForwardTo<ActivitySample>(subscriptions.activityCallback, ActivitySampleToJs);
+        }
+        subscriptions.activityId = tracker_core::SubscribeActivity(intervalMs, std::move(listener));
+        if (subscriptions.activityId == 0) {
+            ReleaseCallback(subscriptions.activityCallback);
+        }
+        return Napi::Boolean::New(env, subscriptions.activityId != 0);
+    }
+
+    Napi::Value StopActivityTracking(const Napi::CallbackInfo& info) {
+        subscriptions_->StopActivity();
+        return info.Env().Undefined();
+    }
+
+    // startFocusPublisher({ name, intervalMs }) shares the tracker's result with other
+    // processes through shared memory. One publisher per process; it stops with the
+    // environment that started it.
+    Napi::Value StartFocusPublisher(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        focus_publisher::Options options;
+        if (info.Length() > 0 && info[0].IsObject()) {
+            Napi::Object config = info[0].As<Napi::Object>();
+            Napi::Value name = config.Get("name");
+            if (name.IsString()) {
+                options.name = name.As<Napi::String>().Utf8Value();
+            }
+            Napi::Value interval = config.Get("intervalMs");
+            if (interval.IsNumber()) {
+                double value = interval.As<Napi::Number>().DoubleValue();
+                options.intervalMs = value > 0 ? static_cast<uint32_t>(value) : 0;
+            }
+        }
+        std::string error;
+        if (!focus_publisher::Start(options, error)) {
+            Napi::Error::New(env, error).ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        subscriptions_->publishing = true;
+        return env.Undefined();
+    }
+
+    Napi::Value StopFocusPublisher(const Napi::CallbackInfo& info) {
+        subscriptions_->StopPublisher();
+        return info.Env().Undefined();
+    }
+
+    // subscribeActiveWindow(callback, { intervalMs }) -> id. One poller serves every
+    // subscriber in the process; like setInterval, a subscription keeps the event loop
+    // alive until it is unsubscribed.
+    Napi::Value SubscribeActiveWindow(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() == 0 || !info[0].IsFunction()) {
+            Napi::TypeError::New(env, "subscribeActiveWindow expects a callback")
+                .ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        uint32_t intervalMs = 1000;
+        if (info.Length() > 1 && info[1].IsObject()) {
+            Napi::Value interval = info[1].As<Napi::Object>().Get("intervalMs");
+            if (interval.IsNumber()) {
+                double value = interval.As<Napi::Number>().DoubleValue();
+                intervalMs = value > 0 ? static_cast<uint32_t>(value) : 0;
+            }
+        }
+
+        // A queue of two: a JS thread that falls behind skips polls instead of piling them up.
+        Napi::ThreadSafeFunction tsfn = Napi::ThreadSafeFunction::New(
+            env, info[0].As<Napi::Function>(), "win-trace active window", 2, 1);
+        auto forward = ForwardTo<WindowResult>(tsfn, WindowResultToJs);
+        uint64_t id = tracker_core::SubscribeActiveWindow(
+            intervalMs, [forward](bool ok, const ActiveWindowInfo& windowInfo) {
+                forward(WindowResult{ok, windowInfo});
+            });
+        subscriptions_->windowCallbacks.emplace(id, tsfn);
+        return Napi::Number::New(env, static_cast<double>(id));
+    }
+
+    Napi::Value UnsubscribeActiveWindow(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() == 0 || !info[0].IsNumber()) {
+            return Napi::Boolean::New(env, false);
+        }
+        uint64_t id = static_cast<uint64_t>(info[0].As<Napi::Number>().Int64Value());
+        return Napi::Boolean::New(env, subscriptions_->StopWindow(id));
+    }
+
+    std::shared_ptr<EnvSubscriptions> subscriptions_;
+};
+
+NODE_API_ADDON(WinTraceAddon)
@@ -0,0 +1,48 @@
+#include "app_breaker.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "debug_log.h"
+
+void AppCircuitBreaker::Configure(uint32_t backoffMs, uint32_t maxBackoffMs) {
+    backoffMs_ = backoffMs;
+    maxBackoffMs_ = std::max(backoffMs, maxBackoffMs);
+}
+
+bool AppCircuitBreaker::Allow(const std::string& app, Clock::time_point now) const {
+    if (app.empty()) {
+        return true;
+    }
+    auto it = apps_.find(app);
+    return it == apps_.end() || now >= it->second.retryAt;
+}
+
+void AppCircuitBreaker::RecordTimeout(const std::string& app, Clock::time_point now) {
+    if (app.empty() || backoffMs_ == 0) {
+        return;
+    }
+    // Apps that exited while backing off never answer again; forget them once even the
+    // longest backoff has passed.
+    const auto forgetAfter = std::chrono::milliseconds(maxBackoffMs_);
+    for (auto it = apps_.begin(); it != apps_.end();) {
+        it = now - it->second.retryAt > forgetAfter ? apps_.erase(it) : std::next(it);
+    }
+
+    Entry& entry = apps_[app];
+    uint64_t backoff = backoffMs_;
+    for (uint32_t i = 0; i < entry.timeouts && backoff < maxBackoffMs_; ++i) {
+        backoff *= 2;
+    }
+    backoff = std::min<uint64_t>(backoff, maxBackoffMs_);
+    ++entry.timeouts;
+    entry.retryAt = now + std::chrono::milliseconds(backoff);
+    DebugLog("Accessibility calls to %s timed out (%u in a row); skipping it for %llu ms",
+             app.c_str(), entry.timeouts, static_cast<unsigned long long>(backoff));
+}
+
+void AppCircuitBreaker::RecordSuccess(const std::string& app) {
+    if (!apps_.empty()) {
+        apps_.erase(app);
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// Skips applications whose accessibility calls recently timed out, so one hung app on the
+// desktop costs a single timeout instead of one per poll. A timeout opens the breaker for
+// backoffMs, doubling with every further timeout up to maxBackoffMs; when that has passed
+// the next lookup tries the app again, and an answered search closes the breaker.
+// Applications are keyed by AccessibleTree::ApplicationId; an empty id is never skipped.
+// Not thread-safe: callers hold the AT-SPI lock.
+class AppCircuitBreaker {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    AppCircuitBreaker(uint32_t backoffMs = 5000, uint32_t maxBackoffMs = 300000)
+        : backoffMs_(backoffMs), maxBackoffMs_(maxBackoffMs) {}
+
+    void Configure(uint32_t backoffMs, uint32_t maxBackoffMs);
+
+    // False while app is backing off.
+    bool Allow(const std::string& app, Clock::time_point now = Clock::now()) const;
+    void RecordTimeout(const std::string& app, Clock::time_point now = Clock::now());
+    void RecordSuccess(const std::string& app);
+
+    size_t openCount() const { return apps_.size(); }
+
+   private:
+    struct Entry {
+        uint32_t timeouts = 0;
+        Clock::time_point retryAt;
+    };
+
+    uint32_t backoffMs_;
+    uint32_t maxBackoffMs_;
+    std::unordered_map<std::string, Entry> apps_;
+};
@@ -0,0 +1,195 @@
+#include "atspi_env.h"
+
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include "debug_log.h"
+
+namespace {
+
+std::string ReadBinaryFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return std::string();
+    }
+    std::string data((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+    return data;
+}
+
+std::string ExtractEnvValue(const std::string& block, const std::string& key) {
+    if (block.empty()) {
+        return std::string();
+    }
+    size_t offset = 0;
+    while (offset < block.size()) {
+        size_t end = block.find('\0', offset);
+        if (end == std::string::npos) {
+            end = block.size();
+        }
+        if (end > offset) {
+            std::string entry = block.substr(offset, end - offset);
+            size_t equals = entry.find('=');
+            if (equals != std::string::npos && entry.compare(0, equals, key) == 0 &&
+                equals + 1 <= entry.size()) {
+                return entry.substr(equals + 1);
+            }
+        }
+        offset = end + 1;
+    }
+    return std::string();
+}
+
+bool ResolveAtspiEnvFromProcess(pid_t pid, AtspiBusEnv& env) {
+    std::string path = "/proc/" + std::to_string(pid) + "/environ";
+    std::string data = ReadBinaryFile(path);
+    if (data.empty()) {
+        DebugLog("Failed to read /proc/%d/environ", pid);
+        return false;
+    }
+
+    auto fillIfMissing = [&](const char* name, std::string& target) {
+        if (!target.empty()) {
+            return false;
+        }
+        std::string value = ExtractEnvValue(data, name);
+        if (value.empty()) {
+            return false;
+        }
+        target = value;
+        DebugLog("Adopted %s from pid %d", name, pid);
+        return true;
+    };
+
+    bool updated = false;
+    updated = fillIfMissing("DBUS_SESSION_BUS_ADDRESS", env.dbusSessionAddress) || updated;
+    updated = fillIfMissing("AT_SPI_BUS_ADDRESS", env.atspiBusAddress) || updated;
+    if (!updated) {
+        DebugLog("Process %d environment did not provide missing AT-SPI variables", pid);
+    }
+    return updated;
+}
+
+uid_t ReadProcessUid(pid_t pid, bool& exact) {
+    std::string path = "/proc/" + std::to_string(pid) + "/status";
+    std::ifstream file(path);
+    if (!file) {
+        DebugLog("Failed to open %s", path.c_str());
+        exact = false;
+        return static_cast<uid_t>(-1);
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.rfind("Uid:", 0) == 0) {
+            std::istringstream stream(line.substr(4));
+            long uidValue = -1;
+            stream >> uidValue;
+            if (uidValue >= 0) {
+                exact = true;
+                return static_cast<uid_t>(uidValue);
+            }
+            break;
+        }
+    }
+    DebugLog("Could not read UID for pid %d", pid);
+    exact = false;
+    return static_cast<uid_t>(-1);
+}
+
+bool ResolveAtspiEnvFromUid(uid_t uid, bool exactUid, AtspiBusEnv& env) {
+    if (uid == static_cast<uid_t>(-1)) {
+        return false;
+    }
+    std::string uidStr = std::to_string(static_cast<unsigned long>(uid));
+    auto fillIfMissing = [&](const char* name, std::string& target, const std::string& value) {
+        if (!target.empty()) {
+            return false;
+        }
+        target = value;
+        DebugLog("Synthesized %s from uid %s", name, uidStr.c_str());
+        return true;
+    };
+
+    bool updated = false;
+    std::string dbusPath = "/run/user/" + uidStr + "/bus";
+    if (access(dbusPath.c_str(), F_OK) == 0) {
+        updated = fillIfMissing("DBUS_SESSION_BUS_ADDRESS", env.dbusSessionAddress,
+                                "unix:path=" + dbusPath) ||
+                  updated;
+    }
+    std::string atspiPath = "/run/user/" + uidStr + "/at-spi2/bus";
+    if (access(atspiPath.c_str(), F_OK) == 0) {
+        updated = fillIfMissing("AT_SPI_BUS_ADDRESS", env.atspiBusAddress,
+                                "unix:path=" + atspiPath) ||
+                  updated;
+    }
+    if (!updated) {
+        DebugLog("Could not synthesize AT-SPI env for uid %s%s", uidStr.c_str(),
+                 exactUid ? "" : " (guessed)");
+    }
+    return updated;
+}
+
+}  // namespace
+
+bool ResolveAtspiEnv(pid_t pid, AtspiBusEnv& env) {
+    if (ResolveAtspiEnvFromProcess(pid, env)) {
+        return true;
+    }
+    bool exactUid = false;
+    uid_t uid = ReadProcessUid(pid, exactUid);
+    if (uid != static_cast<uid_t>(-1) && ResolveAtspiEnvFromUid(uid, exactUid, env)) {
+        return true;
+    }
+    if (gid_t gid = getgid(); gid >= 0) {
+        if (ResolveAtspiEnvFromUid(static_cast<uid_t>(gid), false, env)) {
+            return true;
+        }
+    }
+    const char* userEnv = std::getenv("SUDO_UID");
+    if (userEnv) {
+        long sudoUid = std::strtol(userEnv, nullptr, 10);
+        if (sudoUid >= 0 && ResolveAtspiEnvFromUid(static_cast<uid_t>(sudoUid), false, env)) {
+            return true;
+        }
+    }
+    uid_t realUid = getuid();
+    if (realUid != uid && ResolveAtspiEnvFromUid(realUid, false, env)) {
+        return true;
+    }
+    return false;
+}
+
+bool AdoptAtspiEnv(pid_t pid) {
+    AtspiBusEnv env;
+    const char* bus = std::getenv("DBUS_SESSION_BUS_ADDRESS");
+    const char* atspi = std::getenv("AT_SPI_BUS_ADDRESS");
+    bool hadBus = bus && bus[0] != '\0';
+    bool hadAtspi = atspi && atspi[0] != '\0';
+    if (hadBus) {
+        env.dbusSessionAddress = bus;
+    }
+    if (hadAtspi) {
+        env.atspiBusAddress = atspi;
+    }
+    if (!ResolveAtspiEnv(pid, env)) {
+        return false;
+    }
+    if (!hadBus && !env.dbusSessionAddress.empty()) {
+        setenv("DBUS_SESSION_BUS_ADDRESS", env.dbusSessionAddress.c_str(), 1);
+    }
+    if (!hadAtspi && !env.atspiBusAddress.empty()) {
+        setenv("AT_SPI_BUS_ADDRESS", env.atspiBusAddress.c_str(), 1);
+    }
+    return true;
+}
+
+bool AtspiEnvPresent() {
+    const char* bus = std::getenv("DBUS_SESSION_BUS_ADDRESS");
+    const char* atspi = std::getenv("AT_SPI_BUS_ADDRESS");
+    return (bus && bus[0] != '\0') && (atspi && atspi[0] != '\0');
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <string>
+
+// Bus addresses libatspi needs to reach the accessibility registry of a session.
+struct AtspiBusEnv {
+    std::string dbusSessionAddress;
+    std::string atspiBusAddress;
+};
+
+// Fills the empty fields of `env` from the environment of pid, then from the well-known
+// per-user socket paths. Returns true when at least one field was filled. Never touches
+// this process's environment, so it is safe to call for many sessions.
+bool ResolveAtspiEnv(pid_t pid, AtspiBusEnv& env);
+
+// Legacy single-session path: resolves like ResolveAtspiEnv and exports the result with
+// setenv so the next atspi_init() picks it up.
+bool AdoptAtspiEnv(pid_t pid);
+bool AtspiEnvPresent();
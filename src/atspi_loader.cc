@@ -0,0 +1,52 @@
+#include "atspi_loader.h"
+
+#include <dlfcn.h>
+
+#include <cstdlib>
+#include <string>
+
+#include "debug_log.h"
+
+namespace {
+
+const char kPluginName[] = "win_trace_atspi.so";
+
+// Next to activewin.node: both are products of the same gyp build.
+std::string DefaultPluginPath() {
+    Dl_info info;
+    if (dladdr(reinterpret_cast<void*>(&LoadAtspiPlugin), &info) == 0 || !info.dli_fname) {
+        return kPluginName;
+    }
+    std::string path(info.dli_fname);
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? kPluginName : path.substr(0, slash + 1) + kPluginName;
+}
+
+const AtspiPluginApi* Load() {
+    const char* overridePath = std::getenv("WIN_TRACE_ATSPI_PLUGIN");
+    std::string path = overridePath && overridePath[0] ? overridePath : DefaultPluginPath();
+    // RTLD_LOCAL keeps GLib's symbols out of the global namespace; the handle is never
+    // closed, since GLib cannot be unloaded.
+    void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        DebugLog("AT-SPI plugin unavailable (%s); browser URLs disabled", dlerror());
+        return nullptr;
+    }
+    using Entry = const AtspiPluginApi* (*)();
+    Entry entry = reinterpret_cast<Entry>(dlsym(handle, WIN_TRACE_ATSPI_PLUGIN_ENTRY));
+    const AtspiPluginApi* api = entry ? entry() : nullptr;
+    if (!api || api->version != WIN_TRACE_ATSPI_PLUGIN_VERSION) {
+        DebugLog("AT-SPI plugin %s does not match this addon; browser URLs disabled",
+                 path.c_str());
+        return nullptr;
+    }
+    DebugLog("AT-SPI plugin loaded from %s", path.c_str());
+    return api;
+}
+
+}  // namespace
+
+const AtspiPluginApi* LoadAtspiPlugin() {
+    static const AtspiPluginApi* api = Load();
+    return api;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "atspi_plugin.h"
+
+// dlopens win_trace_atspi.so from the addon's own directory (or $WIN_TRACE_ATSPI_PLUGIN)
+// on first use. Returns null, once and for good, when the module or libatspi is missing.
+// Call with the AT-SPI lock held.
+const AtspiPluginApi* LoadAtspiPlugin();
@@ -0,0 +1,49 @@
+#include "atspi_plugin.h"
+
+#include <atspi/atspi.h>
+
+#include "atspi_tree.h"
+#include "debug_log.h"
+
+namespace {
+
+bool Init() {
+    // libatspi sets its inited flag before it looks for the bus, so only the first call
+    // says anything: 0 connected, 2 no bus, 1 initialized by someone else. Every later
+    // call returns 1 whatever happened, and the outcome is final for the process.
+    static bool attempted = false;
+    static bool connected = false;
+    if (attempted) {
+        return connected;
+    }
+    attempted = true;
+    int result = atspi_init();
+    DebugLog("AT-SPI init returned %d", result);
+    if (result == 0) {
+        UseOwnMainContext();
+        connected = true;
+    } else if (result == 1) {
+        // The host set libatspi up and owns its context, so no window events are watched
+        // and the title index rescans instead.
+        connected = atspi_get_a11y_bus() != nullptr;
+        DebugLog("libatspi was initialized by the host (%s); not dispatching its events",
+                 connected ? "connected" : "no bus");
+    }
+    return connected;
+}
+
+AccessibleTree* Tree() {
+    static AtspiTree* tree = new AtspiTree();
+    return tree;
+}
+
+const AtspiPluginApi kApi = {
+    WIN_TRACE_ATSPI_PLUGIN_VERSION, Init, Tree, WatchTopLevelWindows, DispatchAtspiEvents,
+    SetAtspiTimeouts, TrimAtspiCache, GetAtspiCacheStats,
+};
+
+}  // namespace
+
+extern "C" __attribute__((visibility("default"))) const AtspiPluginApi* WinTraceAtspiPlugin() {
+    return &kApi;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "accessible_tree.h"
+
+// Boundary between the addon and win_trace_atspi.so, the module that links libatspi and
+// GLib. The addon dlopens it on the first browser URL lookup, so requiring the addon
+// never maps the accessibility stack, and a host without libatspi just gets no URLs.
+// Both sides are built from this tree by the same compiler: the tree crosses as a C++
+// object, everything else as plain functions. Bump the version on any change.
+#define WIN_TRACE_ATSPI_PLUGIN_VERSION 4
+
+enum AtspiWindowEventKind {
+    kAtspiWindowCreated = 0,
+    kAtspiWindowDestroyed = 1,
+    kAtspiWindowRenamed = 2,
+};
+
+// window is only borrowed for the duration of the call.
+using AtspiWindowEventFn = void (*)(void* context, AtspiWindowEventKind kind,
+                                    AccessibleTree::Node window);
+
+struct AtspiCacheStats {
+    uint64_t liveProxies;   // AtspiAccessible objects libatspi keeps for the walked apps
+    uint64_t applications;  // apps the tree has walked into
+    uint64_t evicted;       // proxies dropped by trims so far
+    uint64_t trims;
+};
+
+struct AtspiPluginApi {
+    uint32_t version;
+    // atspi_init() once per process; true when libatspi has an accessibility bus connection,
+    // also when the host initialized it first. A failure is final: libatspi cannot retry.
+    bool (*init)();
+    // Process-lifetime libatspi tree.
+    AccessibleTree* (*tree)();
+    // Starts delivering top-level window events to callback; see WatchTopLevelWindows.
+    bool (*watchTopLevelWindows)(AtspiWindowEventFn callback, void* context);
+    // Runs the handlers queued on libatspi's private GLib main context.
+    void (*dispatchEvents)();
+    // Per-call D-Bus timeouts; see SetAtspiTimeouts.
+    void (*setTimeouts)(int callMs, int startupMs);
+    // See TrimAtspiCache and GetAtspiCacheStats.
+    void (*trimCache)(size_t maxProxies);
+    void (*cacheStats)(AtspiCacheStats* stats);
+};
+
+#define WIN_TRACE_ATSPI_PLUGIN_ENTRY "WinTraceAtspiPlugin"
+extern "C" const AtspiPluginApi* WinTraceAtspiPlugin();
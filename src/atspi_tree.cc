@@ -0,0 +1,426 @@
+#include "atspi_tree.h"
+
+#include <atspi/atspi.h>
+#include <glib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "debug_log.h"
+
+namespace {
+
+AtspiAccessible* AsAccessible(AccessibleTree::Node node) {
+    return static_cast<AtspiAccessible*>(node);
+}
+
+void FreeGError(GError*& error) {
+    if (error) {
+        g_error_free(error);
+        error = nullptr;
+    }
+}
+
+// Takes ownership of a g_malloc'ed string.
+std::string TakeString(gchar* chars) {
+    if (!chars) {
+        return std::string();
+    }
+    std::string value(chars);
+    g_free(chars);
+    return value;
+}
+
+// Where libatspi dispatches its D-Bus messages and events once UseOwnMainContext ran; null
+// otherwise, and then nothing here iterates a context.
+GMainContext* gMainContext = nullptr;
+
+// A call that took this long ran into the D-Bus timeout; 0 until SetAtspiTimeouts.
+int gCallTimeoutMs = 0;
+
+// Transient properties (names, states, children) are re-read on every lookup anyway;
+// caching them only pins proxies and strings.
+const AtspiCache kCacheMask =
+    static_cast<AtspiCache>(ATSPI_CACHE_PARENT | ATSPI_CACHE_ROLE | ATSPI_CACHE_INTERFACES);
+
+// Applications the tree has walked into; entries leave when libatspi finalizes the app.
+std::unordered_set<AtspiApplication*> gApplications;
+AtspiApplication* gLastApplication = nullptr;
+AtspiCacheStats gCacheStats = {};
+// Proxies the last trim could not drop. The next trim waits for maxProxies / 2 more, so
+// those are not rescanned on every lookup, but never past twice the current limit.
+size_t gTrimPinned = 0;
+
+void ForgetApplication(gpointer, GObject* application) {
+    gApplications.erase(reinterpret_cast<AtspiApplication*>(application));
+    if (gLastApplication == reinterpret_cast<AtspiApplication*>(application)) {
+        gLastApplication = nullptr;
+    }
+}
+
+size_t LiveProxies() {
+    size_t live = 0;
+    for (AtspiApplication* application : gApplications) {
+        live += application->hash ? g_hash_table_size(application->hash) : 0;
+    }
+    return live;
+}
+
+struct Unreferenced {
+    AtspiApplication* application;
+    std::vector<std::string> paths;
+};
+
+// Only the application's table holds these.
+void CollectUnreferenced(gpointer key, gpointer value, gpointer userData) {
+    Unreferenced* found = static_cast<Unreferenced*>(userData);
+    if (G_OBJECT(value)->ref_count == 1 && value != found->application->root) {
+        found->paths.emplace_back(static_cast<const char*>(key));
+    }
+}
+
+// Disposing one proxy releases its parent, so a pass can free the next level up. Paths are
+// copied and looked up again because disposal may touch the table.
+size_t EvictUnreferenced(AtspiApplication* application) {
+    size_t evicted = 0;
+    for (int pass = 0; pass < 16 && application->hash; ++pass) {
+        Unreferenced found{application, {}};
+        g_hash_table_foreach(application->hash, CollectUnreferenced, &found);
+        size_t before = evicted;
+        for (const std::string& path : found.paths) {
+            gpointer value = g_hash_table_lookup(application->hash, path.c_str());
+            if (value && G_OBJECT(value)->ref_count == 1 &&
+                g_hash_table_remove(application->hash, path.c_str())) {
+                ++evicted;
+            }
+        }
+        if (evicted == before) {
+            break;
+        }
+    }
+    return evicted;
+}
+
+const char* const kWindowEvents[] = {"window:create", "window:destroy",
+                                     "object:property-change:accessible-name"};
+
+bool HasPrefix(const char* value, const char* prefix) {
+    return value && std::strncmp(value, prefix, std::strlen(prefix)) == 0;
+}
+
+struct WindowWatch {
+    AtspiWindowEventFn callback;
+    void* context;
+};
+
+// The event (and its source) belong to us; the callback takes its own references.
+void OnWindowEvent(AtspiEvent* event, void* userData) {
+    const WindowWatch* watch = static_cast<const WindowWatch*>(userData);
+    AtspiAccessible* source = event->source;
+    if (source) {
+        AtspiWindowEventKind kind = kAtspiWindowRenamed;
+        if (HasPrefix(event->type, "window:create")) {
+            kind = kAtspiWindowCreated;
+        } else if (HasPrefix(event->type, "window:destroy")) {
+            kind = kAtspiWindowDestroyed;
+        }
+        watch->callback(watch->context, kind, source);
+    }
+    g_boxed_free(ATSPI_TYPE_EVENT, event);
+}
+
+}  // namespace
+
+// libatspi reports a timeout as a generic IPC error, or not at all for calls without a
+// GError, so the call's duration decides.
+class AtspiTree::CallTimer {
+   public:
+    explicit CallTimer(AtspiTree& tree) : tree_(tree), started_(std::chrono::steady_clock::now()) {}
+    ~CallTimer() {
+        if (gCallTimeoutMs > 0 && std::chrono::steady_clock::now() - started_ >=
+                                      std::chrono::milliseconds(gCallTimeoutMs * 9 / 10)) {
+            tree_.NoteTimeout();
+        }
+    }
+
+   private:
+    AtspiTree& tree_;
+    std::chrono::steady_clock::time_point started_;
+};
+
+void TrimAtspiCache(size_t maxProxies) {
+    size_t live = LiveProxies();
+    size_t pinnedFloor = std::min(gTrimPinned + maxProxies / 2, maxProxies * 2);
+    if (live <= std::max(maxProxies, pinnedFloor)) {
+        return;
+    }
+    // Evicting an app's last proxies can finalize the app, which edits gApplications.
+    std::vector<AtspiApplication*> applications(gApplications.begin(), gApplications.end());
+    size_t evicted = 0;
+    for (AtspiApplication* application : applications) {
+        g_object_ref(application);
+        evicted += EvictUnreferenced(application);
+        if (application->root) {
+            atspi_accessible_clear_cache(application->root);
+        }
+        g_object_unref(application);
+    }
+    size_t remaining = LiveProxies();
+    gTrimPinned = remaining;
+    gCacheStats.evicted += evicted;
+    ++gCacheStats.trims;
+    DebugLog("AT-SPI cache trimmed from %zu to %zu proxies", live, remaining);
+}
+
+void GetAtspiCacheStats(AtspiCacheStats* stats) {
+    *stats = gCacheStats;
+    stats->liveProxies = LiveProxies();
+    stats->applications = gApplications.size();
+}
+
+void SetAtspiTimeouts(int callMs, int startupMs) {
+    atspi_set_timeout(callMs, startupMs);
+    gCallTimeoutMs = callMs;
+    DebugLog("AT-SPI call timeout %d ms (after %d ms of app startup)", callMs, startupMs);
+}
+
+bool WatchTopLevelWindows(AtspiWindowEventFn callback, void* context) {
+    // Without our own context the events would run on the host's loop, outside the lock.
+    if (!gMainContext) {
+        return false;
+    }
+    // Leaked on success: the registrations below last for the process.
+    WindowWatch* watch = new WindowWatch{callback, context};
+    AtspiEventListener* listener = atspi_event_listener_new(OnWindowEvent, watch, nullptr);
+    if (!listener) {
+        delete watch;
+        return false;
+    }
+    size_t registered = 0;
+    for (const char* type : kWindowEvents) {
+        GError* error = nullptr;
+        if (!atspi_event_listener_register(listener, type, &error)) {
+            DebugLog("Registering for %s failed: %s", type,
+                     error && error->message ? error->message : "unknown error");
+            FreeGError(error);
+            break;
+        }
+        ++registered;
+    }
+    if (registered != sizeof(kWindowEvents) / sizeof(kWindowEvents[0])) {
+        for (size_t i = 0; i < registered; ++i) {
+            atspi_event_listener_deregister(listener, kWindowEvents[i], nullptr);
+        }
+        g_object_unref(listener);
+        delete watch;
+        return false;
+    }
+    // Registrations keep the callback and user data, not the listener object.
+    g_object_unref(listener);
+    return true;
+}
+
+void UseOwnMainContext() {
+    if (gMainContext) {
+        return;
+    }
+    gMainContext = g_main_context_new();
+    atspi_set_main_context(gMainContext);
+}
+
+void DispatchAtspiEvents() {
+    if (!gMainContext) {
+        return;
+    }
+    // Bounded, so a burst of events cannot hold the lookup for long; the rest waits for the
+    // next call.
+    for (int i = 0; i < 1000 && g_main_context_pending(gMainContext); ++i) {
+        g_main_context_iteration(gMainContext, FALSE);
+    }
+}
+
+// Remembers the app of every handle handed out, and narrows the app's cache mask.
+AccessibleTree::Node AtspiTree::Track(Node node) {
+    AtspiApplication* application = node ? AsAccessible(node)->parent.app : nullptr;
+    if (application && application != gLastApplication) {
+        gLastApplication = application;
+        if (gApplications.insert(application).second) {
+            g_object_weak_ref(G_OBJECT(application), ForgetApplication, nullptr);
+            atspi_accessible_set_cache_mask(AsAccessible(node), kCacheMask);
+        }
+    }
+    return node;
+}
+
+AccessibleTree::Node AtspiTree::DoRef(Node node) {
+    return g_object_ref(AsAccessible(node));
+}
+
+void AtspiTree::DoUnref(Node node) {
+    g_object_unref(AsAccessible(node));
+}
+
+int AtspiTree::DoDesktopCount() {
+    CallTimer timer(*this);
+    return atspi_get_desktop_count();
+}
+
+AccessibleTree::Node AtspiTree::DoDesktop(int index) {
+    CallTimer timer(*this);
+    return Track(atspi_get_desktop(index));
+}
+
+AccessibleRole AtspiTree::DoRole(Node node) {
+    CallTimer timer(*this);
+    GError* error = nullptr;
+    AtspiRole role = atspi_accessible_get_role(AsAccessible(node), &error);
+    FreeGError(error);
+    switch (role) {
+        case ATSPI_ROLE_APPLICATION:
+            return AccessibleRole::Application;
+        case ATSPI_ROLE_FRAME:
+            return AccessibleRole::Frame;
+        case ATSPI_ROLE_WINDOW:
+            return AccessibleRole::Window;
+        case ATSPI_ROLE_PANEL:
+            return AccessibleRole::Panel;
+        case ATSPI_ROLE_TOOL_BAR:
+            return AccessibleRole::ToolBar;
+        case ATSPI_ROLE_ENTRY:
+            return AccessibleRole::Entry;
+        case ATSPI_ROLE_TEXT:
+            return AccessibleRole::Text;
+        case ATSPI_ROLE_DOCUMENT_WEB:
+            return AccessibleRole::DocumentWeb;
+        default:
+            return AccessibleRole::Other;
+    }
+}
+
+bool AtspiTree::DoStates(Node node, uint32_t& states) {
+    CallTimer timer(*this);
+    AtspiStateSet* set = atspi_accessible_get_state_set(AsAccessible(node));
+    if (!set) {
+        return false;
+    }
+    static const struct {
+        AtspiStateType atspi;
+        AccessibleState state;
+    } kStates[] = {
+        {ATSPI_STATE_EDITABLE, kStateEditable}, {ATSPI_STATE_FOCUSABLE, kStateFocusable},
+        {ATSPI_STATE_ENABLED, kStateEnabled},   {ATSPI_STATE_FOCUSED, kStateFocused},
+        {ATSPI_STATE_SHOWING, kStateShowing},   {ATSPI_STATE_ACTIVE, kStateActive},
+    };
+    states = 0;
+    for (const auto& entry : kStates) {
+        if (atspi_state_set_contains(set, entry.atspi)) {
+            states |= entry.state;
+        }
+    }
+    g_object_unref(set);
+    return true;
+}
+
+std::string AtspiTree::DoName(Node node) {
+    CallTimer timer(*this);
+    GError* error = nullptr;
+    gchar* name = atspi_accessible_get_name(AsAccessible(node), &error);
+    FreeGError(error);
+    return TakeString(name);
+}
+
+AccessibleTree::Node AtspiTree::DoParent(Node node) {
+    CallTimer timer(*this);
+    GError* error = nullptr;
+    AtspiAccessible* parent = atspi_accessible_get_parent(AsAccessible(node), &error);
+    FreeGError(error);
+    return Track(parent);
+}
+
+int AtspiTree::DoChildCount(Node node) {
+    CallTimer timer(*this);
+    GError* error = nullptr;
+    gint count = atspi_accessible_get_child_count(AsAccessible(node), &error);
+    FreeGError(error);
+    return count;
+}
+
+AccessibleTree::Node AtspiTree::DoChildAt(Node node, int index) {
+    CallTimer timer(*this);
+    GError* error = nullptr;
+    AtspiAccessible* child = atspi_accessible_get_child_at_index(AsAccessible(node), index, &error);
+    FreeGError(error);
+    return Track(child);
+}
+
+int AtspiTree::DoProcessId(Node node) {
+    CallTimer timer(*this);
+    GError* error = nullptr;
+    gint pid = atspi_accessible_get_process_id(AsAccessible(node), &error);
+    FreeGError(error);
+    return pid;
+}
+
+bool AtspiTree::DoText(Node node, std::string& value) {
+    CallTimer timer(*this);
+    AtspiText* text = atspi_accessible_get_text_iface(AsAccessible(node));
+    if (!text) {
+        return false;
+    }
+    GError* error = nullptr;
+    gchar* chars = atspi_text_get_text(text, 0, -1, &error);
+    FreeGError(error);
+    g_object_unref(text);
+    if (!chars) {
+        return false;
+    }
+    value = TakeString(chars);
+    return true;
+}
+
+bool AtspiTree::DoDocumentAttribute(Node node, const std::string& name, std::string& value) {
+    CallTimer timer(*this);
+    AtspiDocument* document = atspi_accessible_get_document_iface(AsAccessible(node));
+    if (!document) {
+        return false;
+    }
+    GError* error = nullptr;
+    gchar* chars = atspi_document_get_document_attribute_value(document, name.c_str(), &error);
+    FreeGError(error);
+    g_object_unref(document);
+    if (!chars) {
+        return false;
+    }
+    value = TakeString(chars);
+    return true;
+}
+
+bool AtspiTree::DoExtents(Node node, AccessibleRect& rect) {
+    CallTimer timer(*this);
+    AtspiComponent* component = atspi_accessible_get_component_iface(AsAccessible(node));
+    if (!component) {
+        return false;
+    }
+    GError* error = nullptr;
+    AtspiRect* extents = atspi_component_get_extents(component, ATSPI_COORD_TYPE_SCREEN, &error);
+    FreeGError(error);
+    g_object_unref(component);
+    if (!extents) {
+        return false;
+    }
+    rect.x = extents->x;
+    rect.y = extents->y;
+    rect.width = extents->width;
+    rect.height = extents->height;
+    g_free(extents);
+    return true;
+}
+
+std::string AtspiTree::DoApplicationId(Node node) {
+    AtspiApplication* app = AsAccessible(node)->parent.app;
+    return app && app->bus_name ? std::string(app->bus_name) : std::string();
+}
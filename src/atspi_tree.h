@@ -0,0 +1,56 @@
+#pragma once
+
+#include "accessible_tree.h"
+#include "atspi_plugin.h"
+
+// AccessibleTree backed by libatspi. Nodes are AtspiAccessible* with GObject refcounts;
+// every call other than Ref/Unref/ApplicationId may block on a D-Bus round trip, and one
+// that runs into the SetAtspiTimeouts limit counts in stats().timeouts. Not thread-safe,
+// like libatspi itself: callers hold the AT-SPI lock.
+class AtspiTree : public AccessibleTree {
+   protected:
+    Node DoRef(Node node) override;
+    void DoUnref(Node node) override;
+    int DoDesktopCount() override;
+    Node DoDesktop(int index) override;
+    AccessibleRole DoRole(Node node) override;
+    bool DoStates(Node node, uint32_t& states) override;
+    std::string DoName(Node node) override;
+    Node DoParent(Node node) override;
+    int DoChildCount(Node node) override;
+    Node DoChildAt(Node node, int index) override;
+    int DoProcessId(Node node) override;
+    bool DoText(Node node, std::string& value) override;
+    bool DoDocumentAttribute(Node node, const std::string& name, std::string& value) override;
+    bool DoExtents(Node node, AccessibleRect& rect) override;
+    std::string DoApplicationId(Node node) override;
+
+   private:
+    class CallTimer;
+
+    Node Track(Node node);
+};
+
+// libatspi keeps a proxy for every accessible it has handed out, with a reference in its
+// per-application table, until the application reports the object gone; browsers rarely
+// do. Once more than maxProxies are live, drops the proxies nothing else references (so
+// handles held elsewhere, e.g. by the title index, stay valid) and the cached properties
+// of the rest. Cheap when under the limit. Call with the AT-SPI lock held.
+void TrimAtspiCache(size_t maxProxies);
+void GetAtspiCacheStats(AtspiCacheStats* stats);
+
+// atspi_set_timeout: each call waits at most callMs, once an application has been running
+// for startupMs (libatspi waits without limit before that). Call with the AT-SPI lock held.
+void SetAtspiTimeouts(int callMs, int startupMs);
+
+// Reports window:create, window:destroy and accessible-name changes to callback. Events
+// are delivered only from DispatchAtspiEvents(); context must outlive the registration.
+// False without UseOwnMainContext.
+bool WatchTopLevelWindows(AtspiWindowEventFn callback, void* context);
+// Moves libatspi onto a GLib main context of its own. The default context belongs to the
+// host (Chromium's message pump in an Electron main process): iterating it would run the
+// host's sources, and would spin while another thread owns it. Call once after atspi_init.
+void UseOwnMainContext();
+// Runs the AT-SPI handlers queued on that context; nothing in this process iterates it
+// otherwise. Does nothing before UseOwnMainContext. Call with the AT-SPI lock held.
+void DispatchAtspiEvents();
@@ -0,0 +1,28 @@
+#include "debug_log.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+
+bool DebugEnabled() {
+    static bool enabled = []() {
+        const char* env = std::getenv("WIN_TRACE_DEBUG");
+        if (!env || env[0] == '\0') {
+            return false;
+        }
+        return !(env[0] == '0' && env[1] == '\0');
+    }();
+    return enabled;
+}
+
+void DebugLog(const char* format, ...) {
+    if (!DebugEnabled()) {
+        return;
+    }
+    std::fprintf(stderr, "[win-trace] ");
+    va_list args;
+    va_start(args, format);
+    std::vfprintf(stderr, format, args);
+    va_end(args);
+    std::fprintf(stderr, "\n");
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// Diagnostics enabled by WIN_TRACE_DEBUG (any value other than empty or "0").
+bool DebugEnabled();
+void DebugLog(const char* format, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 1, 2)))
+#endif
+    ;
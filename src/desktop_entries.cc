@@ -0,0 +1,426 @@
+#include "desktop_entries.h"
+
+#include <dirent.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include "debug_log.h"
+
+namespace {
+
+const size_t kHidden = static_cast<size_t>(-1);
+const size_t kAmbiguous = static_cast<size_t>(-2);
+
+const uint32_t kDirectoryEvents = IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM |
+                                  IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+std::string ToLower(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return value;
+}
+
+bool EndsWith(const std::string& value, const std::string& suffix) {
+    return value.size() >= suffix.size() &&
+           value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::string Trim(const std::string& value) {
+    size_t start = value.find_first_not_of(" \t");
+    if (start == std::string::npos) {
+        return std::string();
+    }
+    return value.substr(start, value.find_last_not_of(" \t") - start + 1);
+}
+
+bool IsDirectory(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+// The data directories in precedence order, per the XDG base directory spec.
+std::vector<std::string> DataDirectories() {
+    std::vector<std::string> dirs;
+    const char* dataHome = std::getenv("XDG_DATA_HOME");
+    const char* home = std::getenv("HOME");
+    if (dataHome && dataHome[0] == '/') {
+        dirs.push_back(dataHome);
+    } else if (home && home[0] != '\0') {
+        dirs.push_back(std::string(home) + "/.local/share");
+    }
+    const char* dataDirs = std::getenv("XDG_DATA_DIRS");
+    std::string list = dataDirs && dataDirs[0] != '\0' ? dataDirs : "/usr/local/share:/usr/share";
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(':', start);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        std::string dir = list.substr(start, end - start);
+        if (!dir.empty() && dir[0] == '/') {
+            dirs.push_back(dir);
+        }
+        start = end + 1;
+    }
+    // Sessions started outside a desktop environment often lack these in XDG_DATA_DIRS.
+    if (home && home[0] != '\0') {
+        dirs.push_back(std::string(home) + "/.local/share/flatpak/exports/share");
+    }
+    dirs.push_back("/var/lib/flatpak/exports/share");
+    dirs.push_back("/var/lib/snapd/desktop");
+
+    std::vector<std::string> unique;
+    for (std::string& dir : dirs) {
+        while (dir.size() > 1 && dir.back() == '/') {
+            dir.pop_back();
+        }
+        if (std::find(unique.begin(), unique.end(), dir) == unique.end()) {
+            unique.push_back(dir);
+        }
+    }
+    return unique;
+}
+
+// Locale suffixes to try for Name[...], most specific first: "de_AT", "de".
+std::vector<std::string> LocaleKeys() {
+    const char* names[] = {"LC_ALL", "LC_MESSAGES", "LANG"};
+    std::string locale;
+    for (const char* name : names) {
+        const char* value = std::getenv(name);
+        if (value && value[0] != '\0') {
+            locale = value;
+            break;
+        }
+    }
+    locale = locale.substr(0, locale.find_first_of(".@"));
+    std::vector<std::string> keys;
+    if (locale.empty() || locale == "C" || locale == "POSIX") {
+        return keys;
+    }
+    keys.push_back(locale);
+    size_t underscore = locale.find('_');
+    if (underscore != std::string::npos) {
+        keys.push_back(locale.substr(0, underscore));
+    }
+    return keys;
+}
+
+std::string Unescape(const std::string& value) {
+    std::string result;
+    result.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] != '\\' || i + 1 == value.size()) {
+            result.push_back(value[i]);
+            continue;
+        }
+        char next = value[++i];
+        switch (next) {
+            case 's': result.push_back(' '); break;
+            case 'n': result.push_back('\n'); break;
+            case 't': result.push_back('\t'); break;
+            case 'r': result.push_back('\r'); break;
+            default: result.push_back(next); break;
+        }
+    }
+    return result;
+}
+
+// Basename of the program an Exec line starts, skipping "env VAR=value".
+std::string ExecProgram(const std::string& exec) {
+    size_t position = 0;
+    while (position < exec.size()) {
+        while (position < exec.size() && exec[position] == ' ') {
+            ++position;
+        }
+        std::string token;
+        if (position < exec.size() && exec[position] == '"') {
+            size_t end = exec.find('"', position + 1);
+            token = exec.substr(position + 1, end == std::string::npos ? std::string::npos
+                                                                        : end - position - 1);
+            position = end == std::string::npos ? exec.size() : end + 1;
+        } else {
+            size_t end = exec.find(' ', position);
+            token = exec.substr(position, end == std::string::npos ? std::string::npos
+                                                                    : end - position);
+            position = end == std::string::npos ? exec.size() : end;
+        }
+        if (token.empty() || token == "env" || token.find('=') != std::string::npos) {
+            continue;
+        }
+        size_t slash = token.rfind('/');
+        return slash == std::string::npos ? token : token.substr(slash + 1);
+    }
+    return std::string();
+}
+
+// Interpreters and launchers run many applications; their name says nothing.
+bool IsWrapperProgram(std::string program) {
+    static const std::unordered_set<std::string> kWrappers = {
+        "env",  "sh",   "bash",  "python", "java",  "electron", "node", "gjs",
+        "perl", "ruby", "mono",  "wine",   "flatpak", "snap",   "steam", "xdg-open"};
+    while (!program.empty() && (std::isdigit(static_cast<unsigned char>(program.back())) ||
+                                program.back() == '.')) {
+        program.pop_back();
+    }
+    return kWrappers.count(program) != 0;
+}
+
+// Short names shared by several entries are useless as keys, so they are dropped.
+void AddShortName(std::unordered_map<std::string, size_t>& map, const std::string& key,
+                  size_t index) {
+    if (key.empty()) {
+        return;
+    }
+    auto inserted = map.emplace(key, index);
+    if (!inserted.second && inserted.first->second != index) {
+        inserted.first->second = kAmbiguous;
+    }
+}
+
+}  // namespace
+
+DesktopEntryIndex::DesktopEntryIndex() {
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd_ < 0) {
+        DebugLog("inotify unavailable (%s); .desktop changes need a restart",
+                 std::strerror(errno));
+    }
+}
+
+DesktopEntryIndex::~DesktopEntryIndex() {
+    if (inotifyFd_ >= 0) {
+        close(inotifyFd_);
+    }
+}
+
+DesktopEntryIndex& DesktopEntryIndex::Shared() {
+    static DesktopEntryIndex* index = new DesktopEntryIndex();
+    return *index;
+}
+
+void DesktopEntryIndex::Rebuild() {
+    entries_.clear();
+    byId_.clear();
+    byWmClass_.clear();
+    byShortName_.clear();
+    for (const std::string& dataDir : DataDirectories()) {
+        std::string dir = dataDir + "/applications";
+        if (IsDirectory(dir)) {
+            ScanDirectory(dir, std::string());
+        } else if (IsDirectory(dataDir)) {
+            // Picks up an applications directory created later, e.g. by a first install.
+            WatchDirectory(dataDir, true);
+        }
+    }
+    built_ = true;
+    DebugLog("Desktop entry index built with %zu applications", entries_.size());
+}
+
+void DesktopEntryIndex::ScanDirectory(const std::string& dir, const std::string& idPrefix) {
+    WatchDirectory(dir, false);
+    DIR* handle = opendir(dir.c_str());
+    if (!handle) {
+        return;
+    }
+    std::vector<std::string> names;
+    while (dirent* entry = readdir(handle)) {
+        if (entry->d_name[0] != '.') {
+            names.emplace_back(entry->d_name);
+        }
+    }
+    closedir(handle);
+    // readdir order is arbitrary; sorting keeps the index the same from run to run.
+    std::sort(names.begin(), names.end());
+    for (const std::string& name : names) {
+        std::string path = dir + "/" + name;
+        if (EndsWith(name, ".desktop")) {
+            AddEntry(idPrefix + name.substr(0, name.size() - 8), path);
+        } else if (IsDirectory(path)) {
+            // Files in subdirectories get ids with '-' for '/' ("kde4/okular.desktop").
+            ScanDirectory(path, idPrefix + name + "-");
+        }
+    }
+}
+
+void DesktopEntryIndex::AddEntry(const std::string& id, const std::string& path) {
+    std::string idKey = ToLower(id);
+    if (byId_.count(idKey)) {
+        return;  // a directory earlier in the search path has this id
+    }
+    std::ifstream file(path);
+    if (!file) {
+        return;
+    }
+
+    std::vector<std::string> localeKeys = LocaleKeys();
+    std::string name;
+    std::string localizedName;
+    size_t localizedRank = localeKeys.size();
+    std::string icon;
+    std::string wmClass;
+    std::string exec;
+    std::string type;
+    bool hidden = false;
+    bool inMainGroup = false;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (line[0] == '[') {
+            if (inMainGroup) {
+                break;  // actions and other groups follow the main one
+            }
+            inMainGroup = line == "[Desktop Entry]";
+            continue;
+        }
+        if (!inMainGroup) {
+            continue;
+        }
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            continue;
+        }
+        std::string key = Trim(line.substr(0, equals));
+        std::string value = Unescape(Trim(line.substr(equals + 1)));
+        if (key == "Name") {
+            name = value;
+        } else if (key.compare(0, 5, "Name[") == 0 && key.back() == ']') {
+            std::string locale = key.substr(5, key.size() - 6);
+            for (size_t rank = 0; rank < localizedRank; ++rank) {
+                if (localeKeys[rank] == locale) {
+                    localizedName = value;
+                    localizedRank = rank;
+                    break;
+                }
+            }
+        } else if (key == "Icon") {
+            icon = value;
+        } else if (key == "StartupWMClass") {
+            wmClass = value;
+        } else if (key == "Exec") {
+            exec = value;
+        } else if (key == "Type") {
+            type = value;
+        } else if (key == "Hidden") {
+            hidden = value == "true";
+        }
+    }
+
+    if (hidden || type != "Application") {
+        // A hidden entry deletes the id for every directory after this one.
+        byId_.emplace(idKey, kHidden);
+        return;
+    }
+    size_t index = entries_.size();
+    entries_.push_back(AppIdentity{id, localizedName.empty() ? name : localizedName, icon});
+    byId_.emplace(idKey, index);
+    if (!wmClass.empty()) {
+        byWmClass_.emplace(ToLower(wmClass), index);
+    }
+    size_t dot = idKey.rfind('.');
+    if (dot != std::string::npos) {
+        AddShortName(byShortName_, idKey.substr(dot + 1), index);
+    }
+    std::string program = ToLower(ExecProgram(exec));
+    if (!IsWrapperProgram(program)) {
+        AddShortName(byShortName_, program, index);
+    }
+}
+
+void DesktopEntryIndex::WatchDirectory(const std::string& dir, bool parentOnly) {
+    if (inotifyFd_ < 0) {
+        return;
+    }
+    // Watching a directory twice returns the same descriptor, so rebuilds add none.
+    uint32_t mask = parentOnly ? (IN_CREATE | IN_MOVED_TO | IN_ONLYDIR) : kDirectoryEvents;
+    int watch = inotify_add_watch(inotifyFd_, dir.c_str(), mask);
+    if (watch < 0) {
+        DebugLog("Cannot watch %s: %s", dir.c_str(), std::strerror(errno));
+    } else if (parentOnly) {
+        parentWatches_.insert(watch);
+    } else {
+        parentWatches_.erase(watch);
+    }
+}
+
+// True when an applications directory changed since the last call.
+bool DesktopEntryIndex::DrainEvents() {
+    if (inotifyFd_ < 0) {
+        return false;
+    }
+    bool changed = false;
+    alignas(inotify_event) char buffer[4096];
+    for (;;) {
+        ssize_t length = read(inotifyFd_, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;
+        }
+        for (ssize_t offset = 0; offset < length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            if (event->mask & IN_IGNORED) {
+                parentWatches_.erase(event->wd);
+                continue;
+            }
+            // A data directory only matters when "applications" itself appears in it.
+            if (parentWatches_.count(event->wd) &&
+                (event->len == 0 || std::strcmp(event->name, "applications") != 0)) {
+                continue;
+            }
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+const AppIdentity* DesktopEntryIndex::Find(const std::unordered_map<std::string, size_t>& map,
+                                           const std::string& key) const {
+    if (key.empty()) {
+        return nullptr;
+    }
+    auto found = map.find(ToLower(key));
+    if (found == map.end() || found->second >= entries_.size()) {
+        return nullptr;
+    }
+    return &entries_[found->second];
+}
+
+bool DesktopEntryIndex::Resolve(const AppHints& hints, AppIdentity& identity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (DrainEvents() || !built_) {
+        Rebuild();
+    }
+    const AppIdentity* match = Find(byId_, hints.gtkApplicationId);
+    for (const std::string* key : {&hints.wmClass, &hints.wmInstance}) {
+        if (!match) {
+            match = Find(byWmClass_, *key);
+        }
+    }
+    for (const std::string* key : {&hints.wmClass, &hints.wmInstance, &hints.processName}) {
+        if (!match) {
+            match = Find(byId_, *key);
+        }
+    }
+    for (const std::string* key : {&hints.wmInstance, &hints.wmClass, &hints.processName}) {
+        if (!match) {
+            match = Find(byShortName_, *key);
+        }
+    }
+    if (!match) {
+        return false;
+    }
+    identity = *match;
+    return true;
+}
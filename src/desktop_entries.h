@@ -0,0 +1,64 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// The application a window belongs to, from its XDG .desktop entry.
+struct AppIdentity {
+    std::string id;  // desktop file id without ".desktop", e.g. "org.gnome.Nautilus"
+    std::string name;
+    std::string icon;  // icon theme name or absolute path; may be empty
+};
+
+// What the window says about its application (Linux: X11 properties and /proc).
+struct AppHints {
+    std::string gtkApplicationId;  // _GTK_APPLICATION_ID
+    std::string wmInstance;        // WM_CLASS, first string
+    std::string wmClass;           // WM_CLASS, second string
+    std::string processName;
+};
+
+// The Type=Application entries of $XDG_DATA_HOME and $XDG_DATA_DIRS (plus the Flatpak and
+// Snap export directories) keyed by desktop file id, StartupWMClass and, where no two
+// entries share it, short name (the id's last dot-separated part and the Exec program).
+// Built on first use; inotify marks it stale when an applications directory changes and
+// the next Resolve() rebuilds it, so a resolve is otherwise a few hash probes plus one
+// non-blocking read. Thread-safe.
+class DesktopEntryIndex {
+   public:
+    DesktopEntryIndex();
+    ~DesktopEntryIndex();
+
+    DesktopEntryIndex(const DesktopEntryIndex&) = delete;
+    DesktopEntryIndex& operator=(const DesktopEntryIndex&) = delete;
+
+    // Tries _GTK_APPLICATION_ID, then WM_CLASS against StartupWMClass and desktop ids, then
+    // short names; false when nothing matched.
+    bool Resolve(const AppHints& hints, AppIdentity& identity);
+
+    // Process-wide index, never destroyed.
+    static DesktopEntryIndex& Shared();
+
+   private:
+    void Rebuild();
+    void ScanDirectory(const std::string& dir, const std::string& idPrefix);
+    void AddEntry(const std::string& id, const std::string& path);
+    void WatchDirectory(const std::string& dir, bool parentOnly);
+    bool DrainEvents();
+    const AppIdentity* Find(const std::unordered_map<std::string, size_t>& map,
+                            const std::string& key) const;
+
+    std::mutex mutex_;
+    int inotifyFd_ = -1;
+    std::unordered_set<int> parentWatches_;  // data directories without applications/
+    bool built_ = false;
+    std::vector<AppIdentity> entries_;
+    // Lowercased keys into entries_. Ids seen first win (XDG precedence); hidden ones map
+    // to kHidden so lower-precedence copies stay masked.
+    std::unordered_map<std::string, size_t> byId_;
+    std::unordered_map<std::string, size_t> byWmClass_;
+    std::unordered_map<std::string, size_t> byShortName_;
+};
@@ -0,0 +1,182 @@
+#include "display_session.h"
+
+#include "thread_pool.h"
+
+#ifdef __linux__
+
+#include <X11/Xlib.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+
+#include "atspi_env.h"
+#include "debug_log.h"
+#include "x11_util.h"
+
+#ifndef WIN_TRACE_HAVE_XIO_EXIT_HANDLER
+#define WIN_TRACE_HAVE_XIO_EXIT_HANDLER 0
+#endif
+
+struct DisplaySession::State {
+    std::mutex mutex;
+    Display* display = nullptr;
+    std::atomic<bool> lost{false};
+    bool closed = false;
+    bool busResolved = false;
+    std::string atspiBusAddress;
+};
+
+namespace {
+
+// at-spi-bus-launcher publishes the bus of each X session on its root window.
+std::string ReadRootAtspiBus(Display* display) {
+    return ReadStringProperty(display, DefaultRootWindow(display), "AT_SPI_BUS");
+}
+
+// The bus libatspi in this process talks to (or will, once initialized).
+std::string ProcessAtspiBusAddress() {
+    const char* env = std::getenv("AT_SPI_BUS_ADDRESS");
+    if (env && env[0] != '\0') {
+        return env;
+    }
+    static std::once_flag once;
+    static std::string rootBus;
+    std::call_once(once, []() {
+        DisplayHandle display;
+        if (display.valid()) {
+            rootBus = ReadRootAtspiBus(display.get());
+        }
+    });
+    return rootBus;
+}
+
+#if WIN_TRACE_HAVE_XIO_EXIT_HANDLER
+// A dead Xvfb/Xvnc must not take the supervisor down: record the loss and let the
+// next query reconnect instead of letting Xlib call exit().
+void OnConnectionLost(Display*, void* userData) {
+    static_cast<std::atomic<bool>*>(userData)->store(true);
+}
+#endif
+
+Display* Connect(const std::string& name, std::atomic<bool>& lost) {
+    Display* display = XOpenDisplay(name.c_str());
+    if (!display) {
+        return nullptr;
+    }
+    lost.store(false);
+    InstallNonFatalXErrorHandler(display);
+#if WIN_TRACE_HAVE_XIO_EXIT_HANDLER
+    XSetIOErrorExitHandler(display, OnConnectionLost, &lost);
+#endif
+    return display;
+}
+
+void Disconnect(Display*& display) {
+    if (display) {
+        ForgetDisplayAtoms(display);
+        ReleaseNonFatalXErrorHandler(display);
+        XCloseDisplay(display);
+        display = nullptr;
+    }
+}
+
+}  // namespace
+
+DisplaySession::DisplaySession(const std::string& displayName)
+    : name_(displayName), state_(new State()) {}
+
+DisplaySession::~DisplaySession() {
+    Close();
+}
+
+std::shared_ptr<DisplaySession> DisplaySession::Open(const std::string& displayName,
+                                                     std::string& error) {
+    std::shared_ptr<DisplaySession> session(new DisplaySession(displayName));
+    session->state_->display = Connect(displayName, session->state_->lost);
+    if (!session->state_->display) {
+        error = "Cannot open X display '" + displayName + "'";
+        return nullptr;
+    }
+    session->state_->atspiBusAddress = ReadRootAtspiBus(session->state_->display);
+    session->state_->busResolved = !session->state_->atspiBusAddress.empty();
+    DebugLog("Opened session on %s (AT-SPI bus %s)", displayName.c_str(),
+             session->state_->busResolved ? session->state_->atspiBusAddress.c_str()
+                                          : "unknown");
+    return session;
+}
+
+bool DisplaySession::GetActiveWindowInfo(ActiveWindowInfo& info) {
+    State& state = *state_;
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (state.closed) {
+        return false;
+    }
+    if (state.lost.load() || !state.display) {
+        DebugLog("Reconnecting session %s", name_.c_str());
+        Disconnect(state.display);
+        state.display = Connect(name_, state.lost);
+        if (!state.display) {
+            return false;
+        }
+    }
+
+    if (!state.busResolved) {
+        // No launcher property: fall back to the environment of a client on this display,
+        // the same sources AdoptAtspiEnv uses, without touching our own environment.
+        Window window = QueryActiveWindow(state.display);
+        pid_t pid = 0;
+        if (window != 0 && QueryWindowPid(state.display, window, pid)) {
+            AtspiBusEnv env;
+            ResolveAtspiEnv(pid, env);
+            state.atspiBusAddress = env.atspiBusAddress;
+            state.busResolved = true;
+        }
+    }
+
+    ActiveWindowQueryOptions options;
+    options.queryBrowserUrl =
+        !state.atspiBusAddress.empty() && state.atspiBusAddress == ProcessAtspiBusAddress();
+    bool ok = GetActiveWindowInfoOnDisplay(state.display, options, info);
+    if (state.lost.load()) {
+        return false;
+    }
+    return ok;
+}
+
+void DisplaySession::Close() {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->closed = true;
+    Disconnect(state_->display);
+}
+
+#else
+
+struct DisplaySession::State {};
+
+DisplaySession::DisplaySession(const std::string& displayName)
+    : name_(displayName), state_(new State()) {}
+
+DisplaySession::~DisplaySession() = default;
+
+std::shared_ptr<DisplaySession> DisplaySession::Open(const std::string&, std::string& error) {
+    error = "Display sessions are only supported on X11";
+    return nullptr;
+}
+
+bool DisplaySession::GetActiveWindowInfo(ActiveWindowInfo&) {
+    return false;
+}
+
+void DisplaySession::Close() {}
+
+#endif  // __linux__
+
+void DisplaySession::QueryAsync(Callback done) {
+    std::shared_ptr<DisplaySession> self = shared_from_this();
+    ThreadPool::Shared().Submit([self, done = std::move(done)]() {
+        ActiveWindowInfo info;
+        bool ok = self->GetActiveWindowInfo(info);
+        done(ok, info);
+    });
+}
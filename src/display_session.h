@@ -0,0 +1,39 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "active_window.h"
+
+// A tracker bound to one explicitly named X display (e.g. ":12" for an Xvnc session). Each
+// session keeps its own connection, atom cache and AT-SPI bus address, and queries run on
+// the shared ThreadPool so one process can watch many displays. Queries on the same
+// session are serialized; different sessions run in parallel.
+class DisplaySession : public std::enable_shared_from_this<DisplaySession> {
+   public:
+    using Callback = std::function<void(bool ok, const ActiveWindowInfo& info)>;
+
+    static std::shared_ptr<DisplaySession> Open(const std::string& displayName,
+                                                std::string& error);
+    ~DisplaySession();
+
+    DisplaySession(const DisplaySession&) = delete;
+    DisplaySession& operator=(const DisplaySession&) = delete;
+
+    const std::string& name() const { return name_; }
+
+    // Blocking; call from a worker thread.
+    bool GetActiveWindowInfo(ActiveWindowInfo& info);
+    // Runs GetActiveWindowInfo on the shared pool; done is invoked on the pool thread.
+    void QueryAsync(Callback done);
+
+    void Close();
+
+   private:
+    explicit DisplaySession(const std::string& displayName);
+
+    struct State;
+    std::string name_;
+    std::unique_ptr<State> state_;
+};
@@ -0,0 +1,235 @@
+#include "focus_publisher.h"
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <mutex>
+
+#include "debug_log.h"
+#include "tracker_core.h"
+#include "win_trace_focus.h"
+
+namespace {
+
+struct Publisher {
+    std::string name;
+    win_trace_focus_segment* segment = nullptr;
+    uint64_t subscription = 0;
+    // Last published state; only touched by the poller thread.
+    bool published = false;
+    bool ok = false;
+    ActiveWindowInfo last;
+};
+
+// Serializes Start and Stop. gPublisherMutex guards gPublisher itself and is taken by the
+// listener (inside the tracker's fanout lock), so it is never held while subscribing or
+// unsubscribing.
+std::mutex gLifecycleMutex;
+std::mutex gPublisherMutex;
+Publisher* gPublisher = nullptr;
+
+bool SameSnapshot(const ActiveWindowInfo& a, const ActiveWindowInfo& b) {
+    return a.windowId == b.windowId && a.processId == b.processId && a.title == b.title &&
+           a.browserUrl == b.browserUrl && a.processName == b.processName &&
+           a.bounds.x == b.bounds.x && a.bounds.y == b.bounds.y &&
+           a.bounds.width == b.bounds.width && a.bounds.height == b.bounds.height;
+}
+
+// Appends value (cut at a UTF-8 boundary if the area is full) and its NUL.
+win_trace_focus_string_ref AppendString(win_trace_focus_segment* segment, uint32_t& used,
+                                        const std::string& value) {
+    if (used >= WIN_TRACE_FOCUS_STRING_BYTES) {
+        // Full: the previous string's NUL is the last byte.
+        return win_trace_focus_string_ref{WIN_TRACE_FOCUS_STRING_BYTES - 1, 0};
+    }
+    win_trace_focus_string_ref ref{used, 0};
+    size_t room = WIN_TRACE_FOCUS_STRING_BYTES - used - 1;
+    size_t length = value.size();
+    if (length > room) {
+        length = room;
+        while (length > 0 && (static_cast<unsigned char>(value[length]) & 0xC0) == 0x80) {
+            --length;
+        }
+    }
+    std::memcpy(segment->strings + used, value.data(), length);
+    segment->strings[used + length] = '\0';
+    ref.length = static_cast<uint32_t>(length);
+    used += static_cast<uint32_t>(length) + 1;
+    return ref;
+}
+
+void Write(win_trace_focus_segment* segment, bool ok, const ActiveWindowInfo& info) {
+    uint32_t sequence = __atomic_load_n(&segment->sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&segment->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    win_trace_focus_record& record = segment->record;
+    record = win_trace_focus_record();
+    record.published_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                              std::chrono::system_clock::now().time_since_epoch())
+                              .count();
+    uint32_t used = 0;
+    if (ok) {
+        record.window_id = info.windowId;
+        record.memory_usage = info.memoryUsage;
+        record.x = info.bounds.x;
+        record.y = info.bounds.y;
+        record.width = info.bounds.width;
+        record.height = info.bounds.height;
+        record.process_id = static_cast<uint32_t>(info.processId);
+        record.flags = WIN_TRACE_FOCUS_HAS_WINDOW |
+                       (info.browserUrl.empty() ? 0u : WIN_TRACE_FOCUS_HAS_URL);
+        record.process_name = AppendString(segment, used, info.processName);
+        record.exe_path = AppendString(segment, used, info.exePath);
+        // The title goes last: it is the field most likely to be cut.
+        record.url = AppendString(segment, used, info.browserUrl);
+        record.title = AppendString(segment, used, info.title);
+    } else {
+        record.process_name = record.exe_path = record.title = record.url =
+            AppendString(segment, used, std::string());
+    }
+
+    __atomic_store_n(&segment->sequence, sequence + 2, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &segment->sequence, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+void OnWindow(bool ok, const ActiveWindowInfo& info) {
+    std::lock_guard<std::mutex> lock(gPublisherMutex);
+    Publisher* publisher = gPublisher;
+    if (!publisher || (publisher->published && publisher->ok == ok &&
+                       (!ok || SameSnapshot(publisher->last, info)))) {
+        return;
+    }
+    Write(publisher->segment, ok, info);
+    publisher->published = true;
+    publisher->ok = ok;
+    publisher->last = info;
+}
+
+}  // namespace
+
+namespace focus_publisher {
+
+bool Start(const Options& options, std::string& error) {
+    std::lock_guard<std::mutex> lifecycle(gLifecycleMutex);
+    if (Running()) {
+        error = "a focus publisher is already running in this process";
+        return false;
+    }
+    std::string name = options.name.empty()
+                           ? WIN_TRACE_FOCUS_NAME_PREFIX + std::to_string(getuid())
+                           : options.name;
+    if (name[0] != '/') {
+        name.insert(0, "/");
+    }
+    // The name is predictable, so never adopt an existing object: another local user could
+    // have created it to read or forge the records, or shrink it under our mapping. Our own
+    // stale segment goes; one we cannot unlink makes the exclusive create fail.
+    if (shm_unlink(name.c_str()) == 0) {
+        DebugLog("Focus publisher replaced a stale %s", name.c_str());
+    }
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        error = "shm_open(" + name + ") failed: " + std::strerror(errno);
+        return false;
+    }
+    if (ftruncate(fd, sizeof(win_trace_focus_segment)) != 0) {
+        error = "ftruncate(" + name + ") failed: " + std::strerror(errno);
+        close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, sizeof(win_trace_focus_segment), PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        error = "mmap(" + name + ") failed: " + std::strerror(errno);
+        return false;
+    }
+
+    // The segment is new and zero-filled; sequence 2 marks the first complete header.
+    auto* segment = static_cast<win_trace_focus_segment*>(mapping);
+    uint32_t next = 2;
+    __atomic_store_n(&segment->sequence, next - 1, __ATOMIC_RELAXED);
+    segment->magic = WIN_TRACE_FOCUS_MAGIC;
+    segment->version = WIN_TRACE_FOCUS_VERSION;
+    segment->size = sizeof(win_trace_focus_segment);
+    segment->publisher_pid = static_cast<uint32_t>(getpid());
+    __atomic_store_n(&segment->sequence, next, __ATOMIC_RELEASE);
+
+    auto* publisher = new Publisher();
+    publisher->name = name;
+    publisher->segment = segment;
+    {
+        std::lock_guard<std::mutex> lock(gPublisherMutex);
+        gPublisher = publisher;
+    }
+    publisher->subscription = tracker_core::SubscribeActiveWindow(options.intervalMs, OnWindow);
+    if (publisher->subscription == 0) {
+        error = "the active window poller could not start";
+        {
+            std::lock_guard<std::mutex> lock(gPublisherMutex);
+            gPublisher = nullptr;
+        }
+        munmap(segment, sizeof(win_trace_focus_segment));
+        shm_unlink(name.c_str());
+        delete publisher;
+        return false;
+    }
+    DebugLog("Focus publisher writing %s", name.c_str());
+    return true;
+}
+
+void Stop() {
+    std::lock_guard<std::mutex> lifecycle(gLifecycleMutex);
+    Publisher* publisher = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(gPublisherMutex);
+        publisher = gPublisher;
+        gPublisher = nullptr;
+        if (!publisher) {
+            return;
+        }
+        // Readers that still have it mapped see "no window" from a stopped publisher.
+        Write(publisher->segment, false, ActiveWindowInfo());
+        __atomic_store_n(&publisher->segment->publisher_pid, 0u, __ATOMIC_RELAXED);
+    }
+    tracker_core::UnsubscribeActiveWindow(publisher->subscription);
+    munmap(publisher->segment, sizeof(win_trace_focus_segment));
+    shm_unlink(publisher->name.c_str());
+    DebugLog("Focus publisher stopped");
+    delete publisher;
+}
+
+bool Running() {
+    std::lock_guard<std::mutex> lock(gPublisherMutex);
+    return gPublisher != nullptr;
+}
+
+}  // namespace focus_publisher
+
+#else
+
+namespace focus_publisher {
+
+bool Start(const Options&, std::string& error) {
+    error = "the focus publisher is only available on Linux";
+    return false;
+}
+
+void Stop() {}
+
+bool Running() {
+    return false;
+}
+
+}  // namespace focus_publisher
+
+#endif  // __linux__
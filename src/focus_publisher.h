@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Publishes the process-wide tracker's active window into a POSIX shared-memory segment
+// (include/win_trace_focus.h) so other local processes can read it without polling X11 or
+// AT-SPI themselves. A snapshot is written only when the window, title, URL or bounds
+// change, and each write wakes readers blocked in win_trace_focus_wait. Linux only.
+namespace focus_publisher {
+
+struct Options {
+    std::string name;  // empty: WIN_TRACE_FOCUS_NAME_PREFIX + uid
+    uint32_t intervalMs = 250;
+};
+
+// Fails (with error set) when a publisher is already running or the segment cannot be
+// created. The segment is unlinked again by Stop.
+bool Start(const Options& options, std::string& error);
+void Stop();
+bool Running();
+
+}  // namespace focus_publisher
@@ -0,0 +1,298 @@
+#include "geometry_tracker.h"
+
+#ifdef __linux__
+
+#include <X11/Xlib.h>
+
+#include <memory>
+#include <mutex>
+
+#include "debug_log.h"
+#include "x11_event_loop.h"
+#include "x11_util.h"
+
+namespace {
+
+const long kClientMask = StructureNotifyMask | PropertyChangeMask;
+const long kFrameMask = StructureNotifyMask;
+
+// Top-level ancestor of the client: the frame under reparenting window managers, the
+// client itself otherwise.
+Window FindFrame(Display* display, Window window) {
+    Window current = window;
+    for (int depth = 0; depth < 16; ++depth) {
+        Window root = 0;
+        Window parent = 0;
+        Window* children = nullptr;
+        unsigned int childCount = 0;
+        if (XQueryTree(display, current, &root, &parent, &children, &childCount) == 0) {
+            return window;
+        }
+        if (children) {
+            XFree(children);
+        }
+        if (parent == 0 || parent == root) {
+            return current;
+        }
+        current = parent;
+    }
+    return window;
+}
+
+bool SameGeometry(const GeometryUpdate& a, const GeometryUpdate& b) {
+    return a.windowId == b.windowId && a.bounds.x == b.bounds.x && a.bounds.y == b.bounds.y &&
+           a.bounds.width == b.bounds.width && a.bounds.height == b.bounds.height &&
+           a.frameExtents.left == b.frameExtents.left &&
+           a.frameExtents.right == b.frameExtents.right &&
+           a.frameExtents.top == b.frameExtents.top &&
+           a.frameExtents.bottom == b.frameExtents.bottom;
+}
+
+class GeometryHandler : public X11EventLoop::Handler {
+   public:
+    explicit GeometryHandler(geometry_tracker::Listener listener)
+        : listener_(std::move(listener)) {}
+
+    void Attach(Display* display) {
+        root_ = DefaultRootWindow(display);
+        activeAtom_ = XInternAtom(display, "_NET_ACTIVE_WINDOW", False);
+        extentsAtom_ = XInternAtom(display, "_NET_FRAME_EXTENTS", False);
+        X11EventLoop::Get().AddInputMask(display, root_, PropertyChangeMask);
+        Follow(display, QueryActiveWindow(display));
+    }
+
+    void Detach(Display* display) {
+        Unfollow(display);
+        X11EventLoop::Get().RemoveInputMask(display, root_, PropertyChangeMask);
+    }
+
+    void OnEvent(Display* display, XEvent& event) override {
+        switch (event.type) {
+            case PropertyNotify:
+                if (event.xproperty.window == root_ && event.xproperty.atom == activeAtom_) {
+                    Window active = QueryActiveWindow(display);
+                    if (active != client_) {
+                        Follow(display, active);
+                    }
+                } else if (event.xproperty.window == client_ &&
+                           event.xproperty.atom == extentsAtom_) {
+                    ReadExtents(display);
+                    Publish();
+                }
+                break;
+            case ConfigureNotify:
+                OnConfigure(display, event.xconfigure);
+                break;
+            case ReparentNotify:
+                if (event.xreparent.window == client_) {
+                    Follow(display, client_);
+                }
+                break;
+            case DestroyNotify:
+                if (event.xdestroywindow.window == client_) {
+                    Unfollow(display);
+                    Publish();
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    bool Cached(uint64_t windowId, WindowBounds& bounds, FrameExtents& extents) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (cache_.windowId == 0 || cache_.windowId != windowId) {
+            return false;
+        }
+        bounds = cache_.bounds;
+        extents = cache_.frameExtents;
+        return true;
+    }
+
+   private:
+    void Follow(Display* display, Window client) {
+        Unfollow(display);
+        if (client == 0) {
+            Publish();
+            return;
+        }
+        client_ = client;
+        frame_ = FindFrame(display, client);
+        X11EventLoop::Get().AddInputMask(display, client_, kClientMask);
+        if (frame_ != client_) {
+            X11EventLoop::Get().AddInputMask(display, frame_, kFrameMask);
+        }
+        current_.windowId = static_cast<uint64_t>(client_);
+        Resolve(display);
+        ReadExtents(display);
+        DebugLog("Tracking geometry of window 0x%lx (frame 0x%lx)", client_, frame_);
+        Publish();
+    }
+
+    void Unfollow(Display* display) {
+        if (client_ != 0) {
+            X11EventLoop::Get().RemoveInputMask(display, client_, kClientMask);
+        }
+        if (frame_ != 0 && frame_ != client_) {
+            X11EventLoop::Get().RemoveInputMask(display, frame_, kFrameMask);
+        }
+        client_ = 0;
+        frame_ = 0;
+        current_ = GeometryUpdate();
+    }
+
+    // The only round trips: once per focus change, and when the client moves inside its
+    // frame (rare, e.g. decorations toggled).
+    void Resolve(Display* display) {
+        current_.bounds = ReadWindowBounds(display, client_);
+        if (frame_ != client_) {
+            XWindowAttributes frameAttributes;
+            if (XGetWindowAttributes(display, frame_, &frameAttributes) != 0) {
+                offsetX_ = current_.bounds.x - (frameAttributes.x + frameAttributes.border_width);
+                offsetY_ = current_.bounds.y - (frameAttributes.y + frameAttributes.border_width);
+            }
+        }
+    }
+
+    void OnConfigure(Display* display, const XConfigureEvent& configure) {
+        if (client_ == 0) {
+            return;
+        }
+        if (configure.window == frame_ && frame_ != client_) {
+            // The frame is a child of the root, so these are root coordinates.
+            current_.bounds.x = configure.x + configure.border_width + offsetX_;
+            current_.bounds.y = configure.y + configure.border_width + offsetY_;
+        } else if (configure.window == client_) {
+            current_.bounds.width = configure.width;
+            current_.bounds.height = configure.height;
+            if (configure.send_event || frame_ == client_) {
+                // ICCCM 4.1.5: synthetic events from the WM carry root coordinates, as do
+                // real ones for an unparented top-level window.
+                current_.bounds.x = configure.x + configure.border_width;
+                current_.bounds.y = configure.y + configure.border_width;
+                if (frame_ != client_) {
+                    XWindowAttributes frameAttributes;
+                    if (XGetWindowAttributes(display, frame_, &frameAttributes) != 0) {
+                        offsetX_ = current_.bounds.x -
+                                   (frameAttributes.x + frameAttributes.border_width);
+                        offsetY_ = current_.bounds.y -
+                                   (frameAttributes.y + frameAttributes.border_width);
+                    }
+                }
+            } else {
+                Resolve(display);
+            }
+        } else {
+            return;
+        }
+        Publish();
+    }
+
+    void ReadExtents(Display* display) {
+        unsigned long values[4] = {0, 0, 0, 0};
+        current_.frameExtents = FrameExtents();
+        if (ReadCardinalProperty(display, client_, "_NET_FRAME_EXTENTS", values, 4) == 4) {
+            current_.frameExtents.left = static_cast<long>(values[0]);
+            current_.frameExtents.right = static_cast<long>(values[1]);
+            current_.frameExtents.top = static_cast<long>(values[2]);
+            current_.frameExtents.bottom = static_cast<long>(values[3]);
+        }
+    }
+
+    void Publish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (SameGeometry(cache_, current_)) {
+                return;
+            }
+            cache_ = current_;
+        }
+        if (listener_) {
+            listener_(current_);
+        }
+    }
+
+    geometry_tracker::Listener listener_;
+
+    // Loop thread only.
+    Window root_ = 0;
+    Atom activeAtom_ = None;
+    Atom extentsAtom_ = None;
+    Window client_ = 0;
+    Window frame_ = 0;
+    long offsetX_ = 0;
+    long offsetY_ = 0;
+    GeometryUpdate current_;
+
+    std::mutex mutex_;
+    GeometryUpdate cache_;
+};
+
+std::mutex gTrackerMutex;
+std::unique_ptr<GeometryHandler> gHandler;
+
+}  // namespace
+
+namespace geometry_tracker {
+
+bool Start(Listener listener) {
+    std::lock_guard<std::mutex> lock(gTrackerMutex);
+    X11EventLoop& loop = X11EventLoop::Get();
+    if (!loop.Start()) {
+        return false;
+    }
+    if (gHandler) {
+        GeometryHandler* previous = gHandler.get();
+        loop.RemoveHandler(previous, [previous](Display* display) { previous->Detach(display); });
+        gHandler.reset();
+    }
+    auto handler = std::make_unique<GeometryHandler>(std::move(listener));
+    GeometryHandler* raw = handler.get();
+    loop.AddHandler(raw, [raw](Display* display) { raw->Attach(display); });
+    gHandler = std::move(handler);
+    return true;
+}
+
+void Stop() {
+    std::lock_guard<std::mutex> lock(gTrackerMutex);
+    if (!gHandler) {
+        return;
+    }
+    GeometryHandler* raw = gHandler.get();
+    X11EventLoop::Get().RemoveHandler(raw, [raw](Display* display) { raw->Detach(display); });
+    gHandler.reset();
+}
+
+bool Running() {
+    std::lock_guard<std::mutex> lock(gTrackerMutex);
+    return gHandler != nullptr;
+}
+
+bool CachedGeometry(uint64_t windowId, WindowBounds& bounds, FrameExtents& frameExtents) {
+    std::lock_guard<std::mutex> lock(gTrackerMutex);
+    return gHandler && gHandler->Cached(windowId, bounds, frameExtents);
+}
+
+}  // namespace geometry_tracker
+
+#else
+
+namespace geometry_tracker {
+
+bool Start(Listener) {
+    return false;
+}
+
+void Stop() {}
+
+bool Running() {
+    return false;
+}
+
+bool CachedGeometry(uint64_t, WindowBounds&, FrameExtents&) {
+    return false;
+}
+
+}  // namespace geometry_tracker
+
+#endif  // __linux__
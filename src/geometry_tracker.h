@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "active_window.h"
+
+struct GeometryUpdate {
+    uint64_t windowId = 0;
+    WindowBounds bounds;  // client area in root coordinates
+    FrameExtents frameExtents;
+};
+
+// Follows the focused window and keeps its bounds current from ConfigureNotify events on
+// the client and its window-manager frame, so reading them costs no round trip. The
+// listener runs on a background thread for every move, resize or focus change.
+namespace geometry_tracker {
+
+using Listener = std::function<void(const GeometryUpdate&)>;
+
+bool Start(Listener listener);
+void Stop();
+bool Running();
+
+// Returns false unless windowId is the window currently tracked.
+bool CachedGeometry(uint64_t windowId, WindowBounds& bounds, FrameExtents& frameExtents);
+
+}  // namespace geometry_tracker
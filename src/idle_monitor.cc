@@ -0,0 +1,327 @@
+#include "idle_monitor.h"
+
+#ifdef __linux__
+
+#include <X11/Xlib.h>
+#include <X11/extensions/dpms.h>
+#include <X11/extensions/scrnsaver.h>
+#include <X11/extensions/sync.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+#include "debug_log.h"
+#include "x11_event_loop.h"
+
+namespace {
+
+// DPMS has no event in libXext, so the level is re-read on transitions and, only while the
+// user is already idle, at this interval.
+const int64_t kDpmsRecheckMs = 30000;
+
+int64_t SteadyNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+uint64_t SyncValueToU64(const XSyncValue& value) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(XSyncValueHigh32(value))) << 32) |
+           XSyncValueLow32(value);
+}
+
+XSyncValue U64ToSyncValue(uint64_t value) {
+    XSyncValue result;
+    XSyncIntsToValue(&result, static_cast<unsigned int>(value & 0xffffffffu),
+                     static_cast<int>(value >> 32));
+    return result;
+}
+
+class IdleHandler : public X11EventLoop::Handler {
+   public:
+    IdleHandler(uint64_t thresholdMs, idle_monitor::Listener listener)
+        : thresholdMs_(thresholdMs), listener_(std::move(listener)) {}
+
+    bool Attach(Display* display) {
+        Window root = DefaultRootWindow(display);
+        int syncError = 0;
+        int major = 0;
+        int minor = 0;
+        if (XSyncQueryExtension(display, &syncEventBase_, &syncError) &&
+            XSyncInitialize(display, &major, &minor)) {
+            int counterCount = 0;
+            XSyncSystemCounter* counters = XSyncListSystemCounters(display, &counterCount);
+            for (int i = 0; counters && i < counterCount; ++i) {
+                if (std::strcmp(counters[i].name, "IDLETIME") == 0) {
+                    idleCounter_ = counters[i].counter;
+                    break;
+                }
+            }
+            if (counters) {
+                XSyncFreeSystemCounterList(counters);
+            }
+        }
+        if (idleCounter_ != None) {
+            ArmAlarm(display, false);
+        } else {
+            DebugLog("XSync IDLETIME counter unavailable; idle transitions disabled");
+        }
+
+        int saverError = 0;
+        if (XScreenSaverQueryExtension(display, &saverEventBase_, &saverError)) {
+            hasSaver_ = true;
+            XScreenSaverSelectInput(display, root, ScreenSaverNotifyMask);
+            XScreenSaverInfo* info = XScreenSaverAllocInfo();
+            if (info) {
+                if (XScreenSaverQueryInfo(display, root, info)) {
+                    state_.locked = info->state == ScreenSaverOn;
+                }
+                XFree(info);
+            }
+        }
+
+        int dpmsEvent = 0;
+        int dpmsError = 0;
+        hasDpms_ = DPMSQueryExtension(display, &dpmsEvent, &dpmsError) && DPMSCapable(display);
+        ReadDpms(display);
+
+        DebugLog("Idle monitor attached (sync=%d saver=%d dpms=%d threshold=%llu ms)",
+                 idleCounter_ != None, hasSaver_, hasDpms_,
+                 static_cast<unsigned long long>(thresholdMs_));
+        if (idleCounter_ == None && !hasSaver_) {
+            return false;
+        }
+        Publish();
+        return true;
+    }
+
+    void Detach(Display* display) {
+        if (alarm_ != None) {
+            XSyncDestroyAlarm(display, alarm_);
+            alarm_ = None;
+        }
+        if (hasSaver_) {
+            XScreenSaverSelectInput(display, DefaultRootWindow(display), 0);
+        }
+    }
+
+    void OnEvent(Display* display, XEvent& event) override {
+        if (idleCounter_ != None && event.type == syncEventBase_ + XSyncAlarmNotify) {
+            auto* alarmEvent = reinterpret_cast<XSyncAlarmNotifyEvent*>(&event);
+            if (alarmEvent->alarm != alarm_) {
+                return;
+            }
+            uint64_t idleMs = SyncValueToU64(alarmEvent->counter_value);
+            if (!waitingForActivity_) {
+                UpdateIdle(true, idleMs);
+                ArmAlarm(display, true);
+            } else {
+                UpdateIdle(false, idleMs);
+                ArmAlarm(display, false);
+            }
+            ReadDpms(display);
+            Publish();
+        } else if (hasSaver_ && event.type == saverEventBase_ + ScreenSaverNotify) {
+            auto* saverEvent = reinterpret_cast<XScreenSaverNotifyEvent*>(&event);
+            state_.locked = saverEvent->state == ScreenSaverOn;
+            ReadDpms(display);
+            Publish();
+        }
+    }
+
+    int64_t NextTimerMs() override {
+        if (!hasDpms_ || !waitingForActivity_) {
+            return -1;
+        }
+        int64_t remaining = lastDpmsCheckMs_ + kDpmsRecheckMs - SteadyNowMs();
+        return remaining > 0 ? remaining : 0;
+    }
+
+    void OnTimer(Display* display) override {
+        ReadDpms(display);
+        Publish();
+    }
+
+    IdleState Snapshot(Display* display) {
+        IdleState state = state_;
+        XSyncValue value;
+        if (idleCounter_ != None && XSyncQueryCounter(display, idleCounter_, &value)) {
+            state.idleMs = SyncValueToU64(value);
+        }
+        return state;
+    }
+
+    bool away() const { return away_.load(); }
+
+   private:
+    // Waits for IDLETIME >= threshold while active, or for it to drop below the threshold
+    // (any input resets the counter) while idle. The alarm deactivates after each trigger.
+    void ArmAlarm(Display* display, bool waitForActivity) {
+        XSyncAlarmAttributes attributes;
+        std::memset(&attributes, 0, sizeof(attributes));
+        attributes.trigger.counter = idleCounter_;
+        attributes.trigger.value_type = XSyncAbsolute;
+        attributes.trigger.test_type =
+            waitForActivity ? XSyncNegativeComparison : XSyncPositiveComparison;
+        attributes.trigger.wait_value =
+            U64ToSyncValue(waitForActivity ? thresholdMs_ - 1 : thresholdMs_);
+        XSyncIntToValue(&attributes.delta, 0);
+        attributes.events = True;
+        unsigned long mask = XSyncCACounter | XSyncCAValueType | XSyncCATestType | XSyncCAValue |
+                             XSyncCADelta | XSyncCAEvents;
+        if (alarm_ == None) {
+            alarm_ = XSyncCreateAlarm(display, mask, &attributes);
+        } else {
+            XSyncChangeAlarm(display, alarm_, mask, &attributes);
+        }
+        waitingForActivity_ = waitForActivity;
+    }
+
+    void UpdateIdle(bool idle, uint64_t idleMs) {
+        state_.idle = idle;
+        state_.idleMs = idleMs;
+        if (!idle) {
+            // Input wakes the monitor, so the screen is on again by the time we hear of it.
+            state_.screenOff = false;
+        }
+    }
+
+    void ReadDpms(Display* display) {
+        lastDpmsCheckMs_ = SteadyNowMs();
+        if (!hasDpms_) {
+            return;
+        }
+        CARD16 level = DPMSModeOn;
+        BOOL enabled = False;
+        if (DPMSInfo(display, &level, &enabled)) {
+            state_.screenOff = enabled && level != DPMSModeOn;
+        }
+    }
+
+    void Publish() {
+        const IdleState& state = state_;
+        away_.store(state.idle || state.locked || state.screenOff);
+        if (state.idle == published_.idle && state.locked == published_.locked &&
+            state.screenOff == published_.screenOff && hasPublished_) {
+            return;
+        }
+        published_ = state;
+        hasPublished_ = true;
+        DebugLog("Presence changed: idle=%d locked=%d screenOff=%d", state.idle, state.locked,
+                 state.screenOff);
+        if (listener_) {
+            listener_(state);
+        }
+    }
+
+    uint64_t thresholdMs_;
+    idle_monitor::Listener listener_;
+
+    // Everything below is touched on the loop thread only, except away_.
+    int syncEventBase_ = 0;
+    int saverEventBase_ = 0;
+    XSyncCounter idleCounter_ = None;
+    XSyncAlarm alarm_ = None;
+    bool waitingForActivity_ = false;
+    bool hasSaver_ = false;
+    bool hasDpms_ = false;
+    int64_t lastDpmsCheckMs_ = 0;
+    IdleState state_;
+    IdleState published_;
+    bool hasPublished_ = false;
+    std::atomic<bool> away_{false};
+};
+
+std::mutex gMonitorMutex;
+std::unique_ptr<IdleHandler> gHandler;
+
+}  // namespace
+
+namespace idle_monitor {
+
+bool Start(uint64_t idleThresholdMs, Listener listener) {
+    std::lock_guard<std::mutex> lock(gMonitorMutex);
+    X11EventLoop& loop = X11EventLoop::Get();
+    if (!loop.Start()) {
+        return false;
+    }
+    if (gHandler) {
+        IdleHandler* previous = gHandler.get();
+        loop.RemoveHandler(previous, [previous](Display* display) { previous->Detach(display); });
+        gHandler.reset();
+    }
+
+    auto handler = std::make_unique<IdleHandler>(idleThresholdMs < 1000 ? 1000 : idleThresholdMs,
+                                                 std::move(listener));
+    IdleHandler* raw = handler.get();
+    bool attached = false;
+    loop.AddHandler(raw, [raw, &attached](Display* display) { attached = raw->Attach(display); });
+    if (!attached) {
+        loop.RemoveHandler(raw, [raw](Display* display) { raw->Detach(display); });
+        return false;
+    }
+    gHandler = std::move(handler);
+    return true;
+}
+
+void Stop() {
+    std::lock_guard<std::mutex> lock(gMonitorMutex);
+    if (!gHandler) {
+        return;
+    }
+    IdleHandler* raw = gHandler.get();
+    X11EventLoop::Get().RemoveHandler(raw, [raw](Display* display) { raw->Detach(display); });
+    gHandler.reset();
+}
+
+bool Running() {
+    std::lock_guard<std::mutex> lock(gMonitorMutex);
+    return gHandler != nullptr;
+}
+
+bool Query(IdleState& state) {
+    std::lock_guard<std::mutex> lock(gMonitorMutex);
+    if (!gHandler) {
+        return false;
+    }
+    IdleHandler* raw = gHandler.get();
+    return X11EventLoop::Get().Run([raw, &state](Display* display) {
+        state = raw->Snapshot(display);
+    });
+}
+
+bool IsAway() {
+    std::lock_guard<std::mutex> lock(gMonitorMutex);
+    return gHandler && gHandler->away();
+}
+
+}  // namespace idle_monitor
+
+#else
+
+namespace idle_monitor {
+
+bool Start(uint64_t, Listener) {
+    return false;
+}
+
+void Stop() {}
+
+bool Running() {
+    return false;
+}
+
+bool Query(IdleState&) {
+    return false;
+}
+
+bool IsAway() {
+    return false;
+}
+
+}  // namespace idle_monitor
+
+#endif  // __linux__
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+struct IdleState {
+    bool idle = false;       // no input for at least the configured threshold
+    bool locked = false;     // screen saver / locker active
+    bool screenOff = false;  // DPMS standby, suspend or off
+    uint64_t idleMs = 0;
+};
+
+// Event-driven presence detection. On X11 the server pushes transitions (XSync IDLETIME
+// alarms, MIT-SCREEN-SAVER notifications), so nothing runs while the state is stable.
+// The listener runs on a background thread.
+namespace idle_monitor {
+
+using Listener = std::function<void(const IdleState&)>;
+
+bool Start(uint64_t idleThresholdMs, Listener listener);
+void Stop();
+bool Running();
+
+// Fresh snapshot; idleMs is read from the server on each call.
+bool Query(IdleState& state);
+
+// Cheap check for samplers: true while idle, locked or the screen is off. Always false
+// when the monitor is not running.
+bool IsAway();
+
+}  // namespace idle_monitor
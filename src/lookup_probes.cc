@@ -0,0 +1,196 @@
+#include "lookup_probes.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "debug_log.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+// Probes with semaphores: tracers that attach (bpftrace, perf, SystemTap) raise them, and
+// the arguments are only computed while one is raised.
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define WIN_TRACE_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef WIN_TRACE_HAVE_USDT
+// Named by sdt.h's convention, provider_probe_semaphore; these must not be static.
+__extension__ unsigned short win_trace_stage__start_semaphore __attribute__((unused))
+__attribute__((section(".probes")));
+__extension__ unsigned short win_trace_stage__done_semaphore __attribute__((unused))
+__attribute__((section(".probes")));
+#endif
+
+namespace {
+
+thread_local int tCurrentPid = 0;
+
+std::once_flag gEnvironmentRead;
+
+std::atomic<bool> gTraceEventsOpen{false};
+std::mutex gTraceEventsMutex;
+std::FILE* gTraceEvents = nullptr;
+bool gFirstEvent = true;
+
+bool StartProbeAttached() {
+#ifdef WIN_TRACE_HAVE_USDT
+    return __builtin_expect(win_trace_stage__start_semaphore != 0, 0);
+#else
+    return false;
+#endif
+}
+
+bool DoneProbeAttached() {
+#ifdef WIN_TRACE_HAVE_USDT
+    return __builtin_expect(win_trace_stage__done_semaphore != 0, 0);
+#else
+    return false;
+#endif
+}
+
+long ProcessId() {
+#ifdef _WIN32
+    return _getpid();
+#else
+    return static_cast<long>(getpid());
+#endif
+}
+
+// The kernel's thread id where there is one, so events line up with perf's.
+long ThreadId() {
+#ifdef __linux__
+    return static_cast<long>(syscall(SYS_gettid));
+#else
+    size_t id = std::hash<std::thread::id>()(std::this_thread::get_id());
+    return static_cast<long>(id & 0x7fffffff);
+#endif
+}
+
+void CloseTraceEventsLocked() {
+    if (gTraceEvents) {
+        std::fputs("\n]\n", gTraceEvents);
+        std::fclose(gTraceEvents);
+        gTraceEvents = nullptr;
+    }
+    gTraceEventsOpen = false;
+}
+
+// A complete ("X") event; ts is steady_clock, i.e. CLOCK_MONOTONIC on Linux like perf.
+void WriteTraceEvent(const char* name, int pid, size_t nodes,
+                     std::chrono::steady_clock::time_point started,
+                     std::chrono::steady_clock::duration elapsed) {
+    double ts = std::chrono::duration<double, std::micro>(started.time_since_epoch()).count();
+    double dur = std::chrono::duration<double, std::micro>(elapsed).count();
+    std::lock_guard<std::mutex> lock(gTraceEventsMutex);
+    if (!gTraceEvents) {
+        return;
+    }
+    // The array is closed when the file is; viewers accept a file cut off after an event.
+    std::fprintf(gTraceEvents,
+                 "%s{\"name\":\"%s\",\"cat\":\"lookup\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                 "\"pid\":%ld,\"tid\":%ld,\"args\":{\"pid\":%d,\"nodes\":%zu}}",
+                 gFirstEvent ? "" : ",\n", name, ts, dur, ProcessId(), ThreadId(), pid, nodes);
+    gFirstEvent = false;
+    std::fflush(gTraceEvents);
+}
+
+bool OpenTraceEvents(const std::string& path, std::string& error) {
+    std::lock_guard<std::mutex> lock(gTraceEventsMutex);
+    CloseTraceEventsLocked();
+    if (path.empty()) {
+        return true;
+    }
+    gTraceEvents = std::fopen(path.c_str(), "w");
+    if (!gTraceEvents) {
+        error = "cannot open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    std::fputs("[\n", gTraceEvents);
+    gFirstEvent = true;
+    gTraceEventsOpen = true;
+    DebugLog("Writing trace events to %s", path.c_str());
+    return true;
+}
+
+void ReadEnvironment() {
+    std::call_once(gEnvironmentRead, []() {
+        const char* path = std::getenv("WIN_TRACE_TRACE_EVENTS");
+        std::string error;
+        if (path && path[0] != '\0' && !OpenTraceEvents(path, error)) {
+            DebugLog("WIN_TRACE_TRACE_EVENTS ignored: %s", error.c_str());
+        }
+    });
+}
+
+}  // namespace
+
+LookupStage::LookupStage(const char* name, int pid, const size_t* nodes)
+    : name_(name), pid_(pid), nodes_(nodes) {
+    ReadEnvironment();
+    active_ = gTraceEventsOpen.load(std::memory_order_relaxed) || StartProbeAttached() ||
+              DoneProbeAttached();
+    if (!active_) {
+        return;
+    }
+    outerPid_ = tCurrentPid;
+    if (pid_ == kInheritPid) {
+        pid_ = outerPid_;
+    }
+    tCurrentPid = pid_;
+    nodesAtStart_ = nodes_ ? *nodes_ : 0;
+#ifdef WIN_TRACE_HAVE_USDT
+    if (StartProbeAttached()) {
+        STAP_PROBE2(win_trace, stage__start, name_, pid_);
+    }
+#endif
+    started_ = std::chrono::steady_clock::now();
+}
+
+LookupStage::~LookupStage() {
+    if (!active_) {
+        return;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - started_;
+    size_t nodes = nodes_ ? *nodes_ - nodesAtStart_ : 0;
+    tCurrentPid = outerPid_;
+#ifdef WIN_TRACE_HAVE_USDT
+    if (DoneProbeAttached()) {
+        uint64_t ns = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        STAP_PROBE4(win_trace, stage__done, name_, pid_, nodes, ns);
+    }
+#endif
+    if (gTraceEventsOpen.load(std::memory_order_relaxed)) {
+        WriteTraceEvent(name_, pid_, nodes, started_, elapsed);
+    }
+}
+
+void LookupStage::SetPid(int pid) {
+    if (active_) {
+        pid_ = pid;
+        tCurrentPid = pid;
+    }
+}
+
+bool SetTraceEventFile(const std::string& path, std::string& error) {
+    ReadEnvironment();
+    return OpenTraceEvents(path, error);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+// Stage timing of the lookup pipeline for system-wide tools rather than DebugLog. Every
+// stage fires the USDT probes win_trace:stage__start(stage, pid) and
+// win_trace:stage__done(stage, pid, nodes, ns) when <sys/sdt.h> was found at build time,
+// and appends a complete event to the trace-event file while one is open. The probes are
+// guarded by their semaphores, so with no tracer attached and no file open a stage only
+// checks two counters and a flag.
+class LookupStage {
+   public:
+    // A nested stage passing kInheritPid reports the pid of the stage around it.
+    static constexpr int kInheritPid = -1;
+
+    // name must outlive the stage (a literal). nodes is a counter whose growth during the
+    // stage is reported, e.g. UrlSearchStats::nodesVisited.
+    explicit LookupStage(const char* name, int pid = kInheritPid,
+                         const size_t* nodes = nullptr);
+    ~LookupStage();
+
+    LookupStage(const LookupStage&) = delete;
+    LookupStage& operator=(const LookupStage&) = delete;
+
+    // For a stage that learns the pid as it goes; stages started afterwards inherit it.
+    void SetPid(int pid);
+
+   private:
+    const char* name_;
+    int pid_;
+    int outerPid_ = 0;
+    const size_t* nodes_;
+    size_t nodesAtStart_ = 0;
+    bool active_ = false;
+    std::chrono::steady_clock::time_point started_;
+};
+
+// Writes every stage from now on to path (truncated) as Chrome trace-event JSON, readable
+// by chrome://tracing and Perfetto; an empty path closes the file. WIN_TRACE_TRACE_EVENTS
+// names a file to open at the first stage.
+bool SetTraceEventFile(const std::string& path, std::string& error);
@@ -0,0 +1,437 @@
+#include "lookup_trace.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+
+namespace {
+
+const char kTraceHeader[] = "win-trace-lookup\t1";
+
+const char* const kOpNames[] = {"desktops", "desktop", "role", "states", "name",    "parent",
+                                "children", "child",   "pid",  "text",   "docattr", "extents"};
+const size_t kOpCount = sizeof(kOpNames) / sizeof(kOpNames[0]);
+
+using Clock = std::chrono::steady_clock;
+
+uint32_t MicrosSince(Clock::time_point started) {
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - started).count());
+}
+
+std::string Escape(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value) {
+        switch (c) {
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '\t':
+                escaped += "\\t";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            case '\r':
+                escaped += "\\r";
+                break;
+            default:
+                escaped += c;
+        }
+    }
+    return escaped;
+}
+
+std::string Unescape(const std::string& value) {
+    std::string plain;
+    plain.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] != '\\' || i + 1 == value.size()) {
+            plain += value[i];
+            continue;
+        }
+        char next = value[++i];
+        plain += next == 't' ? '\t' : next == 'n' ? '\n' : next == 'r' ? '\r' : next;
+    }
+    return plain;
+}
+
+std::vector<std::string> SplitFields(const std::string& line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t tab = line.find('\t', start);
+        fields.push_back(Unescape(line.substr(start, tab - start)));
+        if (tab == std::string::npos) {
+            return fields;
+        }
+        start = tab + 1;
+    }
+}
+
+bool ParseOp(const std::string& name, TraceOp& op) {
+    for (size_t i = 0; i < kOpCount; ++i) {
+        if (name == kOpNames[i]) {
+            op = static_cast<TraceOp>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t ParseU32(const std::string& value) {
+    return static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+}
+
+std::string AnswerKey(TraceOp op, uint32_t node, const std::string& arg) {
+    return std::to_string(static_cast<int>(op)) + '\t' + std::to_string(node) + '\t' + arg;
+}
+
+uint32_t NodeId(AccessibleTree::Node node) {
+    return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(node));
+}
+
+AccessibleTree::Node NodeHandle(int64_t id) {
+    return reinterpret_cast<AccessibleTree::Node>(static_cast<uintptr_t>(id));
+}
+
+}  // namespace
+
+void SpinMicros(uint32_t micros) {
+    if (micros == 0) {
+        return;
+    }
+    auto until = Clock::now() + std::chrono::microseconds(micros);
+    while (Clock::now() < until) {
+    }
+}
+
+uint64_t LookupTrace::RecordedMicros() const {
+    uint64_t total = 0;
+    for (const TraceStep& step : steps) {
+        total += step.micros;
+    }
+    for (const TraceCall& call : calls) {
+        total += call.micros;
+    }
+    return total;
+}
+
+bool WriteLookupTrace(const std::string& path, const LookupTrace& trace, std::string& error) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        error = "cannot write " + path;
+        return false;
+    }
+    file << kTraceHeader << '\n'
+         << "window\t" << trace.pid << '\t' << Escape(trace.processName) << '\t'
+         << Escape(trace.title) << '\t' << Escape(trace.url) << '\n';
+    if (!trace.sandboxPids.empty()) {
+        file << "sandbox";
+        for (int pid : trace.sandboxPids) {
+            file << '\t' << pid;
+        }
+        file << '\n';
+    }
+    if (trace.bounds.width > 0) {
+        file << "bounds\t" << trace.bounds.x << '\t' << trace.bounds.y << '\t'
+             << trace.bounds.width << '\t' << trace.bounds.height << '\n';
+    }
+    for (const TraceStep& step : trace.steps) {
+        file << "step\t" << Escape(step.name) << '\t' << step.micros << '\t' << Escape(step.value)
+             << '\n';
+    }
+    for (const TraceCall& call : trace.calls) {
+        file << "call\t" << kOpNames[static_cast<int>(call.op)] << '\t' << call.node << '\t'
+             << Escape(call.arg) << '\t' << call.micros << '\t' << call.result << '\t'
+             << Escape(call.text) << '\n';
+    }
+    if (!file.flush()) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+bool ReadLookupTrace(const std::string& path, LookupTrace& trace, std::string& error) {
+    std::ifstream file(path, std::ios::binary);
+    std::string line;
+    if (!file || !std::getline(file, line) || line != kTraceHeader) {
+        error = path + " is not a lookup trace";
+        return false;
+    }
+    trace = LookupTrace();
+    size_t lineNumber = 1;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        if (line.empty()) {
+            continue;
+        }
+        std::vector<std::string> fields = SplitFields(line);
+        if (fields[0] == "window" && fields.size() == 5) {
+            trace.pid = std::atoi(fields[1].c_str());
+            trace.processName = fields[2];
+            trace.title = fields[3];
+            trace.url = fields[4];
+        } else if (fields[0] == "sandbox") {
+            for (size_t i = 1; i < fields.size(); ++i) {
+                trace.sandboxPids.push_back(std::atoi(fields[i].c_str()));
+            }
+        } else if (fields[0] == "bounds" && fields.size() == 5) {
+            trace.bounds.x = std::atol(fields[1].c_str());
+            trace.bounds.y = std::atol(fields[2].c_str());
+            trace.bounds.width = std::atol(fields[3].c_str());
+            trace.bounds.height = std::atol(fields[4].c_str());
+        } else if (fields[0] == "step" && fields.size() == 4) {
+            trace.steps.push_back(TraceStep{fields[1], fields[3], ParseU32(fields[2])});
+        } else if (fields[0] == "call" && fields.size() == 7) {
+            TraceCall call;
+            if (!ParseOp(fields[1], call.op)) {
+                error = path + ":" + std::to_string(lineNumber) + ": unknown call " + fields[1];
+                return false;
+            }
+            call.node = ParseU32(fields[2]);
+            call.arg = fields[3];
+            call.micros = ParseU32(fields[4]);
+            call.result = std::strtoll(fields[5].c_str(), nullptr, 10);
+            call.text = fields[6];
+            trace.calls.push_back(std::move(call));
+        } else {
+            error = path + ":" + std::to_string(lineNumber) + ": malformed line";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Pointers are only stable while referenced, but libatspi caches its proxies for the
+// life of the connection, so within one lookup a pointer names one accessible.
+uint32_t RecordingTree::Id(Node node) {
+    if (!node) {
+        return 0;
+    }
+    auto inserted = ids_.emplace(node, static_cast<uint32_t>(ids_.size() + 1));
+    return inserted.first->second;
+}
+
+TraceCall& RecordingTree::Append(TraceOp op, Node node, std::string arg, uint32_t micros) {
+    // Pass the backend's timeouts on, so the search gives up on a hung app while recording too.
+    for (; timeouts_ < tree_.stats().timeouts; ++timeouts_) {
+        NoteTimeout();
+    }
+    TraceCall call;
+    call.op = op;
+    call.node = Id(node);
+    call.arg = std::move(arg);
+    call.micros = micros;
+    trace_.calls.push_back(std::move(call));
+    return trace_.calls.back();
+}
+
+int RecordingTree::DoDesktopCount() {
+    auto started = Clock::now();
+    int count = tree_.DesktopCount();
+    Append(TraceOp::DesktopCount, nullptr, std::string(), MicrosSince(started)).result = count;
+    return count;
+}
+
+AccessibleTree::Node RecordingTree::DoDesktop(int index) {
+    auto started = Clock::now();
+    Node desktop = tree_.Desktop(index);
+    uint32_t micros = MicrosSince(started);
+    Append(TraceOp::Desktop, nullptr, std::to_string(index), micros).result = Id(desktop);
+    return desktop;
+}
+
+AccessibleRole RecordingTree::DoRole(Node node) {
+    auto started = Clock::now();
+    AccessibleRole role = tree_.Role(node);
+    Append(TraceOp::Role, node, std::string(), MicrosSince(started)).result =
+        static_cast<int64_t>(role);
+    return role;
+}
+
+bool RecordingTree::DoStates(Node node, uint32_t& states) {
+    auto started = Clock::now();
+    bool ok = tree_.States(node, states);
+    TraceCall& call = Append(TraceOp::States, node, std::string(), MicrosSince(started));
+    call.result = ok ? static_cast<int64_t>(states) : -1;
+    return ok;
+}
+
+std::string RecordingTree::DoName(Node node) {
+    auto started = Clock::now();
+    std::string name = tree_.Name(node);
+    Append(TraceOp::Name, node, std::string(), MicrosSince(started)).text = name;
+    return name;
+}
+
+AccessibleTree::Node RecordingTree::DoParent(Node node) {
+    auto started = Clock::now();
+    Node parent = tree_.Parent(node);
+    uint32_t micros = MicrosSince(started);
+    Append(TraceOp::Parent, node, std::string(), micros).result = Id(parent);
+    return parent;
+}
+
+int RecordingTree::DoChildCount(Node node) {
+    auto started = Clock::now();
+    int count = tree_.ChildCount(node);
+    Append(TraceOp::ChildCount, node, std::string(), MicrosSince(started)).result = count;
+    return count;
+}
+
+AccessibleTree::Node RecordingTree::DoChildAt(Node node, int index) {
+    auto started = Clock::now();
+    Node child = tree_.ChildAt(node, index);
+    uint32_t micros = MicrosSince(started);
+    Append(TraceOp::ChildAt, node, std::to_string(index), micros).result = Id(child);
+    return child;
+}
+
+int RecordingTree::DoProcessId(Node node) {
+    auto started = Clock::now();
+    int pid = tree_.ProcessId(node);
+    Append(TraceOp::ProcessId, node, std::string(), MicrosSince(started)).result = pid;
+    return pid;
+}
+
+bool RecordingTree::DoText(Node node, std::string& value) {
+    auto started = Clock::now();
+    bool ok = tree_.Text(node, value);
+    TraceCall& call = Append(TraceOp::Text, node, std::string(), MicrosSince(started));
+    call.result = ok ? 1 : 0;
+    if (ok) {
+        call.text = value;
+    }
+    return ok;
+}
+
+bool RecordingTree::DoDocumentAttribute(Node node, const std::string& name, std::string& value) {
+    auto started = Clock::now();
+    bool ok = tree_.DocumentAttribute(node, name, value);
+    TraceCall& call = Append(TraceOp::DocumentAttribute, node, name, MicrosSince(started));
+    call.result = ok ? 1 : 0;
+    if (ok) {
+        call.text = value;
+    }
+    return ok;
+}
+
+bool RecordingTree::DoExtents(Node node, AccessibleRect& rect) {
+    auto started = Clock::now();
+    bool ok = tree_.Extents(node, rect);
+    TraceCall& call = Append(TraceOp::Extents, node, std::string(), MicrosSince(started));
+    call.result = ok ? 1 : 0;
+    if (ok) {
+        call.text = std::to_string(rect.x) + "," + std::to_string(rect.y) + "," +
+                    std::to_string(rect.width) + "," + std::to_string(rect.height);
+    }
+    return ok;
+}
+
+ReplayTree::ReplayTree(const LookupTrace& trace, ReplayTiming timing) : timing_(timing) {
+    for (const TraceCall& call : trace.calls) {
+        answers_[AnswerKey(call.op, call.node, call.arg)].calls.push_back(&call);
+    }
+}
+
+const TraceCall* ReplayTree::Answer(TraceOp op, Node node, const std::string& arg) {
+    auto it = answers_.find(AnswerKey(op, NodeId(node), arg));
+    if (it == answers_.end()) {
+        ++misses_;
+        return nullptr;
+    }
+    Answers& answers = it->second;
+    const TraceCall* call = answers.calls[answers.next];
+    if (answers.next + 1 < answers.calls.size()) {
+        ++answers.next;
+    }
+    if (timing_ == ReplayTiming::Original) {
+        SpinMicros(call->micros);
+    }
+    return call;
+}
+
+int ReplayTree::DoDesktopCount() {
+    const TraceCall* call = Answer(TraceOp::DesktopCount, nullptr, std::string());
+    return call ? static_cast<int>(call->result) : 0;
+}
+
+AccessibleTree::Node ReplayTree::DoDesktop(int index) {
+    const TraceCall* call = Answer(TraceOp::Desktop, nullptr, std::to_string(index));
+    return call ? NodeHandle(call->result) : nullptr;
+}
+
+AccessibleRole ReplayTree::DoRole(Node node) {
+    const TraceCall* call = Answer(TraceOp::Role, node, std::string());
+    return call ? static_cast<AccessibleRole>(call->result) : AccessibleRole::Other;
+}
+
+bool ReplayTree::DoStates(Node node, uint32_t& states) {
+    const TraceCall* call = Answer(TraceOp::States, node, std::string());
+    if (!call || call->result < 0) {
+        return false;
+    }
+    states = static_cast<uint32_t>(call->result);
+    return true;
+}
+
+std::string ReplayTree::DoName(Node node) {
+    const TraceCall* call = Answer(TraceOp::Name, node, std::string());
+    return call ? call->text : std::string();
+}
+
+AccessibleTree::Node ReplayTree::DoParent(Node node) {
+    const TraceCall* call = Answer(TraceOp::Parent, node, std::string());
+    return call ? NodeHandle(call->result) : nullptr;
+}
+
+int ReplayTree::DoChildCount(Node node) {
+    const TraceCall* call = Answer(TraceOp::ChildCount, node, std::string());
+    return call ? static_cast<int>(call->result) : 0;
+}
+
+AccessibleTree::Node ReplayTree::DoChildAt(Node node, int index) {
+    const TraceCall* call = Answer(TraceOp::ChildAt, node, std::to_string(index));
+    return call ? NodeHandle(call->result) : nullptr;
+}
+
+int ReplayTree::DoProcessId(Node node) {
+    const TraceCall* call = Answer(TraceOp::ProcessId, node, std::string());
+    return call ? static_cast<int>(call->result) : 0;
+}
+
+bool ReplayTree::DoText(Node node, std::string& value) {
+    const TraceCall* call = Answer(TraceOp::Text, node, std::string());
+    if (!call || call->result == 0) {
+        return false;
+    }
+    value = call->text;
+    return true;
+}
+
+bool ReplayTree::DoDocumentAttribute(Node node, const std::string& name, std::string& value) {
+    const TraceCall* call = Answer(TraceOp::DocumentAttribute, node, name);
+    if (!call || call->result == 0) {
+        return false;
+    }
+    value = call->text;
+    return true;
+}
+
+bool ReplayTree::DoExtents(Node node, AccessibleRect& rect) {
+    const TraceCall* call = Answer(TraceOp::Extents, node, std::string());
+    if (!call || call->result == 0) {
+        return false;
+    }
+    const char* cursor = call->text.c_str();
+    char* next = nullptr;
+    long* fields[] = {&rect.x, &rect.y, &rect.width, &rect.height};
+    for (long* field : fields) {
+        *field = std::strtol(cursor, &next, 10);
+        cursor = *next == ',' ? next + 1 : next;
+    }
+    return true;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "accessible_tree.h"
+
+// One window lookup as it happened on a user's desktop: the X11 and /proc reads that
+// identified the window, then every accessibility call of the URL search with its
+// arguments, answer and duration. Written as a tab-separated text file (one line per
+// step or call), replayed without a desktop session by ReplayTree.
+
+enum class TraceOp {
+    DesktopCount,
+    Desktop,
+    Role,
+    States,
+    Name,
+    Parent,
+    ChildCount,
+    ChildAt,
+    ProcessId,
+    Text,
+    DocumentAttribute,
+    Extents,
+};
+
+// A read made before the URL search, e.g. "activeWindow" or "title".
+struct TraceStep {
+    std::string name;
+    std::string value;
+    uint32_t micros = 0;
+};
+
+struct TraceCall {
+    TraceOp op = TraceOp::DesktopCount;
+    uint32_t node = 0;  // recording-local id; 0 is null
+    std::string arg;    // child/desktop index or attribute name
+    // Node id, count, role, state bits or pid; 0/1 for the Text, attribute and extents
+    // calls (extents go in text as "x,y,width,height").
+    int64_t result = 0;
+    std::string text;
+    uint32_t micros = 0;
+};
+
+struct LookupTrace {
+    int pid = 0;
+    std::vector<int> sandboxPids;  // the rest of pid's sandbox instance, if any
+    AccessibleRect bounds;         // of the window; width 0 when not recorded
+    std::string processName;
+    std::string title;
+    std::string url;
+    std::vector<TraceStep> steps;
+    std::vector<TraceCall> calls;
+
+    uint64_t RecordedMicros() const;
+};
+
+bool WriteLookupTrace(const std::string& path, const LookupTrace& trace, std::string& error);
+bool ReadLookupTrace(const std::string& path, LookupTrace& trace, std::string& error);
+
+// Passes every call through to tree and appends it to trace. Ref/Unref are not recorded.
+class RecordingTree : public AccessibleTree {
+   public:
+    RecordingTree(AccessibleTree& tree, LookupTrace& trace)
+        : tree_(tree), trace_(trace), timeouts_(tree.stats().timeouts) {}
+
+   protected:
+    Node DoRef(Node node) override { return tree_.Ref(node); }
+    void DoUnref(Node node) override { tree_.Unref(node); }
+    int DoDesktopCount() override;
+    Node DoDesktop(int index) override;
+    AccessibleRole DoRole(Node node) override;
+    bool DoStates(Node node, uint32_t& states) override;
+    std::string DoName(Node node) override;
+    Node DoParent(Node node) override;
+    int DoChildCount(Node node) override;
+    Node DoChildAt(Node node, int index) override;
+    int DoProcessId(Node node) override;
+    bool DoText(Node node, std::string& value) override;
+    bool DoDocumentAttribute(Node node, const std::string& name, std::string& value) override;
+    bool DoExtents(Node node, AccessibleRect& rect) override;
+    std::string DoApplicationId(Node node) override { return tree_.ApplicationId(node); }
+
+   private:
+    uint32_t Id(Node node);
+    TraceCall& Append(TraceOp op, Node node, std::string arg, uint32_t micros);
+
+    AccessibleTree& tree_;
+    LookupTrace& trace_;
+    std::unordered_map<Node, uint32_t> ids_;
+    uint64_t timeouts_;
+};
+
+enum class ReplayTiming {
+    Original,  // busy-wait each call's recorded duration
+    Instant,
+};
+
+// Answers from a recorded trace. A call that was recorded several times gets the recorded
+// answers in order (the last one repeats); a call the recording never made (the search
+// code changed) gets a null/empty answer and counts as a miss. trace must outlive the tree.
+class ReplayTree : public AccessibleTree {
+   public:
+    ReplayTree(const LookupTrace& trace, ReplayTiming timing);
+
+    size_t misses() const { return misses_; }
+
+   protected:
+    Node DoRef(Node node) override { return node; }
+    void DoUnref(Node) override {}
+    int DoDesktopCount() override;
+    Node DoDesktop(int index) override;
+    AccessibleRole DoRole(Node node) override;
+    bool DoStates(Node node, uint32_t& states) override;
+    std::string DoName(Node node) override;
+    Node DoParent(Node node) override;
+    int DoChildCount(Node node) override;
+    Node DoChildAt(Node node, int index) override;
+    int DoProcessId(Node node) override;
+    bool DoText(Node node, std::string& value) override;
+    bool DoDocumentAttribute(Node node, const std::string& name, std::string& value) override;
+    bool DoExtents(Node node, AccessibleRect& rect) override;
+
+   private:
+    struct Answers {
+        std::vector<const TraceCall*> calls;
+        size_t next = 0;
+    };
+
+    const TraceCall* Answer(TraceOp op, Node node, const std::string& arg);
+
+    ReplayTiming timing_;
+    std::unordered_map<std::string, Answers> answers_;
+    size_t misses_ = 0;
+};
+
+// Busy-waits (sleeping would round up to scheduler ticks).
+void SpinMicros(uint32_t micros);
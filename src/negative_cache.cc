@@ -0,0 +1,62 @@
+#include "negative_cache.h"
+
+#include <algorithm>
+#include <iterator>
+
+const char* LookupFailureName(LookupFailure failure) {
+    switch (failure) {
+        case LookupFailure::InitFailed:
+            return "init-failed";
+        case LookupFailure::NoRoot:
+            return "no-root";
+        case LookupFailure::NoEntry:
+            return "no-entry";
+    }
+    return "unknown";
+}
+
+bool NegativeLookupCache::Suppressed(int pid, uint64_t windowId, const std::string& title,
+                                     LookupFailure& reason, Clock::time_point now) const {
+    auto it = entries_.find(Key(pid, windowId));
+    if (it == entries_.end() || now >= it->second.retryAt || it->second.title != title) {
+        return false;
+    }
+    reason = it->second.reason;
+    return true;
+}
+
+void NegativeLookupCache::RecordFailure(int pid, uint64_t windowId, const std::string& title,
+                                        LookupFailure reason, Clock::time_point now) {
+    if (backoffMs_ == 0) {
+        return;
+    }
+    if (entries_.size() >= capacity_) {
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            it = now >= it->second.retryAt ? entries_.erase(it) : std::next(it);
+        }
+        if (entries_.size() >= capacity_) {
+            entries_.clear();
+        }
+    }
+    Entry& entry = entries_[Key(pid, windowId)];
+    uint64_t backoff = backoffMs_;
+    for (uint32_t i = 0; i < entry.failures && backoff < maxBackoffMs_; ++i) {
+        backoff *= 2;
+    }
+    ++entry.failures;
+    entry.reason = reason;
+    entry.title = title;
+    entry.retryAt = now + std::chrono::milliseconds(std::min<uint64_t>(backoff, maxBackoffMs_));
+}
+
+void NegativeLookupCache::RecordSuccess(int pid, uint64_t windowId) {
+    if (!entries_.empty()) {
+        entries_.erase(Key(pid, windowId));
+    }
+}
+
+void NegativeLookupCache::Invalidate(LookupFailure reason) {
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        it = it->second.reason == reason ? entries_.erase(it) : std::next(it);
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// Why a browser lookup found no URL.
+enum class LookupFailure {
+    InitFailed,  // AT-SPI plugin missing or the accessibility bus unreachable
+    NoRoot,      // the browser has no accessible application (accessibility not enabled)
+    NoEntry,     // the browser is accessible but shows no document URL or address bar
+};
+
+const char* LookupFailureName(LookupFailure failure);
+
+// Failed URL lookups per (pid, window), so a browser without an accessibility tree costs a
+// hash probe per poll instead of desktop-wide walks. A failure suppresses further lookups
+// of the window for backoff, doubling per repeated failure up to maxBackoffMs. A changed
+// window title, a success, or Invalidate (driven by AT-SPI window events) lifts it early.
+// Not thread-safe: callers hold the AT-SPI lock.
+class NegativeLookupCache {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit NegativeLookupCache(uint32_t backoffMs = 2000, uint32_t maxBackoffMs = 60000,
+                                 size_t capacity = 512)
+        : backoffMs_(backoffMs), maxBackoffMs_(maxBackoffMs), capacity_(capacity) {}
+
+    // True, with the recorded reason, while the window's last lookup failure suppresses
+    // another one.
+    bool Suppressed(int pid, uint64_t windowId, const std::string& title, LookupFailure& reason,
+                    Clock::time_point now = Clock::now()) const;
+    void RecordFailure(int pid, uint64_t windowId, const std::string& title, LookupFailure reason,
+                       Clock::time_point now = Clock::now());
+    void RecordSuccess(int pid, uint64_t windowId);
+    // Lifts every suppression recorded for reason.
+    void Invalidate(LookupFailure reason);
+
+    size_t size() const { return entries_.size(); }
+
+   private:
+    struct Entry {
+        LookupFailure reason = LookupFailure::NoRoot;
+        uint32_t failures = 0;
+        Clock::time_point retryAt;
+        std::string title;
+    };
+
+    // X11 window ids fit in 32 bits.
+    static uint64_t Key(int pid, uint64_t windowId) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(pid)) << 32) | (windowId & 0xffffffffu);
+    }
+
+    uint32_t backoffMs_;
+    uint32_t maxBackoffMs_;
+    size_t capacity_;
+    std::unordered_map<uint64_t, Entry> entries_;
+};
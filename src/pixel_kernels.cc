@@ -0,0 +1,314 @@
+#include "pixel_kernels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define WIN_TRACE_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define WIN_TRACE_NEON 1
+#endif
+
+namespace {
+
+inline uint32_t LoadPixel(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, 4);
+    return value;
+}
+
+inline void StorePixel(uint8_t* p, uint32_t value) {
+    std::memcpy(p, &value, 4);
+}
+
+inline uint32_t SwapRedBlue(uint32_t pixel) {
+    return (pixel & 0xFF00FF00u) | ((pixel >> 16) & 0xFFu) | ((pixel & 0xFFu) << 16);
+}
+
+inline uint32_t SwizzlePixel(uint32_t bgrx) {
+    return 0xFF000000u | SwapRedBlue(bgrx);
+}
+
+// Rounded average of four pixels, per channel.
+inline uint32_t AveragePixels(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t sum = ((a >> shift) & 0xFF) + ((b >> shift) & 0xFF) + ((c >> shift) & 0xFF) +
+                       ((d >> shift) & 0xFF);
+        result |= ((sum + 2) >> 2) << shift;
+    }
+    return result;
+}
+
+// a + (b - a) * weight / 256 on all four channels at once, two 16-bit lanes per word.
+inline uint32_t LerpPixel(uint32_t a, uint32_t b, uint32_t weight) {
+    uint32_t inverse = 256 - weight;
+    uint32_t rb = ((a & 0x00FF00FFu) * inverse + (b & 0x00FF00FFu) * weight) >> 8;
+    uint32_t ga = ((a >> 8) & 0x00FF00FFu) * inverse + ((b >> 8) & 0x00FF00FFu) * weight;
+    return (rb & 0x00FF00FFu) | (ga & 0xFF00FF00u);
+}
+
+// weight is 1..255; rows with weight 0 are used as they are.
+void LerpRows(const uint8_t* top, const uint8_t* bottom, uint32_t weight, uint8_t* dst,
+              size_t pixels) {
+    size_t i = 0;
+#if defined(WIN_TRACE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i w0 = _mm_set1_epi16(static_cast<short>(256 - weight));
+    const __m128i w1 = _mm_set1_epi16(static_cast<short>(weight));
+    for (; i + 4 <= pixels; i += 4) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(top + i * 4));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + i * 4));
+        // At most 255 * 256 per lane, so the 16-bit sums cannot overflow.
+        __m128i lo = _mm_srli_epi16(
+            _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), w0),
+                          _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), w1)),
+            8);
+        __m128i hi = _mm_srli_epi16(
+            _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), w0),
+                          _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), w1)),
+            8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_packus_epi16(lo, hi));
+    }
+#elif defined(WIN_TRACE_NEON)
+    const uint8x8_t w0 = vdup_n_u8(static_cast<uint8_t>(256 - weight));
+    const uint8x8_t w1 = vdup_n_u8(static_cast<uint8_t>(weight));
+    for (; i + 4 <= pixels; i += 4) {
+        uint8x16_t a = vld1q_u8(top + i * 4);
+        uint8x16_t b = vld1q_u8(bottom + i * 4);
+        uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(a), w0), vget_low_u8(b), w1);
+        uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(a), w0), vget_high_u8(b), w1);
+        vst1q_u8(dst + i * 4, vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)));
+    }
+#endif
+    for (; i < pixels; ++i) {
+        StorePixel(dst + i * 4, LerpPixel(LoadPixel(top + i * 4), LoadPixel(bottom + i * 4), weight));
+    }
+}
+
+// Bilinear resample; Convert maps each output pixel (BGRX to RGBA, or nothing).
+template <typename Convert>
+void Resample(const uint8_t* src, size_t srcStride, uint32_t srcWidth, uint32_t srcHeight,
+              uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight, Convert convert) {
+    // Sample positions in 16.16 fixed point, pixel centres aligned.
+    auto position = [](uint32_t index, uint32_t srcSize, uint32_t dstSize, uint32_t& base,
+                       uint32_t& weight) {
+        int64_t fixed = ((2 * static_cast<int64_t>(index) + 1) * srcSize * 65536) /
+                            (2 * static_cast<int64_t>(dstSize)) -
+                        32768;
+        fixed = std::max<int64_t>(0, fixed);
+        base = std::min<uint32_t>(static_cast<uint32_t>(fixed >> 16), srcSize - 1);
+        weight = base + 1 < srcSize ? static_cast<uint32_t>((fixed >> 8) & 0xFF) : 0;
+    };
+
+    std::vector<uint32_t> xBase(dstWidth);
+    std::vector<uint32_t> xWeight(dstWidth);
+    for (uint32_t x = 0; x < dstWidth; ++x) {
+        position(x, srcWidth, dstWidth, xBase[x], xWeight[x]);
+    }
+
+    // Separable: blend the two source rows once (SIMD), then blend horizontally per pixel.
+    std::vector<uint8_t> blended(static_cast<size_t>(srcWidth) * 4);
+    for (uint32_t y = 0; y < dstHeight; ++y) {
+        uint32_t y0 = 0;
+        uint32_t wy = 0;
+        position(y, srcHeight, dstHeight, y0, wy);
+        const uint8_t* row = src + static_cast<size_t>(y0) * srcStride;
+        if (wy) {
+            LerpRows(row, row + srcStride, wy, blended.data(), srcWidth);
+            row = blended.data();
+        }
+        uint8_t* out = dst + static_cast<size_t>(y) * dstWidth * 4;
+        for (uint32_t x = 0; x < dstWidth; ++x) {
+            const uint8_t* p = row + static_cast<size_t>(xBase[x]) * 4;
+            uint32_t left = LoadPixel(p);
+            uint32_t pixel = xWeight[x] ? LerpPixel(left, LoadPixel(p + 4), xWeight[x]) : left;
+            StorePixel(out + static_cast<size_t>(x) * 4, convert(pixel));
+        }
+    }
+}
+
+// HalveBgrx averages every byte alike, so it serves both pixel formats.
+template <typename ConvertRow, typename Convert>
+void Scale(uint8_t* src, size_t srcStride, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst,
+           uint32_t dstWidth, uint32_t dstHeight, ConvertRow convertRow, Convert convert) {
+    uint32_t width = srcWidth;
+    uint32_t height = srcHeight;
+    size_t stride = srcStride;
+    while (width / 2 >= dstWidth && height / 2 >= dstHeight && width >= 2 && height >= 2) {
+        size_t halfStride = static_cast<size_t>(width / 2) * 4;
+        HalveBgrx(src, stride, width, height, src, halfStride);
+        width /= 2;
+        height /= 2;
+        stride = halfStride;
+    }
+
+    if (width == dstWidth && height == dstHeight) {
+        for (uint32_t y = 0; y < height; ++y) {
+            convertRow(src + static_cast<size_t>(y) * stride,
+                       dst + static_cast<size_t>(y) * dstWidth * 4, width);
+        }
+        return;
+    }
+    Resample(src, stride, width, height, dst, dstWidth, dstHeight, convert);
+}
+
+}  // namespace
+
+void BgrxToRgba(const uint8_t* src, uint8_t* dst, size_t pixels) {
+    size_t i = 0;
+#if defined(WIN_TRACE_SSE2)
+    const __m128i green = _mm_set1_epi32(0x0000FF00);
+    const __m128i low = _mm_set1_epi32(0x000000FF);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    for (; i + 4 <= pixels; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+        __m128i out = _mm_or_si128(_mm_and_si128(v, green), alpha);
+        out = _mm_or_si128(out, _mm_and_si128(_mm_srli_epi32(v, 16), low));
+        out = _mm_or_si128(out, _mm_slli_epi32(_mm_and_si128(v, low), 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), out);
+    }
+#elif defined(WIN_TRACE_NEON)
+    for (; i + 16 <= pixels; i += 16) {
+        uint8x16x4_t in = vld4q_u8(src + i * 4);
+        uint8x16x4_t out;
+        out.val[0] = in.val[2];
+        out.val[1] = in.val[1];
+        out.val[2] = in.val[0];
+        out.val[3] = vdupq_n_u8(0xFF);
+        vst4q_u8(dst + i * 4, out);
+    }
+#endif
+    for (; i < pixels; ++i) {
+        StorePixel(dst + i * 4, SwizzlePixel(LoadPixel(src + i * 4)));
+    }
+}
+
+void HalveBgrx(const uint8_t* src, size_t srcStride, uint32_t width, uint32_t height,
+               uint8_t* dst, size_t dstStride) {
+    const uint32_t outWidth = width / 2;
+    const uint32_t outHeight = height / 2;
+    for (uint32_t y = 0; y < outHeight; ++y) {
+        const uint8_t* row0 = src + static_cast<size_t>(y) * 2 * srcStride;
+        const uint8_t* row1 = row0 + srcStride;
+        uint8_t* out = dst + static_cast<size_t>(y) * dstStride;
+        uint32_t x = 0;
+#if defined(WIN_TRACE_SSE2)
+        for (; x + 4 <= outWidth; x += 4) {
+            const uint8_t* p0 = row0 + static_cast<size_t>(x) * 8;
+            const uint8_t* p1 = row1 + static_cast<size_t>(x) * 8;
+            __m128i v0 = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p0)),
+                                      _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1)));
+            __m128i v1 =
+                _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p0 + 16)),
+                             _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1 + 16)));
+            __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(v0), _mm_castsi128_ps(v1),
+                                         _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(v0), _mm_castsi128_ps(v1),
+                                        _MM_SHUFFLE(3, 1, 3, 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + static_cast<size_t>(x) * 4),
+                             _mm_avg_epu8(_mm_castps_si128(even), _mm_castps_si128(odd)));
+        }
+#elif defined(WIN_TRACE_NEON)
+        for (; x + 4 <= outWidth; x += 4) {
+            uint32x4x2_t top = vld2q_u32(reinterpret_cast<const uint32_t*>(row0 + x * 8));
+            uint32x4x2_t bottom = vld2q_u32(reinterpret_cast<const uint32_t*>(row1 + x * 8));
+            uint8x16_t even = vrhaddq_u8(vreinterpretq_u8_u32(top.val[0]),
+                                         vreinterpretq_u8_u32(bottom.val[0]));
+            uint8x16_t odd = vrhaddq_u8(vreinterpretq_u8_u32(top.val[1]),
+                                        vreinterpretq_u8_u32(bottom.val[1]));
+            vst1q_u8(out + x * 4, vrhaddq_u8(even, odd));
+        }
+#endif
+        for (; x < outWidth; ++x) {
+            const uint8_t* p0 = row0 + static_cast<size_t>(x) * 8;
+            const uint8_t* p1 = row1 + static_cast<size_t>(x) * 8;
+            StorePixel(out + static_cast<size_t>(x) * 4,
+                       AveragePixels(LoadPixel(p0), LoadPixel(p0 + 4), LoadPixel(p1),
+                                     LoadPixel(p1 + 4)));
+        }
+    }
+}
+
+void ResampleBgrxToRgba(const uint8_t* src, size_t srcStride, uint32_t srcWidth,
+                        uint32_t srcHeight, uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight) {
+    Resample(src, srcStride, srcWidth, srcHeight, dst, dstWidth, dstHeight, SwizzlePixel);
+}
+
+void ScaleBgrxToRgba(uint8_t* src, size_t srcStride, uint32_t srcWidth, uint32_t srcHeight,
+                     uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight) {
+    Scale(src, srcStride, srcWidth, srcHeight, dst, dstWidth, dstHeight, BgrxToRgba,
+          SwizzlePixel);
+}
+
+void ScaleRgba(uint8_t* src, size_t srcStride, uint32_t srcWidth, uint32_t srcHeight,
+               uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight) {
+    Scale(
+        src, srcStride, srcWidth, srcHeight, dst, dstWidth, dstHeight,
+        [](const uint8_t* row, uint8_t* out, size_t pixels) { std::memcpy(out, row, pixels * 4); },
+        [](uint32_t pixel) { return pixel; });
+}
+
+void ArgbCardinalsToRgba(const unsigned long* src, uint8_t* dst, size_t pixels) {
+    size_t i = 0;
+    // Each pixel's value is the low half of its 8-byte long; pack four, then swap R and B.
+    if (sizeof(unsigned long) == 8) {
+#if defined(WIN_TRACE_SSE2)
+        const __m128i redBlue = _mm_set1_epi32(0x000000FF);
+        const __m128i greenAlpha = _mm_set1_epi32(static_cast<int>(0xFF00FF00u));
+        for (; i + 4 <= pixels; i += 4) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 2));
+            __m128i v = _mm_unpacklo_epi64(_mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0)),
+                                           _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0)));
+            __m128i out = _mm_and_si128(v, greenAlpha);
+            out = _mm_or_si128(out, _mm_and_si128(_mm_srli_epi32(v, 16), redBlue));
+            out = _mm_or_si128(out, _mm_slli_epi32(_mm_and_si128(v, redBlue), 16));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), out);
+        }
+#elif defined(WIN_TRACE_NEON)
+        const uint32x4_t redBlue = vdupq_n_u32(0x000000FFu);
+        const uint32x4_t greenAlpha = vdupq_n_u32(0xFF00FF00u);
+        for (; i + 4 <= pixels; i += 4) {
+            uint32x4_t v = vld2q_u32(reinterpret_cast<const uint32_t*>(src + i)).val[0];
+            uint32x4_t out = vorrq_u32(vandq_u32(v, greenAlpha),
+                                       vandq_u32(vshrq_n_u32(v, 16), redBlue));
+            out = vorrq_u32(out, vshlq_n_u32(vandq_u32(v, redBlue), 16));
+            vst1q_u8(dst + i * 4, vreinterpretq_u8_u32(out));
+        }
+#endif
+    }
+    for (; i < pixels; ++i) {
+        StorePixel(dst + i * 4, SwapRedBlue(static_cast<uint32_t>(src[i])));
+    }
+}
+
+void PremultiplyRgba(uint8_t* pixels, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t* p = pixels + i * 4;
+        uint32_t alpha = p[3];
+        if (alpha == 255) {
+            continue;
+        }
+        for (int channel = 0; channel < 3; ++channel) {
+            p[channel] = static_cast<uint8_t>((p[channel] * alpha + 127) / 255);
+        }
+    }
+}
+
+void UnpremultiplyRgba(uint8_t* pixels, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t* p = pixels + i * 4;
+        uint32_t alpha = p[3];
+        if (alpha == 255 || alpha == 0) {
+            continue;
+        }
+        for (int channel = 0; channel < 3; ++channel) {
+            uint32_t value = (p[channel] * 255 + alpha / 2) / alpha;
+            p[channel] = static_cast<uint8_t>(std::min<uint32_t>(255, value));
+        }
+    }
+}
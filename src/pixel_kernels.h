@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Kernels for 32-bit BGRX pixels as X11 ZPixmap images store them on little-endian
+// machines (depth 24 and 32). RGBA output always has alpha 255: the X byte is undefined
+// on depth-24 visuals. SSE2 and NEON paths, scalar elsewhere.
+
+void BgrxToRgba(const uint8_t* src, uint8_t* dst, size_t pixels);
+
+// _NET_WM_ICON pixels as Xlib returns them: one ARGB value per unsigned long (8 bytes on
+// LP64). Output is RGBA with alpha kept (not premultiplied).
+void ArgbCardinalsToRgba(const unsigned long* src, uint8_t* dst, size_t pixels);
+
+// 2x2 box filter; dst gets (width / 2) x (height / 2) pixels at dstStride. dst may alias
+// src (halving in place), since every output row is written behind the rows it reads.
+void HalveBgrx(const uint8_t* src, size_t srcStride, uint32_t width, uint32_t height,
+               uint8_t* dst, size_t dstStride);
+
+// Bilinear resample to dstWidth x dstHeight, converting to tightly packed RGBA.
+void ResampleBgrxToRgba(const uint8_t* src, size_t srcStride, uint32_t srcWidth,
+                        uint32_t srcHeight, uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight);
+
+// Halves in place while the image is at least twice the target, then resamples (or just
+// converts) into dst. src is clobbered.
+void ScaleBgrxToRgba(uint8_t* src, size_t srcStride, uint32_t srcWidth, uint32_t srcHeight,
+                     uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight);
+
+// The same for any four 8-bit channels, kept as they are (alpha included). Filter
+// premultiplied pixels, or transparent areas bleed their colour into the edges.
+void ScaleRgba(uint8_t* src, size_t srcStride, uint32_t srcWidth, uint32_t srcHeight,
+               uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight);
+
+// In place, between straight and premultiplied alpha.
+void PremultiplyRgba(uint8_t* pixels, size_t count);
+void UnpremultiplyRgba(uint8_t* pixels, size_t count);
@@ -0,0 +1,236 @@
+#include "process_tree.h"
+
+#ifdef __linux__
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Reads a small /proc file in one read(); these are generated in a single pass.
+bool ReadProcFile(const std::string& path, char* buffer, size_t size, size_t& length) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    ssize_t count = read(fd, buffer, size - 1);
+    close(fd);
+    if (count <= 0) {
+        return false;
+    }
+    length = static_cast<size_t>(count);
+    buffer[length] = '\0';
+    return true;
+}
+
+bool ReadParentPid(pid_t pid, pid_t& ppid) {
+    char buffer[1024];
+    size_t length = 0;
+    if (!ReadProcFile("/proc/" + std::to_string(pid) + "/stat", buffer, sizeof(buffer), length)) {
+        return false;
+    }
+    // "pid (comm) state ppid ...": comm may contain spaces and parentheses.
+    const char* close = std::strrchr(buffer, ')');
+    if (!close || close + 4 >= buffer + length) {
+        return false;
+    }
+    ppid = static_cast<pid_t>(std::strtol(close + 4, nullptr, 10));
+    return true;
+}
+
+uint64_t ParseKb(const char* text, const char* key) {
+    const char* found = std::strstr(text, key);
+    return found ? std::strtoull(found + std::strlen(key), nullptr, 10) * 1024 : 0;
+}
+
+// Adds one process. Kernels before 4.14 have no smaps_rollup; they get RSS for all three.
+bool AddProcessMemory(pid_t pid, ProcessTreeMemory& memory) {
+    char buffer[4096];
+    size_t length = 0;
+    std::string dir = "/proc/" + std::to_string(pid);
+    if (ReadProcFile(dir + "/smaps_rollup", buffer, sizeof(buffer), length)) {
+        memory.rss += ParseKb(buffer, "\nRss:");
+        memory.pss += ParseKb(buffer, "\nPss:");
+        memory.uss += ParseKb(buffer, "\nPrivate_Clean:") + ParseKb(buffer, "\nPrivate_Dirty:");
+        ++memory.processes;
+        return true;
+    }
+    if (ReadProcFile(dir + "/statm", buffer, sizeof(buffer), length)) {
+        char* end = nullptr;
+        std::strtoull(buffer, &end, 10);
+        uint64_t rss = std::strtoull(end, nullptr, 10) * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+        memory.rss += rss;
+        memory.pss += rss;
+        memory.uss += rss;
+        ++memory.processes;
+        return true;
+    }
+    return false;
+}
+
+class ProcessTable {
+   public:
+    // Lists /proc (names only) and reads stat just for pids not seen before, plus the
+    // children of exited processes, which the kernel has reparented. A pid reused between
+    // two refreshes keeps its old parent; with pid_max in the millions that needs the
+    // counter to wrap between two samples.
+    void Refresh() {
+        DIR* dir = opendir("/proc");
+        if (!dir) {
+            return;
+        }
+        ++generation_;
+        while (dirent* entry = readdir(dir)) {
+            if (entry->d_name[0] < '0' || entry->d_name[0] > '9') {
+                continue;
+            }
+            pid_t pid = static_cast<pid_t>(std::strtol(entry->d_name, nullptr, 10));
+            auto it = parents_.find(pid);
+            if (it != parents_.end()) {
+                it->second.generation = generation_;
+                continue;
+            }
+            pid_t ppid = 0;
+            if (ReadParentPid(pid, ppid)) {
+                Link(pid, ppid);
+            }
+        }
+        closedir(dir);
+
+        std::vector<pid_t> orphans;
+        for (auto it = parents_.begin(); it != parents_.end();) {
+            if (it->second.generation == generation_) {
+                ++it;
+                continue;
+            }
+            Unlink(it->first, it->second.ppid);
+            auto children = children_.find(it->first);
+            if (children != children_.end()) {
+                orphans.insert(orphans.end(), children->second.begin(), children->second.end());
+                children_.erase(children);
+            }
+            it = parents_.erase(it);
+        }
+        for (pid_t orphan : orphans) {
+            auto it = parents_.find(orphan);
+            pid_t ppid = 0;
+            if (it != parents_.end() && ReadParentPid(orphan, ppid)) {
+                it->second.ppid = ppid;
+                children_[ppid].push_back(orphan);
+            }
+        }
+    }
+
+    // root and every descendant that was running at the last refresh.
+    void Collect(pid_t root, std::vector<pid_t>& pids) const {
+        pids.push_back(root);
+        for (size_t i = 0; i < pids.size(); ++i) {
+            auto children = children_.find(pids[i]);
+            if (children == children_.end()) {
+                continue;
+            }
+            for (pid_t child : children->second) {
+                if (child != root) {
+                    pids.push_back(child);
+                }
+            }
+        }
+    }
+
+   private:
+    struct Parent {
+        pid_t ppid = 0;
+        uint64_t generation = 0;
+    };
+
+    void Link(pid_t pid, pid_t ppid) {
+        parents_[pid] = Parent{ppid, generation_};
+        children_[ppid].push_back(pid);
+    }
+
+    void Unlink(pid_t pid, pid_t ppid) {
+        auto siblings = children_.find(ppid);
+        if (siblings == children_.end()) {
+            return;
+        }
+        auto& list = siblings->second;
+        list.erase(std::remove(list.begin(), list.end(), pid), list.end());
+        if (list.empty()) {
+            children_.erase(siblings);
+        }
+    }
+
+    uint64_t generation_ = 0;
+    std::unordered_map<pid_t, Parent> parents_;
+    std::unordered_map<pid_t, std::vector<pid_t>> children_;
+};
+
+std::mutex gTableMutex;
+
+// Leaked like the other process-wide caches; pool threads may still query during teardown.
+ProcessTable& SharedProcessTable() {
+    static ProcessTable* table = new ProcessTable();
+    return *table;
+}
+
+}  // namespace
+
+bool ReadProcessTreeMemory(unsigned long rootPid, ProcessTreeMemory& memory) {
+    if (rootPid == 0) {
+        return false;
+    }
+    std::vector<pid_t> pids;
+    {
+        std::lock_guard<std::mutex> lock(gTableMutex);
+        ProcessTable& table = SharedProcessTable();
+        table.Refresh();
+        table.Collect(static_cast<pid_t>(rootPid), pids);
+    }
+    // smaps_rollup walks the process's mappings in the kernel; read them unlocked.
+    memory = ProcessTreeMemory();
+    if (!AddProcessMemory(pids.front(), memory)) {
+        return false;
+    }
+    for (size_t i = 1; i < pids.size(); ++i) {
+        AddProcessMemory(pids[i], memory);
+    }
+    return true;
+}
+
+bool ListProcessTree(unsigned long rootPid, std::vector<int>& pids) {
+    pids.clear();
+    if (rootPid == 0 || access(("/proc/" + std::to_string(rootPid)).c_str(), F_OK) != 0) {
+        return false;
+    }
+    std::vector<pid_t> tree;
+    {
+        std::lock_guard<std::mutex> lock(gTableMutex);
+        ProcessTable& table = SharedProcessTable();
+        table.Refresh();
+        table.Collect(static_cast<pid_t>(rootPid), tree);
+    }
+    pids.assign(tree.begin(), tree.end());
+    return true;
+}
+
+#else
+
+bool ReadProcessTreeMemory(unsigned long, ProcessTreeMemory&) {
+    return false;
+}
+
+bool ListProcessTree(unsigned long, std::vector<int>& pids) {
+    pids.clear();
+    return false;
+}
+
+#endif  // __linux__
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "active_window.h"
+
+// Memory of a process and all of its descendants, which is what a multi-process app
+// (Chrome, Firefox, Electron) actually costs. Linux reads /proc/<pid>/smaps_rollup; the
+// pid -> children map behind it is cached process-wide and refreshed incrementally, so
+// only processes that appeared or exited since the last call touch their /proc entries.
+// Safe to call from any thread. Returns false when root is not running (or off Linux).
+bool ReadProcessTreeMemory(unsigned long rootPid, ProcessTreeMemory& memory);
+
+// root and every descendant, from the same cached table; root alone when it has none.
+// False when root is not running (or off Linux).
+bool ListProcessTree(unsigned long rootPid, std::vector<int>& pids);
@@ -0,0 +1,366 @@
+#include "sandbox_pids.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+#include "debug_log.h"
+#include "process_tree.h"
+
+namespace sandbox_pids {
+namespace {
+
+const size_t kMaxEntries = 256;
+// A sandbox can start after its window is first seen; a failed mapping is tried again.
+const int64_t kMissRetryMs = 5000;
+// Content and helper processes come and go while the instance runs.
+const int64_t kInstanceTtlMs = 5000;
+const int kMaxAncestors = 64;
+
+struct ProcStatus {
+    uid_t uid = static_cast<uid_t>(-1);
+    pid_t ppid = 0;
+    std::vector<pid_t> nspid;  // this /proc's namespace first, the process's own last
+};
+
+struct Mapping {
+    pid_t hostPid = 0;  // 0: no process matched
+    int64_t checkedMs = 0;
+};
+
+struct Instance {
+    std::string procsPath;  // cgroup.procs of a Flatpak or Snap scope
+    pid_t root = 0;         // else the outermost bubblewrap process
+    std::vector<int> pids;
+    int64_t refreshedMs = 0;
+};
+
+struct Membership {
+    std::string instance;  // empty outside a sandbox
+    int64_t checkedMs = 0;
+};
+
+struct State {
+    std::mutex mutex;
+    std::unordered_map<std::string, Mapping> windowPids;  // "pid\0hint"
+    std::unordered_map<pid_t, Membership> members;
+    std::unordered_map<std::string, Instance> instances;
+};
+
+State& SharedState() {
+    static State* state = new State();
+    return *state;
+}
+
+int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+std::string ToLower(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return value;
+}
+
+bool StartsWith(const char* text, const char* prefix) {
+    return std::strncmp(text, prefix, std::strlen(prefix)) == 0;
+}
+
+bool ReadSmallFile(const std::string& path, std::string& contents) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    contents.clear();
+    char buffer[4096];
+    ssize_t count;
+    while ((count = read(fd, buffer, sizeof(buffer))) > 0 && contents.size() < (1u << 20)) {
+        contents.append(buffer, static_cast<size_t>(count));
+    }
+    close(fd);
+    return count >= 0;
+}
+
+bool ReadStatus(pid_t pid, ProcStatus& status) {
+    std::string text;
+    if (!ReadSmallFile("/proc/" + std::to_string(pid) + "/status", text)) {
+        return false;
+    }
+    status = ProcStatus();
+    for (size_t line = 0; line < text.size();) {
+        const char* start = text.c_str() + line;
+        if (StartsWith(start, "Uid:")) {
+            status.uid = static_cast<uid_t>(std::strtoul(start + 4, nullptr, 10));
+        } else if (StartsWith(start, "PPid:")) {
+            status.ppid = static_cast<pid_t>(std::strtol(start + 5, nullptr, 10));
+        } else if (StartsWith(start, "NSpid:")) {
+            // Kernels before 4.1 have no NSpid; their processes look unsandboxed.
+            const char* cursor = start + 6;
+            char* next = nullptr;
+            while (true) {
+                long value = std::strtol(cursor, &next, 10);
+                if (next == cursor) {
+                    break;
+                }
+                status.nspid.push_back(static_cast<pid_t>(value));
+                cursor = next;
+            }
+        }
+        size_t end = text.find('\n', line);
+        line = end == std::string::npos ? text.size() : end + 1;
+    }
+    return status.uid != static_cast<uid_t>(-1);
+}
+
+std::string ReadComm(pid_t pid) {
+    std::string comm;
+    ReadSmallFile("/proc/" + std::to_string(pid) + "/comm", comm);
+    while (!comm.empty() && comm.back() == '\n') {
+        comm.pop_back();
+    }
+    return comm;
+}
+
+// The cgroup v2 path, else the systemd hierarchy's (v1 and hybrid systems); systemd puts
+// Flatpak and Snap instances in scopes there. procsRoots gets where to look for it.
+std::string ReadCgroupPath(pid_t pid, std::vector<std::string>& procsRoots) {
+    std::string text;
+    if (!ReadSmallFile("/proc/" + std::to_string(pid) + "/cgroup", text)) {
+        return std::string();
+    }
+    std::string systemdPath;
+    for (size_t line = 0; line < text.size();) {
+        size_t end = text.find('\n', line);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string entry = text.substr(line, end - line);
+        line = end + 1;
+        if (entry.compare(0, 3, "0::") == 0) {
+            procsRoots = {"/sys/fs/cgroup", "/sys/fs/cgroup/unified"};
+            return entry.substr(3);
+        }
+        size_t path = entry.find(":name=systemd:");
+        if (path != std::string::npos) {
+            systemdPath = entry.substr(path + 14);
+        }
+    }
+    procsRoots = {"/sys/fs/cgroup/systemd"};
+    return systemdPath;
+}
+
+// "app-flatpak-org.mozilla.firefox-12345.scope", "snap.firefox.firefox-<uuid>.scope".
+bool IsSandboxScope(const std::string& path) {
+    size_t slash = path.rfind('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    return name.compare(0, 12, "app-flatpak-") == 0 || name.compare(0, 5, "snap.") == 0;
+}
+
+bool MatchesHint(pid_t pid, const std::string& hint) {
+    std::string comm = ToLower(ReadComm(pid));
+    if (!comm.empty() && (comm.find(hint) != std::string::npos ||
+                          hint.find(comm) != std::string::npos)) {
+        return true;
+    }
+    std::vector<std::string> roots;
+    return ToLower(ReadCgroupPath(pid, roots)).find(hint) != std::string::npos;
+}
+
+// One pass over /proc for the processes of self whose own namespace calls them windowPid.
+pid_t FindNamespacedPid(pid_t windowPid, const std::string& appHint, uid_t self) {
+    DIR* dir = opendir("/proc");
+    if (!dir) {
+        return 0;
+    }
+    std::vector<pid_t> candidates;
+    size_t depth = 0;
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9') {
+            continue;
+        }
+        pid_t pid = static_cast<pid_t>(std::strtol(entry->d_name, nullptr, 10));
+        ProcStatus status;
+        if (!ReadStatus(pid, status) || status.uid != self || status.nspid.size() < 2 ||
+            status.nspid.back() != windowPid) {
+            continue;
+        }
+        // A nested namespace (a browser's own renderer sandbox) reuses the same low pids;
+        // the window belongs to the outermost one.
+        if (candidates.empty() || status.nspid.size() < depth) {
+            candidates.clear();
+            depth = status.nspid.size();
+        }
+        if (status.nspid.size() == depth) {
+            candidates.push_back(pid);
+        }
+    }
+    closedir(dir);
+
+    if (candidates.size() > 1 && !appHint.empty()) {
+        std::string hint = ToLower(appHint);
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                        [&](pid_t pid) { return !MatchesHint(pid, hint); }),
+                         candidates.end());
+    }
+    if (candidates.size() != 1) {
+        DebugLog("Window pid %d: %zu namespaced processes match", windowPid, candidates.size());
+        return 0;
+    }
+    return candidates.front();
+}
+
+bool StillMaps(pid_t hostPid, pid_t windowPid, uid_t self) {
+    ProcStatus status;
+    return ReadStatus(hostPid, status) && status.uid == self && status.nspid.size() > 1 &&
+           status.nspid.back() == windowPid;
+}
+
+// Where hostPid's instance lists its processes; false outside a sandbox.
+bool LocateInstance(pid_t hostPid, std::string& key, Instance& instance) {
+    std::vector<std::string> procsRoots;
+    std::string path = ReadCgroupPath(hostPid, procsRoots);
+    if (IsSandboxScope(path)) {
+        for (const std::string& root : procsRoots) {
+            std::string procs = root + path + "/cgroup.procs";
+            if (access(procs.c_str(), R_OK) == 0) {
+                key = path;
+                instance.procsPath = procs;
+                return true;
+            }
+        }
+    }
+
+    // No scope (Flatpak without systemd, plain bubblewrap): bwrap's outer process sits in
+    // this namespace above the sandbox, and Flatpak starts the D-Bus proxy below it too.
+    ProcStatus status;
+    if (!ReadStatus(hostPid, status) || status.nspid.size() < 2) {
+        return false;
+    }
+    pid_t current = status.ppid;
+    for (int i = 0; i < kMaxAncestors && current > 1; ++i) {
+        ProcStatus parent;
+        if (!ReadStatus(current, parent)) {
+            return false;
+        }
+        if (parent.nspid.size() < 2) {
+            key = "bwrap:" + std::to_string(current);
+            instance.root = current;
+            return true;
+        }
+        current = parent.ppid;
+    }
+    return false;
+}
+
+void RefreshInstance(Instance& instance) {
+    instance.pids.clear();
+    if (instance.procsPath.empty()) {
+        ListProcessTree(static_cast<unsigned long>(instance.root), instance.pids);
+        return;
+    }
+    std::string text;
+    if (!ReadSmallFile(instance.procsPath, text)) {
+        return;
+    }
+    const char* cursor = text.c_str();
+    char* next = nullptr;
+    while (true) {
+        long pid = std::strtol(cursor, &next, 10);
+        if (next == cursor) {
+            break;
+        }
+        instance.pids.push_back(static_cast<int>(pid));
+        cursor = next;
+    }
+}
+
+}  // namespace
+
+pid_t HostPid(pid_t windowPid, const std::string& appHint) {
+    if (windowPid <= 0) {
+        return windowPid;
+    }
+    uid_t self = getuid();
+    ProcStatus status;
+    if (ReadStatus(windowPid, status) && status.uid == self) {
+        return windowPid;
+    }
+
+    State& state = SharedState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    std::string key = std::to_string(windowPid);
+    key.append(1, '\0').append(appHint);
+    int64_t now = NowMs();
+    auto cached = state.windowPids.find(key);
+    if (cached != state.windowPids.end()) {
+        const Mapping& mapping = cached->second;
+        if (mapping.hostPid == 0 && now - mapping.checkedMs < kMissRetryMs) {
+            return windowPid;
+        }
+        if (mapping.hostPid != 0 && StillMaps(mapping.hostPid, windowPid, self)) {
+            return mapping.hostPid;
+        }
+    }
+
+    pid_t hostPid = FindNamespacedPid(windowPid, appHint, self);
+    if (state.windowPids.size() >= kMaxEntries) {
+        state.windowPids.clear();
+    }
+    state.windowPids[key] = Mapping{hostPid, now};
+    if (hostPid == 0) {
+        return windowPid;
+    }
+    DebugLog("Window pid %d is pid %d outside its namespace", windowPid, hostPid);
+    return hostPid;
+}
+
+std::vector<int> InstancePids(pid_t hostPid) {
+    std::vector<int> pids = {static_cast<int>(hostPid)};
+    if (hostPid <= 0) {
+        return pids;
+    }
+    State& state = SharedState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    int64_t now = NowMs();
+    auto member = state.members.find(hostPid);
+    if (member == state.members.end() || now - member->second.checkedMs >= kInstanceTtlMs) {
+        if (state.members.size() >= kMaxEntries) {
+            state.members.clear();
+            state.instances.clear();
+        }
+        std::string key;
+        Instance located;
+        if (LocateInstance(hostPid, key, located)) {
+            state.instances.emplace(key, std::move(located));
+        }
+        member = state.members.insert_or_assign(hostPid, Membership{key, now}).first;
+    }
+    if (member->second.instance.empty()) {
+        return pids;
+    }
+
+    Instance& instance = state.instances[member->second.instance];
+    if (now - instance.refreshedMs >= kInstanceTtlMs) {
+        RefreshInstance(instance);
+        instance.refreshedMs = now;
+    }
+    for (int pid : instance.pids) {
+        if (pid != hostPid) {
+            pids.push_back(pid);
+        }
+    }
+    return pids;
+}
+
+}  // namespace sandbox_pids
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+// Pids of sandboxed applications (Flatpak, Snap, anything under bubblewrap). A client in
+// its own pid namespace writes its namespace-local pid into _NET_WM_PID, and AT-SPI names
+// an application by the pid on its bus connection, which for Flatpak is the sandbox's
+// D-Bus proxy; neither is the host pid of the window's process. Safe to call from any
+// thread.
+namespace sandbox_pids {
+
+// The host pid of the window's process. windowPid itself when it names a process of this
+// user; otherwise the process of this user whose innermost NSpid is windowPid, preferring
+// the least nested, with appHint (the window's WM_CLASS) picking by process name or
+// Flatpak/Snap scope when several sandboxes have one. windowPid when nothing matches.
+// Mappings are cached and revalidated with one /proc read.
+pid_t HostPid(pid_t windowPid, const std::string& appHint);
+
+// Every pid of hostPid's sandbox instance, hostPid first: its Flatpak or Snap cgroup scope,
+// else the tree under the outermost bubblewrap process above it. Just hostPid outside a
+// sandbox. Cached per instance for a few seconds.
+std::vector<int> InstancePids(pid_t hostPid);
+
+}  // namespace sandbox_pids
@@ -0,0 +1,231 @@
+#include "synthetic_tree.h"
+
+#include <chrono>
+#include <deque>
+
+namespace {
+
+const uint32_t kAddressBarStates = kStateEditable | kStateFocusable | kStateEnabled | kStateShowing;
+
+void Spin(uint32_t micros) {
+    if (micros == 0) {
+        return;
+    }
+    auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(micros);
+    while (std::chrono::steady_clock::now() < until) {
+    }
+}
+
+}  // namespace
+
+bool ParseSyntheticShape(const std::string& name, SyntheticShape& shape) {
+    if (name == "chromium" || name == "chrome") {
+        shape = SyntheticShape::Chromium;
+        return true;
+    }
+    if (name == "firefox") {
+        shape = SyntheticShape::Firefox;
+        return true;
+    }
+    return false;
+}
+
+SyntheticTree::SyntheticTree(const SyntheticTreeOptions& options) : options_(options) {
+    nodes_.reserve(options_.nodes + 1 +
+                   static_cast<size_t>(options_.unrelatedApps) * options_.nodesPerUnrelatedApp);
+    int32_t desktop = Add(-1, AccessibleRole::Other, 1, "main");
+    for (int i = 0; i < options_.unrelatedApps; ++i) {
+        int pid = 1000 + i;
+        int32_t app = Add(desktop, AccessibleRole::Application, pid, "app-" + std::to_string(i));
+        if (options_.nodesPerUnrelatedApp > 1) {
+            AddFiller(app, pid, options_.nodesPerUnrelatedApp - 1, 4);
+        }
+    }
+    BuildBrowser(desktop);
+}
+
+const char* SyntheticTree::processName() const {
+    return options_.shape == SyntheticShape::Firefox ? "firefox" : "chromium";
+}
+
+int32_t SyntheticTree::Add(int32_t parent, AccessibleRole role, int pid,
+                           const std::string& name) {
+    int32_t index = static_cast<int32_t>(nodes_.size());
+    nodes_.emplace_back();
+    SynthNode& node = nodes_.back();
+    node.role = role;
+    node.states = kStateEnabled | kStateShowing;
+    node.pid = pid;
+    node.parent = parent;
+    node.name = name;
+    if (parent >= 0) {
+        nodes_[static_cast<size_t>(parent)].children.push_back(index);
+    }
+    return index;
+}
+
+// Level-order fill, so every level is complete before the next one starts: the same
+// breadth the BFS searches have to get through on a real page.
+void SyntheticTree::AddFiller(int32_t root, int pid, size_t count, int fanout) {
+    static const AccessibleRole kRoles[] = {AccessibleRole::Panel, AccessibleRole::Text,
+                                            AccessibleRole::Other, AccessibleRole::Other};
+    std::deque<int32_t> parents = {root};
+    size_t added = 0;
+    while (added < count && !parents.empty()) {
+        int32_t parent = parents.front();
+        parents.pop_front();
+        for (int i = 0; i < fanout && added < count; ++i, ++added) {
+            AccessibleRole role = kRoles[added % 4];
+            int32_t child = Add(parent, role, pid, role == AccessibleRole::Text ? "" : "item");
+            if (role == AccessibleRole::Text) {
+                nodes_[static_cast<size_t>(child)].hasText = true;
+                nodes_[static_cast<size_t>(child)].text = "Lorem ipsum dolor sit amet.";
+            }
+            parents.push_back(child);
+        }
+    }
+}
+
+void SyntheticTree::BuildBrowser(int32_t desktop) {
+    const bool firefox = options_.shape == SyntheticShape::Firefox;
+    const int pid = options_.browserPid;
+    const int depth =
+        options_.addressBarDepth > 1 ? options_.addressBarDepth : (firefox ? 7 : 9);
+    windowTitle_ = firefox ? "Synthetic page — Mozilla Firefox" : "Synthetic page - Chromium";
+
+    int32_t app = Add(desktop, AccessibleRole::Application, pid, processName());
+    int32_t frame = Add(app, AccessibleRole::Frame, pid, windowTitle_);
+    nodes_[static_cast<size_t>(frame)].states |= kStateActive;
+
+    // Chromium lists the web view before the browser chrome; Firefox the other way round.
+    int32_t contentRoot = -1;
+    if (!firefox) {
+        contentRoot = Add(frame, AccessibleRole::Panel, pid, "");
+    }
+
+    int32_t parent = frame;
+    for (int level = 2; level < depth - 1; ++level) {
+        Add(parent, AccessibleRole::Other, pid, "button");
+        parent = Add(parent, AccessibleRole::Panel, pid, "");
+    }
+    int32_t toolbar = Add(parent, AccessibleRole::ToolBar, pid, firefox ? "Navigation" : "");
+    Add(toolbar, AccessibleRole::Other, pid, "Back");
+    Add(toolbar, AccessibleRole::Other, pid, "Reload");
+    int32_t entry = Add(toolbar, AccessibleRole::Entry, pid,
+                        firefox ? "Search with Google or enter address" : "Address and search bar");
+    SynthNode& bar = nodes_[static_cast<size_t>(entry)];
+    bar.states = kAddressBarStates;
+    bar.hasText = true;
+    bar.text = options_.url;
+
+    if (firefox) {
+        contentRoot = Add(frame, AccessibleRole::Panel, pid, "");
+    }
+    // A background tab first: present in the tree but not showing.
+    int32_t hidden = Add(contentRoot, AccessibleRole::DocumentWeb, pid, "Background tab");
+    nodes_[static_cast<size_t>(hidden)].states = kStateEnabled;
+    nodes_[static_cast<size_t>(hidden)].documentUrl = "https://example.org/background";
+    int32_t document = Add(contentRoot, AccessibleRole::DocumentWeb, pid, "Synthetic page");
+    nodes_[static_cast<size_t>(document)].documentUrl = options_.url;
+    // An in-page search box that scores but does not hold a URL.
+    int32_t search = Add(document, AccessibleRole::Entry, pid, "Search");
+    nodes_[static_cast<size_t>(search)].states = kAddressBarStates;
+    nodes_[static_cast<size_t>(search)].hasText = true;
+    nodes_[static_cast<size_t>(search)].text = "search terms";
+
+    // nodes_ also holds the desktop and the unrelated applications.
+    size_t browserNodes = nodes_.size() - static_cast<size_t>(app);
+    if (options_.nodes > browserNodes) {
+        AddFiller(document, pid, options_.nodes - browserNodes, firefox ? 6 : 3);
+    }
+}
+
+const SyntheticTree::SynthNode* SyntheticTree::Lookup(Node node) {
+    Spin(options_.latencyUs);
+    uintptr_t handle = reinterpret_cast<uintptr_t>(node);
+    if (handle == 0 || handle > nodes_.size()) {
+        return nullptr;
+    }
+    return &nodes_[handle - 1];
+}
+
+AccessibleTree::Node SyntheticTree::Handle(int32_t index) const {
+    if (index < 0) {
+        return nullptr;
+    }
+    return reinterpret_cast<Node>(static_cast<uintptr_t>(index) + 1);
+}
+
+int SyntheticTree::DoDesktopCount() {
+    Spin(options_.latencyUs);
+    return 1;
+}
+
+AccessibleTree::Node SyntheticTree::DoDesktop(int index) {
+    Spin(options_.latencyUs);
+    return index == 0 ? Handle(0) : nullptr;
+}
+
+AccessibleRole SyntheticTree::DoRole(Node node) {
+    const SynthNode* entry = Lookup(node);
+    return entry ? entry->role : AccessibleRole::Other;
+}
+
+bool SyntheticTree::DoStates(Node node, uint32_t& states) {
+    const SynthNode* entry = Lookup(node);
+    if (!entry) {
+        return false;
+    }
+    states = entry->states;
+    return true;
+}
+
+std::string SyntheticTree::DoName(Node node) {
+    const SynthNode* entry = Lookup(node);
+    return entry ? entry->name : std::string();
+}
+
+AccessibleTree::Node SyntheticTree::DoParent(Node node) {
+    const SynthNode* entry = Lookup(node);
+    return entry ? Handle(entry->parent) : nullptr;
+}
+
+int SyntheticTree::DoChildCount(Node node) {
+    const SynthNode* entry = Lookup(node);
+    return entry ? static_cast<int>(entry->children.size()) : 0;
+}
+
+AccessibleTree::Node SyntheticTree::DoChildAt(Node node, int index) {
+    const SynthNode* entry = Lookup(node);
+    if (!entry || index < 0 || static_cast<size_t>(index) >= entry->children.size()) {
+        return nullptr;
+    }
+    return Handle(entry->children[static_cast<size_t>(index)]);
+}
+
+int SyntheticTree::DoProcessId(Node node) {
+    const SynthNode* entry = Lookup(node);
+    return entry ? entry->pid : -1;
+}
+
+bool SyntheticTree::DoText(Node node, std::string& value) {
+    const SynthNode* entry = Lookup(node);
+    if (!entry || !entry->hasText) {
+        return false;
+    }
+    value = entry->text;
+    return true;
+}
+
+bool SyntheticTree::DoDocumentAttribute(Node node, const std::string& name, std::string& value) {
+    const SynthNode* entry = Lookup(node);
+    if (!entry || entry->role != AccessibleRole::DocumentWeb || !options_.exposeDocumentUrl) {
+        return false;
+    }
+    const char* attribute = options_.shape == SyntheticShape::Firefox ? "DocURL" : "URI";
+    if (name != attribute) {
+        return false;
+    }
+    value = entry->documentUrl;
+    return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "accessible_tree.h"
+
+enum class SyntheticShape { Chromium, Firefox };
+
+bool ParseSyntheticShape(const std::string& name, SyntheticShape& shape);
+
+struct SyntheticTreeOptions {
+    SyntheticShape shape = SyntheticShape::Chromium;
+    // Nodes in the browser application, address bar and toolbars included.
+    size_t nodes = 10000;
+    // Unrelated applications listed before the browser on the desktop, and their size.
+    int unrelatedApps = 4;
+    size_t nodesPerUnrelatedApp = 500;
+    // Depth of the address-bar entry below the browser application node; 0 picks the
+    // shape's default.
+    int addressBarDepth = 0;
+    // Busy-waited on every call except Ref/Unref, to stand in for a D-Bus round trip.
+    uint32_t latencyUs = 0;
+    int browserPid = 4242;
+    std::string url = "https://example.com/synthetic";
+    // Answer the Document URL attribute ("DocURL" for Firefox, "URI" for Chromium).
+    bool exposeDocumentUrl = true;
+};
+
+// In-memory AccessibleTree with a single desktop, shaped after what the Chromium and
+// Firefox bridges expose: a browser frame with a toolbar chain down to the address bar
+// next to a large web document. Refcounts are not tracked; the tree owns every node.
+class SyntheticTree : public AccessibleTree {
+   public:
+    explicit SyntheticTree(const SyntheticTreeOptions& options);
+
+    size_t size() const { return nodes_.size(); }
+    int browserPid() const { return options_.browserPid; }
+    const std::string& windowTitle() const { return windowTitle_; }
+    const char* processName() const;
+
+   protected:
+    Node DoRef(Node node) override { return node; }
+    void DoUnref(Node) override {}
+    int DoDesktopCount() override;
+    Node DoDesktop(int index) override;
+    AccessibleRole DoRole(Node node) override;
+    bool DoStates(Node node, uint32_t& states) override;
+    std::string DoName(Node node) override;
+    Node DoParent(Node node) override;
+    int DoChildCount(Node node) override;
+    Node DoChildAt(Node node, int index) override;
+    int DoProcessId(Node node) override;
+    bool DoText(Node node, std::string& value) override;
+    bool DoDocumentAttribute(Node node, const std::string& name, std::string& value) override;
+
+   private:
+    struct SynthNode {
+        AccessibleRole role = AccessibleRole::Other;
+        uint32_t states = 0;
+        int pid = 0;
+        int32_t parent = -1;
+        std::string name;
+        std::string text;
+        bool hasText = false;
+        std::string documentUrl;
+        std::vector<int32_t> children;
+    };
+
+    int32_t Add(int32_t parent, AccessibleRole role, int pid, const std::string& name);
+    void AddFiller(int32_t root, int pid, size_t count, int fanout);
+    void BuildBrowser(int32_t desktop);
+    const SynthNode* Lookup(Node node);
+    Node Handle(int32_t index) const;
+
+    SyntheticTreeOptions options_;
+    std::vector<SynthNode> nodes_;
+    std::string windowTitle_;
+};
@@ -0,0 +1,170 @@
+#include "title_index.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include "debug_log.h"
+
+namespace {
+
+std::string ToLower(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return value;
+}
+
+bool TitlesMatch(const std::string& name, const std::string& title) {
+    return !name.empty() &&
+           (name.find(title) != std::string::npos || title.find(name) != std::string::npos);
+}
+
+}  // namespace
+
+TitleIndex::~TitleIndex() {
+    Clear();
+}
+
+size_t TitleIndex::Seed() {
+    int desktopCount = tree_.DesktopCount();
+    for (int desktopIndex = 0; desktopIndex < desktopCount; ++desktopIndex) {
+        NodeRef desktop(&tree_, tree_.Desktop(desktopIndex));
+        if (!desktop) {
+            continue;
+        }
+        int appCount = tree_.ChildCount(desktop.get());
+        for (int i = 0; i < appCount; ++i) {
+            NodeRef app(&tree_, tree_.ChildAt(desktop.get(), i));
+            if (!app) {
+                continue;
+            }
+            int windowCount = tree_.ChildCount(app.get());
+            for (int j = 0; j < windowCount; ++j) {
+                NodeRef window(&tree_, tree_.ChildAt(app.get(), j));
+                if (window) {
+                    Put(window.get());
+                }
+            }
+        }
+    }
+    DebugLog("Title index seeded with %zu windows", byWindow_.size());
+    return byWindow_.size();
+}
+
+void TitleIndex::Put(AccessibleTree::Node window) {
+    if (!window) {
+        return;
+    }
+    if (Contains(window)) {
+        Rename(window);
+        return;
+    }
+    std::string name = ToLower(tree_.Name(window));
+    byWindow_.emplace(tree_.Ref(window), name);
+    byName_[name].push_back(window);
+}
+
+void TitleIndex::Rename(AccessibleTree::Node window) {
+    auto it = byWindow_.find(window);
+    if (it == byWindow_.end()) {
+        return;
+    }
+    std::string name = ToLower(tree_.Name(window));
+    if (name == it->second) {
+        return;
+    }
+    Unlink(window, it->second);
+    it->second = name;
+    byName_[name].push_back(window);
+}
+
+void TitleIndex::Remove(AccessibleTree::Node window) {
+    auto it = byWindow_.find(window);
+    if (it == byWindow_.end()) {
+        return;
+    }
+    Unlink(window, it->second);
+    byWindow_.erase(it);
+    tree_.Unref(window);
+}
+
+void TitleIndex::Clear() {
+    for (const auto& entry : byWindow_) {
+        tree_.Unref(entry.first);
+    }
+    byWindow_.clear();
+    byName_.clear();
+}
+
+void TitleIndex::Unlink(AccessibleTree::Node window, const std::string& name) {
+    auto it = byName_.find(name);
+    if (it == byName_.end()) {
+        return;
+    }
+    auto& windows = it->second;
+    windows.erase(std::remove(windows.begin(), windows.end(), window), windows.end());
+    if (windows.empty()) {
+        byName_.erase(it);
+    }
+}
+
+// A missed destroy or rename event leaves a stale entry behind; re-read the name before
+// handing a window out and drop or re-key it when it changed.
+bool TitleIndex::Confirm(AccessibleTree::Node window, const std::string& name,
+                         const std::string& title) {
+    std::string current = ToLower(tree_.Name(window));
+    if (current == name) {
+        return true;
+    }
+    if (current.empty() && tree_.ProcessId(window) <= 0) {
+        DebugLog("Dropping defunct window '%s' from title index", name.c_str());
+        Remove(window);
+        return false;
+    }
+    auto it = byWindow_.find(window);
+    Unlink(window, it->second);
+    it->second = current;
+    byName_[current].push_back(window);
+    // The window was renamed since it was indexed; the new name may still be the one asked
+    // for, and then a miss here would cost a desktop scan.
+    return TitlesMatch(current, title);
+}
+
+NodeRef TitleIndex::Find(const std::string& windowTitle) {
+    std::string title = ToLower(windowTitle);
+    if (title.empty()) {
+        return NodeRef();
+    }
+    if (!started_) {
+        started_ = true;
+        live_ = !watch_ || watch_(*this);
+        if (!live_) {
+            DebugLog("No window events for the title index; rescanning on every lookup");
+        }
+        Seed();
+    } else if (!live_) {
+        Clear();
+        Seed();
+    }
+
+    std::vector<std::pair<AccessibleTree::Node, std::string>> candidates;
+    auto exact = byName_.find(title);
+    if (exact != byName_.end()) {
+        for (AccessibleTree::Node window : exact->second) {
+            candidates.emplace_back(window, title);
+        }
+    }
+    for (const auto& entry : byWindow_) {
+        if (entry.second != title && TitlesMatch(entry.second, title)) {
+            candidates.emplace_back(entry.first, entry.second);
+        }
+    }
+
+    for (const auto& candidate : candidates) {
+        if (Confirm(candidate.first, candidate.second, title)) {
+            DebugLog("Found accessibility window by indexed title match: '%s'",
+                     candidate.second.c_str());
+            return NodeRef(&tree_, tree_.Ref(candidate.first));
+        }
+    }
+    return NodeRef();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "accessible_tree.h"
+
+// Top-level accessible windows keyed by lowercased name, so the title fallback of the URL
+// lookup is an in-memory probe instead of a desktop-wide walk. The first Find() calls watch
+// (which should start feeding window create/destroy/rename events into Put, Remove and
+// Rename) and then seeds the index with one walk. Without a working watch every Find()
+// rescans. Holds one reference per window. Not thread-safe.
+class TitleIndex {
+   public:
+    using Watch = std::function<bool(TitleIndex&)>;
+
+    explicit TitleIndex(AccessibleTree& tree, Watch watch = nullptr)
+        : tree_(tree), watch_(std::move(watch)) {}
+    ~TitleIndex();
+
+    TitleIndex(const TitleIndex&) = delete;
+    TitleIndex& operator=(const TitleIndex&) = delete;
+
+    // Indexes the children of every application on every desktop; returns the count.
+    size_t Seed();
+    void Put(AccessibleTree::Node window);
+    void Rename(AccessibleTree::Node window);
+    void Remove(AccessibleTree::Node window);
+    void Clear();
+
+    bool Contains(AccessibleTree::Node window) const { return byWindow_.count(window) != 0; }
+    size_t size() const { return byWindow_.size(); }
+
+    // Exact name match first, then the same contains/contained-in rule as
+    // FindAccessibleByTitle. Entries whose accessible no longer answers are dropped.
+    NodeRef Find(const std::string& windowTitle);
+
+   private:
+    void Unlink(AccessibleTree::Node window, const std::string& name);
+    // True when window, indexed under name, still matches title. Re-keys it when renamed.
+    bool Confirm(AccessibleTree::Node window, const std::string& name, const std::string& title);
+
+    AccessibleTree& tree_;
+    Watch watch_;
+    bool started_ = false;
+    bool live_ = false;
+    std::unordered_map<AccessibleTree::Node, std::string> byWindow_;
+    std::unordered_map<std::string, std::vector<AccessibleTree::Node>> byName_;
+};
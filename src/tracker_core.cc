@@ -0,0 +1,234 @@
+#include "tracker_core.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "debug_log.h"
+#include "idle_monitor.h"
+
+namespace {
+
+template <typename Event>
+class Fanout {
+   public:
+    using Listener = std::function<void(const Event&)>;
+
+    uint64_t Add(Listener listener) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t id = ++lastId_;
+        listeners_.emplace(id, std::move(listener));
+        return id;
+    }
+
+    // True when id was subscribed.
+    bool Remove(uint64_t id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return listeners_.erase(id) != 0;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return listeners_.size();
+    }
+
+    void Emit(const Event& event) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& entry : listeners_) {
+            if (entry.second) {
+                entry.second(event);
+            }
+        }
+    }
+
+   private:
+    std::mutex mutex_;
+    std::map<uint64_t, Listener> listeners_;
+    uint64_t lastId_ = 0;
+};
+
+struct WindowResult {
+    bool ok = false;
+    ActiveWindowInfo info;
+};
+
+// Leaked like ThreadPool::Shared(): source threads may still emit during static teardown.
+template <typename Event>
+Fanout<Event>& SharedFanout() {
+    static Fanout<Event>* fanout = new Fanout<Event>();
+    return *fanout;
+}
+
+// Serializes starting and stopping each source against its subscriber count. Never held
+// while emitting, so a source can be stopped while it is delivering.
+std::mutex gIdleLifecycle;
+std::mutex gGeometryLifecycle;
+std::mutex gActivityLifecycle;
+std::mutex gPollerLifecycle;
+
+const uint32_t kMinPollIntervalMs = 100;
+
+// One poller run. The thread is detached so unsubscribing never waits for a slow AT-SPI
+// lookup; a run that was stopped mid-query just drops its result.
+struct PollerRun {
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<uint32_t> intervalMs{1000};
+    bool stopping = false;
+};
+
+std::shared_ptr<PollerRun> gPoller;
+std::map<uint64_t, uint32_t> gPollIntervals;
+
+void PollerMain(std::shared_ptr<PollerRun> run) {
+    bool wasAway = false;
+    while (true) {
+        // Nobody is looking while the user is away: subscribers get null once, then nothing
+        // until they are back.
+        bool away = idle_monitor::IsAway();
+        WindowResult result;
+        if (!away) {
+            result.ok = GetActiveWindowInfo(result.info);
+        }
+        {
+            std::unique_lock<std::mutex> lock(run->mutex);
+            if (run->stopping) {
+                return;
+            }
+        }
+        if (!away || !wasAway) {
+            SharedFanout<WindowResult>().Emit(result);
+        }
+        wasAway = away;
+
+        std::unique_lock<std::mutex> lock(run->mutex);
+        run->wake.wait_for(lock, std::chrono::milliseconds(run->intervalMs.load()),
+                           [&run]() { return run->stopping; });
+        if (run->stopping) {
+            return;
+        }
+    }
+}
+
+void UpdatePollInterval() {
+    uint32_t interval = UINT32_MAX;
+    for (const auto& entry : gPollIntervals) {
+        interval = std::min(interval, entry.second);
+    }
+    if (gPoller && interval != UINT32_MAX) {
+        gPoller->intervalMs.store(interval);
+    }
+}
+
+}  // namespace
+
+namespace tracker_core {
+
+uint64_t SubscribeActiveWindow(uint32_t intervalMs, WindowListener listener) {
+    std::lock_guard<std::mutex> lifecycle(gPollerLifecycle);
+    uint64_t id = SharedFanout<WindowResult>().Add(
+        [listener = std::move(listener)](const WindowResult& result) {
+            listener(result.ok, result.info);
+        });
+    gPollIntervals[id] = std::max(intervalMs, kMinPollIntervalMs);
+    if (!gPoller) {
+        gPoller = std::make_shared<PollerRun>();
+        UpdatePollInterval();
+        std::thread(PollerMain, gPoller).detach();
+        DebugLog("Active window poller started (%u ms)", gPoller->intervalMs.load());
+    } else {
+        UpdatePollInterval();
+    }
+    return id;
+}
+
+void UnsubscribeActiveWindow(uint64_t id) {
+    std::lock_guard<std::mutex> lifecycle(gPollerLifecycle);
+    if (!SharedFanout<WindowResult>().Remove(id)) {
+        return;
+    }
+    gPollIntervals.erase(id);
+    if (!gPollIntervals.empty()) {
+        UpdatePollInterval();
+        return;
+    }
+    if (gPoller) {
+        {
+            std::lock_guard<std::mutex> lock(gPoller->mutex);
+            gPoller->stopping = true;
+        }
+        gPoller->wake.notify_all();
+        gPoller.reset();
+        DebugLog("Active window poller stopped");
+    }
+}
+
+uint64_t SubscribeIdle(uint64_t idleThresholdMs, idle_monitor::Listener listener) {
+    std::lock_guard<std::mutex> lifecycle(gIdleLifecycle);
+    Fanout<IdleState>& fanout = SharedFanout<IdleState>();
+    uint64_t id = fanout.Add(std::move(listener));
+    if (fanout.size() == 1 &&
+        !idle_monitor::Start(idleThresholdMs,
+                             [](const IdleState& state) { SharedFanout<IdleState>().Emit(state); })) {
+        fanout.Remove(id);
+        return 0;
+    }
+    return id;
+}
+
+void UnsubscribeIdle(uint64_t id) {
+    std::lock_guard<std::mutex> lifecycle(gIdleLifecycle);
+    Fanout<IdleState>& fanout = SharedFanout<IdleState>();
+    if (fanout.Remove(id) && fanout.size() == 0) {
+        idle_monitor::Stop();
+    }
+}
+
+uint64_t SubscribeGeometry(geometry_tracker::Listener listener) {
+    std::lock_guard<std::mutex> lifecycle(gGeometryLifecycle);
+    Fanout<GeometryUpdate>& fanout = SharedFanout<GeometryUpdate>();
+    uint64_t id = fanout.Add(std::move(listener));
+    if (fanout.size() == 1 && !geometry_tracker::Start([](const GeometryUpdate& update) {
+            SharedFanout<GeometryUpdate>().Emit(update);
+        })) {
+        fanout.Remove(id);
+        return 0;
+    }
+    return id;
+}
+
+void UnsubscribeGeometry(uint64_t id) {
+    std::lock_guard<std::mutex> lifecycle(gGeometryLifecycle);
+    Fanout<GeometryUpdate>& fanout = SharedFanout<GeometryUpdate>();
+    if (fanout.Remove(id) && fanout.size() == 0) {
+        geometry_tracker::Stop();
+    }
+}
+
+uint64_t SubscribeActivity(uint32_t intervalMs, activity_tracker::Listener listener) {
+    std::lock_guard<std::mutex> lifecycle(gActivityLifecycle);
+    Fanout<ActivitySample>& fanout = SharedFanout<ActivitySample>();
+    uint64_t id = fanout.Add(std::move(listener));
+    if (fanout.size() == 1 && !activity_tracker::Start(intervalMs, [](const ActivitySample& sample) {
+            SharedFanout<ActivitySample>().Emit(sample);
+        })) {
+        fanout.Remove(id);
+        return 0;
+    }
+    return id;
+}
+
+void UnsubscribeActivity(uint64_t id) {
+    std::lock_guard<std::mutex> lifecycle(gActivityLifecycle);
+    Fanout<ActivitySample>& fanout = SharedFanout<ActivitySample>();
+    if (fanout.Remove(id) && fanout.size() == 0) {
+        activity_tracker::Stop();
+    }
+}
+
+}  // namespace tracker_core
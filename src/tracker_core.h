@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "active_window.h"
+#include "activity_tracker.h"
+#include "geometry_tracker.h"
+#include "idle_monitor.h"
+
+// Process-wide state shared by every JS environment the addon is loaded into (main thread,
+// worker_threads, Electron utility processes hosting several contexts). Each source runs
+// once per process while it has subscribers and fans its results out to all of them, so
+// N environments cost one X11/AT-SPI poll, not N.
+//
+// Listeners run on the source's thread while a subscription lock is held: they must hand
+// the data off (e.g. a non-blocking ThreadSafeFunction call) and must not subscribe or
+// unsubscribe. Once Unsubscribe* returns, the listener is never called again.
+namespace tracker_core {
+
+using WindowListener = std::function<void(bool ok, const ActiveWindowInfo& info)>;
+
+// Polls the active window every intervalMs (the shortest interval among subscribers
+// wins) and hands each result to every subscriber. Returns 0 if the poller cannot start.
+uint64_t SubscribeActiveWindow(uint32_t intervalMs, WindowListener listener);
+void UnsubscribeActiveWindow(uint64_t id);
+
+// The idle monitor starts with the first subscriber's threshold and stops with the last
+// subscriber. Empty listeners just keep the monitor (and IsAway) running.
+uint64_t SubscribeIdle(uint64_t idleThresholdMs, idle_monitor::Listener listener);
+void UnsubscribeIdle(uint64_t id);
+
+uint64_t SubscribeGeometry(geometry_tracker::Listener listener);
+void UnsubscribeGeometry(uint64_t id);
+
+// Like the idle monitor, activity tracking runs with the first subscriber's interval.
+uint64_t SubscribeActivity(uint32_t intervalMs, activity_tracker::Listener listener);
+void UnsubscribeActivity(uint64_t id);
+
+}  // namespace tracker_core
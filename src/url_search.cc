@@ -0,0 +1,687 @@
+#include "url_search.h"
+
+#include <algorithm>
+#include <cctype>
+#include <deque>
+
+#include "app_breaker.h"
+#include "debug_log.h"
+#include "lookup_probes.h"
+#include "title_index.h"
+#include "window_frames.h"
+
+namespace {
+
+std::string ToLower(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return value;
+}
+
+std::string Trim(const std::string& value) {
+    const std::string whitespace = " \t\n\r";
+    size_t start = value.find_first_not_of(whitespace);
+    if (start == std::string::npos) {
+        return std::string();
+    }
+    size_t end = value.find_last_not_of(whitespace);
+    return value.substr(start, end - start + 1);
+}
+
+bool StartsWithIgnoreCase(const std::string& value, const std::string& prefix) {
+    if (value.size() < prefix.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < prefix.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(value[i])) !=
+            std::tolower(static_cast<unsigned char>(prefix[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Bounds a walk to the calls made before the tree's first timeout.
+class TimeoutWatch {
+   public:
+    explicit TimeoutWatch(const AccessibleTree& tree)
+        : tree_(tree), timeouts_(tree.stats().timeouts) {}
+    bool fired() const { return tree_.stats().timeouts != timeouts_; }
+
+   private:
+    const AccessibleTree& tree_;
+    uint64_t timeouts_;
+};
+
+// Skips apps that are backing off, and records how the search of each app went.
+template <typename Search>
+NodeRef SearchApplication(AccessibleTree& tree, AccessibleTree::Node app,
+                          AppCircuitBreaker* breaker, UrlSearchStats* stats, Search search) {
+    if (!breaker) {
+        return search();
+    }
+    std::string id = tree.ApplicationId(app);
+    if (!breaker->Allow(id)) {
+        if (stats) {
+            ++stats->appsSkipped;
+        }
+        return NodeRef();
+    }
+    TimeoutWatch watch(tree);
+    NodeRef match = search();
+    if (watch.fired()) {
+        breaker->RecordTimeout(id);
+    } else {
+        breaker->RecordSuccess(id);
+    }
+    return match;
+}
+
+// Intersection over union; 0 when either is empty.
+double Overlap(const AccessibleRect& a, const AccessibleRect& b) {
+    long left = std::max(a.x, b.x);
+    long top = std::max(a.y, b.y);
+    long right = std::min(a.x + a.width, b.x + b.width);
+    long bottom = std::min(a.y + a.height, b.y + b.height);
+    if (a.width <= 0 || a.height <= 0 || b.width <= 0 || b.height <= 0 || right <= left ||
+        bottom <= top) {
+        return 0.0;
+    }
+    double shared = static_cast<double>(right - left) * static_cast<double>(bottom - top);
+    double total = static_cast<double>(a.width) * a.height +
+                   static_cast<double>(b.width) * b.height - shared;
+    return shared / total;
+}
+
+// 2 for the same name, 1 when one contains the other, 0 otherwise.
+int TitleScore(const std::string& name, const std::string& lowerTitle) {
+    if (name.empty() || lowerTitle.empty()) {
+        return 0;
+    }
+    std::string lowerName = ToLower(name);
+    if (lowerName == lowerTitle) {
+        return 2;
+    }
+    return lowerName.find(lowerTitle) != std::string::npos ||
+                   lowerTitle.find(lowerName) != std::string::npos
+               ? 1
+               : 0;
+}
+
+bool ContainsPid(const PidSet& pids, int pid) {
+    return pid > 0 && std::find(pids.begin(), pids.end(), pid) != pids.end();
+}
+
+void PushChildren(AccessibleTree& tree, AccessibleTree::Node node, std::deque<NodeRef>& queue) {
+    int childCount = tree.ChildCount(node);
+    for (int i = 0; i < childCount; ++i) {
+        NodeRef child(&tree, tree.ChildAt(node, i));
+        if (child) {
+            queue.push_back(std::move(child));
+        }
+    }
+}
+
+}  // namespace
+
+bool LooksLikeUrl(const std::string& rawValue) {
+    std::string value = Trim(rawValue);
+    if (value.empty()) {
+        return false;
+    }
+    std::string lower = ToLower(value);
+    static const std::vector<std::string> kKnownSchemes = {
+        "http:",   "https:", "file:",  "about:", "chrome:", "googlechrome:",
+        "edge:",   "brave:", "opera:", "vivaldi:", "moz-extension:", "gopher:"
+    };
+    for (const auto& scheme : kKnownSchemes) {
+        if (StartsWithIgnoreCase(lower, scheme)) {
+            return true;
+        }
+    }
+    if (lower.rfind("www.", 0) == 0) {
+        return true;
+    }
+    if (lower.find("://") != std::string::npos) {
+        return true;
+    }
+    size_t dot = lower.find('.');
+    if (dot != std::string::npos && dot + 1 < lower.size() &&
+        lower.find(' ') == std::string::npos) {
+        return true;
+    }
+    return false;
+}
+
+const BrowserLocator& GetBrowserLocator(const std::string& processName) {
+    // Gecko publishes DocURL; Chromium's ATK bridge publishes URI.
+    static const BrowserLocator kLocators[] = {
+        {"firefox", {"address", "search with", "url", "awesome bar", "url bar"}, {"DocURL"}},
+        {"chrome", {"address and search", "omnibox", "url"}, {"URI"}},
+        {"chromium", {"address and search", "omnibox", "url"}, {"URI"}},
+        {"google-chrome", {"address and search", "omnibox", "url"}, {"URI"}},
+        {"msedge", {"search or enter web address", "address and search", "url"}, {"URI"}},
+        {"microsoft-edge", {"search or enter web address", "address and search", "url"}, {"URI"}},
+        {"brave", {"address and search", "url"}, {"URI"}},
+        {"opera", {"address field", "search", "url"}, {"URI"}},
+        {"vivaldi", {"address", "search", "url"}, {"URI"}},
+    };
+    for (const auto& locator : kLocators) {
+        if (processName == locator.processName) {
+            return locator;
+        }
+    }
+    static const BrowserLocator kDefault = {
+        "", {"address", "search", "url", "omnibox"}, {"DocURL", "URI"}};
+    return kDefault;
+}
+
+int ScoreEntryNode(AccessibleTree& tree, AccessibleTree::Node node,
+                   const BrowserLocator& locator) {
+    if (!node) {
+        return 0;
+    }
+    AccessibleRole role = tree.Role(node);
+    if (role != AccessibleRole::Entry && role != AccessibleRole::Text) {
+        return 0;
+    }
+
+    uint32_t states = 0;
+    if (!tree.States(node, states)) {
+        return 0;
+    }
+    bool editable = (states & kStateEditable) != 0;
+    bool focusable = (states & kStateFocusable) != 0;
+    bool enabled = (states & kStateEnabled) != 0;
+    bool focused = (states & kStateFocused) != 0;
+    if (!editable || !focusable || !enabled) {
+        return 0;
+    }
+
+    int score = 1;
+    if (focused) {
+        score += 2;
+    }
+
+    std::string lowerName = ToLower(tree.Name(node));
+    if (!lowerName.empty()) {
+        for (const auto& keyword : locator.keywords) {
+            if (!keyword.empty() && lowerName.find(keyword) != std::string::npos) {
+                score += 4;
+                break;
+            }
+        }
+        static const std::vector<std::string> kGenericKeywords = {"address", "search", "url",
+                                                                  "location", "omnibox"};
+        for (const auto& keyword : kGenericKeywords) {
+            if (!keyword.empty() && lowerName.find(keyword) != std::string::npos) {
+                score += 2;
+                break;
+            }
+        }
+    }
+
+    NodeRef parent(&tree, tree.Parent(node));
+    if (parent) {
+        AccessibleRole parentRole = tree.Role(parent.get());
+        if (parentRole == AccessibleRole::ToolBar || parentRole == AccessibleRole::Panel) {
+            score += 1;
+        }
+    }
+
+    return score;
+}
+
+std::string ExtractUrlFromNode(AccessibleTree& tree, AccessibleTree::Node node) {
+    if (!node) {
+        return std::string();
+    }
+    std::string value;
+    if (!tree.Text(node, value)) {
+        return std::string();
+    }
+    value = Trim(value);
+    if (value.size() > 4096) {
+        value.resize(4096);
+    }
+    if (LooksLikeUrl(value)) {
+        return value;
+    }
+    return std::string();
+}
+
+NodeRef PromoteToPidAncestor(AccessibleTree& tree, AccessibleTree::Node start,
+                             const PidSet& pids) {
+    if (!start) {
+        return NodeRef();
+    }
+
+    const int kMaxDepth = 32;
+    NodeRef current(&tree, tree.Ref(start));
+    NodeRef best;
+    TimeoutWatch watch(tree);
+
+    for (int depth = 0; depth < kMaxDepth && current && !watch.fired(); ++depth) {
+        if (ContainsPid(pids, tree.ProcessId(current.get()))) {
+            best = current.Share();
+        } else if (best) {
+            break;
+        }
+
+        NodeRef parent(&tree, tree.Parent(current.get()));
+        if (!parent) {
+            break;
+        }
+        current = std::move(parent);
+    }
+
+    return best;
+}
+
+NodeRef SearchTreeForPid(AccessibleTree& tree, AccessibleTree::Node root, const PidSet& pids,
+                         size_t maxNodes, UrlSearchStats* stats) {
+    int pid = pids.empty() ? 0 : pids.front();
+    if (!root) {
+        return NodeRef();
+    }
+
+    std::deque<NodeRef> queue;
+    queue.emplace_back(&tree, tree.Ref(root));
+    size_t visited = 0;
+    TimeoutWatch watch(tree);
+
+    while (!queue.empty() && visited < maxNodes && !watch.fired()) {
+        NodeRef node = std::move(queue.front());
+        queue.pop_front();
+        ++visited;
+
+        NodeRef match = PromoteToPidAncestor(tree, node.get(), pids);
+        if (match) {
+            DebugLog("Matched pid %d after visiting %zu nodes in subtree", pid, visited);
+            if (stats) {
+                stats->nodesVisited += visited;
+            }
+            return match;
+        }
+        if (watch.fired()) {
+            break;
+        }
+
+        PushChildren(tree, node.get(), queue);
+    }
+
+    if (stats) {
+        stats->nodesVisited += visited;
+    }
+    if (watch.fired()) {
+        DebugLog("SearchTreeForPid gave up on a subtree after a timeout (%zu nodes)", visited);
+    } else {
+        DebugLog("SearchTreeForPid hit limit (%zu nodes) without finding pid %d", maxNodes, pid);
+    }
+    return NodeRef();
+}
+
+NodeRef FindAccessibleForPid(AccessibleTree& tree, const PidSet& pids, UrlSearchStats* stats,
+                             AppCircuitBreaker* breaker) {
+    int pid = pids.empty() ? 0 : pids.front();
+    UrlSearchStats ownStats;
+    if (!stats) {
+        stats = &ownStats;
+    }
+    LookupStage stage("find_by_pid", pid, &stats->nodesVisited);
+    const size_t kMaxNodesPerApp = 20000;
+    int desktopCount = tree.DesktopCount();
+
+    for (int desktopIndex = 0; desktopIndex < desktopCount; ++desktopIndex) {
+        NodeRef desktop(&tree, tree.Desktop(desktopIndex));
+        if (!desktop) {
+            continue;
+        }
+
+        int childCount = tree.ChildCount(desktop.get());
+        DebugLog("Desktop %d/%d has %d children while searching for pid %d", desktopIndex + 1,
+                 desktopCount, childCount, pid);
+        for (int i = 0; i < childCount; ++i) {
+            NodeRef child(&tree, tree.ChildAt(desktop.get(), i));
+            if (!child) {
+                continue;
+            }
+
+            NodeRef match = SearchApplication(tree, child.get(), breaker, stats, [&]() {
+                // Every object of an application lives on its bus connection, so the
+                // application's pid is every node's. Only one whose pid cannot be read
+                // is walked.
+                int appPid = tree.ProcessId(child.get());
+                if (appPid > 0) {
+                    ++stats->nodesVisited;
+                    return ContainsPid(pids, appPid) ? child.Share() : NodeRef();
+                }
+                return SearchTreeForPid(tree, child.get(), pids, kMaxNodesPerApp, stats);
+            });
+            if (match) {
+                DebugLog("Found accessibility root for pid %d on desktop %d child %d", pid,
+                         desktopIndex, i);
+                return match;
+            }
+        }
+    }
+    return NodeRef();
+}
+
+std::string SearchDocumentUrl(AccessibleTree& tree, AccessibleTree::Node root,
+                              const BrowserLocator& locator, UrlSearchStats* stats) {
+    if (!root || locator.documentUrlAttributes.empty()) {
+        return std::string();
+    }
+
+    const size_t kMaxNodes = 5000;
+    std::deque<NodeRef> queue;
+    queue.emplace_back(&tree, tree.Ref(root));
+    size_t visited = 0;
+    LookupStage stage("search_document_url", LookupStage::kInheritPid, &visited);
+    std::string url;
+    TimeoutWatch watch(tree);
+
+    while (!queue.empty() && visited < kMaxNodes && !watch.fired()) {
+        NodeRef node = std::move(queue.front());
+        queue.pop_front();
+        ++visited;
+
+        if (tree.Role(node.get()) != AccessibleRole::DocumentWeb) {
+            if (!watch.fired()) {
+                PushChildren(tree, node.get(), queue);
+            }
+            continue;
+        }
+        // Background tabs stay in the tree but are not showing.
+        uint32_t states = 0;
+        if (!tree.States(node.get(), states) || !(states & kStateShowing)) {
+            continue;
+        }
+        for (const auto& attribute : locator.documentUrlAttributes) {
+            std::string value;
+            if (tree.DocumentAttribute(node.get(), attribute, value)) {
+                value = Trim(value);
+                if (LooksLikeUrl(value)) {
+                    url = value;
+                    break;
+                }
+            }
+        }
+        break;
+    }
+
+    if (stats) {
+        stats->nodesVisited += visited;
+    }
+    if (!url.empty()) {
+        DebugLog("SearchDocumentUrl found URL '%s' after visiting %zu nodes", url.c_str(),
+                 visited);
+    } else {
+        DebugLog("SearchDocumentUrl found no document URL after visiting %zu nodes", visited);
+    }
+    return url;
+}
+
+std::string SearchAddressBar(AccessibleTree& tree, AccessibleTree::Node root,
+                             const BrowserLocator& locator, UrlSearchStats* stats) {
+    if (!root) {
+        return std::string();
+    }
+
+    const size_t kMaxNodes = 15000;
+    std::deque<NodeRef> queue;
+    queue.emplace_back(&tree, tree.Ref(root));
+    size_t visited = 0;
+    LookupStage stage("search_address_bar", LookupStage::kInheritPid, &visited);
+    int bestScore = 0;
+    std::string bestUrl;
+    TimeoutWatch watch(tree);
+
+    while (!queue.empty() && visited < kMaxNodes && !watch.fired()) {
+        NodeRef node = std::move(queue.front());
+        queue.pop_front();
+        ++visited;
+
+        int score = ScoreEntryNode(tree, node.get(), locator);
+        if (score > 0) {
+            std::string value = ExtractUrlFromNode(tree, node.get());
+            if (!value.empty()) {
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestUrl = value;
+                    if (score >= 6 && value.find("://") != std::string::npos) {
+                        DebugLog("URL candidate '%s' accepted with score %d", value.c_str(),
+                                 score);
+                        break;
+                    }
+                }
+            }
+        }
+        if (watch.fired()) {
+            break;
+        }
+
+        PushChildren(tree, node.get(), queue);
+    }
+
+    if (stats) {
+        stats->nodesVisited += visited;
+    }
+    if (!bestUrl.empty()) {
+        DebugLog("SearchAddressBar found URL '%s' after visiting %zu nodes", bestUrl.c_str(),
+                 visited);
+    } else {
+        DebugLog("SearchAddressBar failed to find URL after visiting %zu nodes (best score %d)",
+                 visited, bestScore);
+    }
+    return bestUrl;
+}
+
+NodeRef FindAccessibleByTitle(AccessibleTree& tree, const std::string& windowTitle,
+                              UrlSearchStats* stats, AppCircuitBreaker* breaker) {
+    if (windowTitle.empty()) {
+        return NodeRef();
+    }
+
+    UrlSearchStats ownStats;
+    if (!stats) {
+        stats = &ownStats;
+    }
+    LookupStage stage("find_by_title", LookupStage::kInheritPid, &stats->nodesVisited);
+    std::string lowerTitle = ToLower(windowTitle);
+    int desktopCount = tree.DesktopCount();
+    for (int desktopIndex = 0; desktopIndex < desktopCount; ++desktopIndex) {
+        NodeRef desktop(&tree, tree.Desktop(desktopIndex));
+        if (!desktop) {
+            continue;
+        }
+
+        int childCount = tree.ChildCount(desktop.get());
+        for (int i = 0; i < childCount; ++i) {
+            NodeRef app(&tree, tree.ChildAt(desktop.get(), i));
+            if (!app) {
+                continue;
+            }
+
+            // Every application is considered; process names are not reliable here.
+            NodeRef match = SearchApplication(tree, app.get(), breaker, stats, [&]() {
+                TimeoutWatch watch(tree);
+                int appChildCount = tree.ChildCount(app.get());
+                for (int j = 0; j < appChildCount && !watch.fired(); ++j) {
+                    NodeRef window(&tree, tree.ChildAt(app.get(), j));
+                    if (!window) {
+                        continue;
+                    }
+                    ++stats->nodesVisited;
+
+                    // Match when the window name equals, contains or is contained in the title.
+                    std::string winName = ToLower(tree.Name(window.get()));
+                    if (!winName.empty() && (winName.find(lowerTitle) != std::string::npos ||
+                                             lowerTitle.find(winName) != std::string::npos)) {
+                        DebugLog("Found accessibility window by global title match: '%s'",
+                                 winName.c_str());
+                        return window;
+                    }
+                }
+                return NodeRef();
+            });
+            if (match) {
+                return match;
+            }
+        }
+    }
+    return NodeRef();
+}
+
+NodeRef MatchWindowFrame(AccessibleTree& tree, AccessibleTree::Node app,
+                         const std::string& windowTitle, const WindowScope& window,
+                         UrlSearchStats* stats) {
+    if (!app) {
+        return NodeRef();
+    }
+    UrlSearchStats ownStats;
+    if (!stats) {
+        stats = &ownStats;
+    }
+    LookupStage stage("match_window_frame", LookupStage::kInheritPid, &stats->nodesVisited);
+    const double kMinOverlap = 0.8;
+    std::string lowerTitle = ToLower(windowTitle);
+    bool hasBounds = window.bounds.width > 0 && window.bounds.height > 0;
+
+    // A remembered frame stands while it still carries the title or still covers the
+    // window; either way it was the only match once.
+    if (window.frames && window.windowId != 0) {
+        NodeRef cached = window.frames->Find(window.windowId);
+        if (cached) {
+            ++stats->nodesVisited;
+            AccessibleRect extents;
+            if (TitleScore(tree.Name(cached.get()), lowerTitle) == 2 ||
+                (hasBounds && tree.Extents(cached.get(), extents) &&
+                 Overlap(extents, window.bounds) >= kMinOverlap)) {
+                return cached;
+            }
+            window.frames->Remove(window.windowId);
+        }
+    }
+
+    struct Candidate {
+        NodeRef frame;
+        int score;
+    };
+    std::vector<Candidate> candidates;
+    int bestScore = 0;
+    TimeoutWatch watch(tree);
+    int childCount = tree.ChildCount(app);
+    for (int i = 0; i < childCount && !watch.fired(); ++i) {
+        NodeRef child(&tree, tree.ChildAt(app, i));
+        if (!child) {
+            continue;
+        }
+        ++stats->nodesVisited;
+        int score = childCount > 1 ? TitleScore(tree.Name(child.get()), lowerTitle) : 0;
+        bestScore = std::max(bestScore, score);
+        candidates.push_back(Candidate{std::move(child), score});
+    }
+    if (watch.fired()) {
+        return NodeRef();
+    }
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                    [&](const Candidate& c) { return c.score < bestScore; }),
+                     candidates.end());
+
+    NodeRef match;
+    if (candidates.size() == 1) {
+        match = std::move(candidates.front().frame);
+    } else if (candidates.size() > 1 && hasBounds) {
+        // Same title in several windows (two new tabs): the window's position decides,
+        // unless two frames cover it equally (stacked maximized windows).
+        double best = 0.0;
+        double runnerUp = 0.0;
+        Candidate* bestCandidate = nullptr;
+        for (Candidate& candidate : candidates) {
+            AccessibleRect extents;
+            if (!tree.Extents(candidate.frame.get(), extents)) {
+                continue;
+            }
+            double overlap = Overlap(extents, window.bounds);
+            if (overlap > best) {
+                runnerUp = best;
+                best = overlap;
+                bestCandidate = &candidate;
+            } else if (overlap > runnerUp) {
+                runnerUp = overlap;
+            }
+        }
+        if (bestCandidate && best >= kMinOverlap && runnerUp < best) {
+            match = std::move(bestCandidate->frame);
+        }
+    }
+
+    if (!match) {
+        DebugLog("No single frame of %d matches window 0x%llx ('%s')", childCount,
+                 static_cast<unsigned long long>(window.windowId), windowTitle.c_str());
+        return NodeRef();
+    }
+    if (window.frames && window.windowId != 0) {
+        window.frames->Put(window.windowId, match.get());
+    }
+    return match;
+}
+
+std::string FindBrowserUrl(AccessibleTree& tree, const PidSet& pids,
+                           const std::string& processName, const std::string& windowTitle,
+                           TitleIndex* titles, UrlSearchStats* stats, AppCircuitBreaker* breaker,
+                           const WindowScope* window) {
+    int pid = pids.empty() ? 0 : pids.front();
+    NodeRef root = FindAccessibleForPid(tree, pids, stats, breaker);
+    // A title match is already one window; an application holds all of the browser's.
+    bool narrow = window && root && tree.Role(root.get()) == AccessibleRole::Application;
+    if (!root) {
+        DebugLog("No accessibility root found for pid %d, trying global title match for '%s'",
+                 pid, windowTitle.c_str());
+        root = titles ? titles->Find(windowTitle)
+                      : FindAccessibleByTitle(tree, windowTitle, stats, breaker);
+    }
+
+    if (!root) {
+        DebugLog("No accessibility root found for pid %d (%s) even by name", pid,
+                 processName.c_str());
+        return std::string();
+    }
+
+    if (stats) {
+        stats->rootFound = true;
+    }
+    // The title index can hand out a window of an app that is backing off.
+    std::string app = breaker ? tree.ApplicationId(root.get()) : std::string();
+    if (breaker && !breaker->Allow(app)) {
+        if (stats) {
+            ++stats->appsSkipped;
+        }
+        return std::string();
+    }
+    if (narrow) {
+        NodeRef frame = MatchWindowFrame(tree, root.get(), windowTitle, *window, stats);
+        if (frame) {
+            root = std::move(frame);
+        }
+    }
+    TimeoutWatch watch(tree);
+    const BrowserLocator& locator = GetBrowserLocator(processName);
+    std::string url = SearchDocumentUrl(tree, root.get(), locator, stats);
+    if (!url.empty()) {
+        if (stats) {
+            stats->source = UrlSource::Document;
+        }
+    } else if (!watch.fired()) {
+        url = SearchAddressBar(tree, root.get(), locator, stats);
+        if (!url.empty() && stats) {
+            stats->source = UrlSource::AddressBar;
+        }
+    }
+    if (breaker && watch.fired()) {
+        breaker->RecordTimeout(app);
+    }
+    return url;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "accessible_tree.h"
+
+class AppCircuitBreaker;
+class TitleIndex;
+class WindowFrameCache;
+
+struct BrowserLocator {
+    const char* processName;
+    std::vector<std::string> keywords;
+    // Document interface attributes carrying the page URL, tried in order.
+    std::vector<std::string> documentUrlAttributes;
+};
+
+const BrowserLocator& GetBrowserLocator(const std::string& processName);
+
+bool LooksLikeUrl(const std::string& value);
+
+enum class UrlSource { NotFound, Document, AddressBar };
+
+// Per-lookup counters reported by the search functions (added to, never reset).
+struct UrlSearchStats {
+    size_t nodesVisited = 0;
+    size_t appsSkipped = 0;  // backing off after a timeout
+    bool rootFound = false;   // the browser's accessible window, by pid or title
+    UrlSource source = UrlSource::NotFound;
+};
+
+// Address-bar heuristics: 0 when the node cannot be the URL entry.
+int ScoreEntryNode(AccessibleTree& tree, AccessibleTree::Node node,
+                   const BrowserLocator& locator);
+std::string ExtractUrlFromNode(AccessibleTree& tree, AccessibleTree::Node node);
+
+// The pids a window's application can have in AT-SPI: its own, first, and for a sandboxed
+// application those of the rest of its sandbox (Flatpak's accessibility bus proxy).
+using PidSet = std::vector<int>;
+
+// Highest ancestor-or-self that still belongs to one of pids, walking up from start.
+NodeRef PromoteToPidAncestor(AccessibleTree& tree, AccessibleTree::Node start,
+                             const PidSet& pids);
+NodeRef SearchTreeForPid(AccessibleTree& tree, AccessibleTree::Node root, const PidSet& pids,
+                         size_t maxNodes, UrlSearchStats* stats = nullptr);
+// Scans every application on every desktop for the accessible root of pids. An application
+// whose own pid is known and not among them is skipped without a walk. With a breaker,
+// applications backing off are skipped and ones that time out start backing off.
+NodeRef FindAccessibleForPid(AccessibleTree& tree, const PidSet& pids,
+                             UrlSearchStats* stats = nullptr,
+                             AppCircuitBreaker* breaker = nullptr);
+// The window a lookup is for, to narrow a browser with several top-level windows to the
+// one showing it.
+struct WindowScope {
+    uint64_t windowId = 0;
+    AccessibleRect bounds;               // screen coordinates; width 0 when unknown
+    WindowFrameCache* frames = nullptr;  // remembers each window's frame when given
+};
+
+// The child of an application root that is the scope's window: the only child, else the
+// one named windowTitle (exactly, then by containment), else among equally named ones the
+// one whose extents overlap the window's bounds best. Null when that leaves no single one.
+NodeRef MatchWindowFrame(AccessibleTree& tree, AccessibleTree::Node app,
+                         const std::string& windowTitle, const WindowScope& window,
+                         UrlSearchStats* stats = nullptr);
+
+// Top-level window whose name contains (or is contained in) windowTitle, any application.
+NodeRef FindAccessibleByTitle(AccessibleTree& tree, const std::string& windowTitle,
+                              UrlSearchStats* stats = nullptr,
+                              AppCircuitBreaker* breaker = nullptr);
+// The walks below give up on root's subtree (returning what they found so far) as soon as
+// one of their calls times out.
+
+// URL attribute of the first showing document-web below root; page content is not
+// descended into.
+std::string SearchDocumentUrl(AccessibleTree& tree, AccessibleTree::Node root,
+                              const BrowserLocator& locator, UrlSearchStats* stats = nullptr);
+std::string SearchAddressBar(AccessibleTree& tree, AccessibleTree::Node root,
+                             const BrowserLocator& locator, UrlSearchStats* stats = nullptr);
+
+// The whole lookup: accessible root by pid, else by window title (through titles when
+// given, by a desktop walk otherwise), narrowed to the window's frame when a window is
+// given, then the document URL where the browser exposes one, then the address bar. A
+// browser whose calls time out gets no URL until the breaker lets it be tried again.
+std::string FindBrowserUrl(AccessibleTree& tree, const PidSet& pids,
+                           const std::string& processName, const std::string& windowTitle,
+                           TitleIndex* titles = nullptr, UrlSearchStats* stats = nullptr,
+                           AppCircuitBreaker* breaker = nullptr,
+                           const WindowScope* window = nullptr);
@@ -0,0 +1,286 @@
+#include "usage_aggregator.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+
+namespace {
+
+const int64_t kMinuteMs = 60LL * 1000;
+const int64_t kHourMs = 60LL * kMinuteMs;
+const int64_t kDayMs = 24LL * kHourMs;
+
+int64_t BucketWidth(UsageBucket bucket) {
+    switch (bucket) {
+        case UsageBucket::Minute:
+            return kMinuteMs;
+        case UsageBucket::Hour:
+            return kHourMs;
+        case UsageBucket::Day:
+        default:
+            return kDayMs;
+    }
+}
+
+int64_t FloorDiv(int64_t value, int64_t divisor) {
+    int64_t quotient = value / divisor;
+    if ((value % divisor != 0) && ((value < 0) != (divisor < 0))) {
+        --quotient;
+    }
+    return quotient;
+}
+
+std::string ToLowerAscii(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return value;
+}
+
+}  // namespace
+
+std::string NormalizeWebsite(const std::string& url) {
+    size_t colon = url.find(':');
+    if (colon == std::string::npos || colon == 0) {
+        return std::string();
+    }
+    for (size_t i = 0; i < colon; ++i) {
+        unsigned char c = static_cast<unsigned char>(url[i]);
+        bool valid = std::isalpha(c) || (i > 0 && (std::isdigit(c) || c == '+' || c == '-' ||
+                                                   c == '.'));
+        if (!valid) {
+            return std::string();
+        }
+    }
+    std::string scheme = ToLowerAscii(url.substr(0, colon + 1));
+    size_t hostStart = colon + 1;
+    if (url.compare(hostStart, 2, "//") != 0) {
+        // Opaque URLs such as about:blank have no host, like URL#hostname in JS.
+        return scheme + "//";
+    }
+    hostStart += 2;
+    size_t hostEnd = url.find_first_of("/?#", hostStart);
+    std::string authority =
+        url.substr(hostStart, hostEnd == std::string::npos ? std::string::npos : hostEnd - hostStart);
+    size_t at = authority.rfind('@');
+    if (at != std::string::npos) {
+        authority.erase(0, at + 1);
+    }
+    // Keep bracketed IPv6 literals intact and drop the port.
+    size_t portSearchFrom = 0;
+    if (!authority.empty() && authority[0] == '[') {
+        size_t close = authority.find(']');
+        portSearchFrom = close == std::string::npos ? authority.size() : close;
+    }
+    size_t port = authority.find(':', portSearchFrom);
+    if (port != std::string::npos) {
+        authority.erase(port);
+    }
+    return scheme + "//" + ToLowerAscii(authority);
+}
+
+bool ParseUsageBucket(const std::string& name, UsageBucket& bucket) {
+    if (name == "minute") {
+        bucket = UsageBucket::Minute;
+    } else if (name == "hour") {
+        bucket = UsageBucket::Hour;
+    } else if (name == "day") {
+        bucket = UsageBucket::Day;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool ParseUsageGroupBy(const std::string& name, uint32_t& groupBy) {
+    if (name == "app") {
+        groupBy |= kGroupByApp;
+    } else if (name == "website") {
+        groupBy |= kGroupByWebsite;
+    } else if (name == "title") {
+        groupBy |= kGroupByTitle;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+UsageAggregator::UsageAggregator(const UsageAggregatorOptions& options) : options_(options) {
+    if (options_.maxSampleGapMs < 0) {
+        options_.maxSampleGapMs = 0;
+    }
+    Intern(std::string());
+}
+
+uint32_t UsageAggregator::Intern(const std::string& value) {
+    auto it = stringIds_.find(value);
+    if (it != stringIds_.end()) {
+        ++refs_[it->second];
+        return it->second;
+    }
+    uint32_t id;
+    if (!freeIds_.empty()) {
+        id = freeIds_.back();
+        freeIds_.pop_back();
+        strings_[id] = value;
+        refs_[id] = 1;
+    } else {
+        id = static_cast<uint32_t>(strings_.size());
+        strings_.push_back(value);
+        refs_.push_back(1);
+    }
+    stringIds_.emplace(value, id);
+    return id;
+}
+
+void UsageAggregator::Retain(const CellKey& key) {
+    ++refs_[key.app];
+    ++refs_[key.website];
+    ++refs_[key.title];
+}
+
+void UsageAggregator::Release(const CellKey& key) {
+    Release(key.app);
+    Release(key.website);
+    Release(key.title);
+}
+
+void UsageAggregator::Release(uint32_t id) {
+    // Id 0 (the empty string) keeps the reference taken by the constructor.
+    if (--refs_[id] != 0) {
+        return;
+    }
+    stringIds_.erase(strings_[id]);
+    std::string().swap(strings_[id]);
+    freeIds_.push_back(id);
+}
+
+int64_t UsageAggregator::BucketStart(UsageBucket bucket, int64_t timestampMs) const {
+    int64_t width = BucketWidth(bucket);
+    int64_t offset = options_.utcOffsetMinutes * kMinuteMs;
+    return FloorDiv(timestampMs + offset, width) * width - offset;
+}
+
+void UsageAggregator::Credit(const CellKey& key, int64_t startMs, int64_t endMs,
+                             bool countSample) {
+    for (int level = 0; level < 3; ++level) {
+        UsageBucket bucket = static_cast<UsageBucket>(level);
+        int64_t width = BucketWidth(bucket);
+        int64_t cursor = startMs;
+        bool first = true;
+        // Split the interval at bucket boundaries; a sample rarely spans more than two.
+        do {
+            int64_t bucketStart = BucketStart(bucket, cursor);
+            int64_t sliceEnd = std::min(endMs, bucketStart + width);
+            auto inserted = rollups_[level][bucketStart].try_emplace(key);
+            if (inserted.second) {
+                Retain(key);
+            }
+            Cell& cell = inserted.first->second;
+            cell.durationMs += sliceEnd - cursor;
+            if (first && countSample) {
+                ++cell.samples;
+            }
+            first = false;
+            cursor = sliceEnd;
+        } while (cursor < endMs);
+    }
+}
+
+void UsageAggregator::Prune(int64_t nowMs) {
+    if (nowMs - lastPruneMs_ < kMinuteMs) {
+        return;
+    }
+    lastPruneMs_ = nowMs;
+    const int64_t retention[3] = {options_.minuteRetentionMs, options_.hourRetentionMs,
+                                  options_.dayRetentionMs};
+    for (int level = 0; level < 3; ++level) {
+        if (retention[level] <= 0) {
+            continue;
+        }
+        auto& buckets = rollups_[level];
+        auto end = buckets.lower_bound(nowMs - retention[level]);
+        for (auto it = buckets.begin(); it != end; ++it) {
+            for (const auto& entry : it->second) {
+                Release(entry.first);
+            }
+        }
+        buckets.erase(buckets.begin(), end);
+    }
+}
+
+void UsageAggregator::Record(const ActiveWindowInfo& info, int64_t timestampMs) {
+    RecordGap(timestampMs);
+
+    CellKey key;
+    key.app = Intern(info.processName);
+    key.website = Intern(NormalizeWebsite(info.browserUrl));
+    key.title = Intern(info.title);
+    hasPending_ = true;
+    pendingKey_ = key;
+    pendingStart_ = timestampMs;
+}
+
+void UsageAggregator::RecordGap(int64_t timestampMs) {
+    if (hasPending_) {
+        int64_t end = std::min(timestampMs, pendingStart_ + options_.maxSampleGapMs);
+        // Samples arriving out of order still count, they just credit no time.
+        Credit(pendingKey_, pendingStart_, std::max(end, pendingStart_), true);
+        Release(pendingKey_);
+        hasPending_ = false;
+    }
+    Prune(timestampMs);
+}
+
+std::vector<UsageRow> UsageAggregator::Query(const UsageQuery& query) const {
+    std::vector<UsageRow> rows;
+    if (query.to <= query.from) {
+        return rows;
+    }
+
+    const auto& buckets = rollups_[static_cast<int>(query.bucket)];
+    int64_t width = BucketWidth(query.bucket);
+    auto it = buckets.lower_bound(BucketStart(query.bucket, query.from));
+    for (; it != buckets.end() && it->first < query.to; ++it) {
+        BucketCells grouped;
+        for (const auto& entry : it->second) {
+            CellKey key;
+            key.app = (query.groupBy & kGroupByApp) ? entry.first.app : 0;
+            key.website = (query.groupBy & kGroupByWebsite) ? entry.first.website : 0;
+            key.title = (query.groupBy & kGroupByTitle) ? entry.first.title : 0;
+            Cell& cell = grouped[key];
+            cell.durationMs += entry.second.durationMs;
+            cell.samples += entry.second.samples;
+        }
+
+        size_t firstRow = rows.size();
+        for (const auto& entry : grouped) {
+            if (entry.second.durationMs <= 0 && entry.second.samples == 0) {
+                continue;
+            }
+            UsageRow row;
+            row.bucketStart = it->first;
+            row.bucketEnd = it->first + width;
+            row.app = strings_[entry.first.app];
+            row.website = strings_[entry.first.website];
+            row.title = strings_[entry.first.title];
+            row.durationMs = entry.second.durationMs;
+            row.samples = entry.second.samples;
+            rows.push_back(std::move(row));
+        }
+        std::sort(rows.begin() + static_cast<std::ptrdiff_t>(firstRow), rows.end(),
+                  [](const UsageRow& a, const UsageRow& b) { return a.durationMs > b.durationMs; });
+    }
+    return rows;
+}
+
+void UsageAggregator::Clear() {
+    for (auto& level : rollups_) {
+        level.clear();
+    }
+    hasPending_ = false;
+    strings_.clear();
+    stringIds_.clear();
+    refs_.clear();
+    freeIds_.clear();
+    Intern(std::string());
+}
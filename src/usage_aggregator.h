@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "active_window.h"
+
+enum class UsageBucket { Minute = 0, Hour = 1, Day = 2 };
+
+// Dimensions a query can group by; combine with bitwise or.
+enum UsageGroupBy : uint32_t {
+    kGroupByApp = 1u << 0,
+    kGroupByWebsite = 1u << 1,
+    kGroupByTitle = 1u << 2,
+};
+
+struct UsageAggregatorOptions {
+    // A sample is credited with the time until the next sample, capped at this value so a
+    // stalled poller or a sleeping machine does not inflate usage.
+    int64_t maxSampleGapMs = 5000;
+    // Shifts bucket boundaries so hour and day buckets line up with local time.
+    int64_t utcOffsetMinutes = 0;
+    // How long finished buckets are kept per granularity; 0 keeps them forever.
+    int64_t minuteRetentionMs = 2LL * 24 * 60 * 60 * 1000;
+    int64_t hourRetentionMs = 62LL * 24 * 60 * 60 * 1000;
+    int64_t dayRetentionMs = 0;
+};
+
+struct UsageQuery {
+    int64_t from = 0;
+    int64_t to = 0;
+    uint32_t groupBy = kGroupByApp;
+    UsageBucket bucket = UsageBucket::Hour;
+};
+
+struct UsageRow {
+    int64_t bucketStart = 0;
+    int64_t bucketEnd = 0;
+    std::string app;
+    std::string website;
+    std::string title;
+    int64_t durationMs = 0;
+    uint64_t samples = 0;
+};
+
+// Incrementally maintained minute/hour/day rollups of foreground time. Each sample is
+// credited to its bucket at every granularity as it arrives, so queries only merge
+// pre-aggregated cells and never touch raw samples.
+class UsageAggregator {
+   public:
+    explicit UsageAggregator(const UsageAggregatorOptions& options = UsageAggregatorOptions());
+
+    // Records the foreground window seen at timestampMs. The previous sample is credited
+    // with the time elapsed since it was recorded.
+    void Record(const ActiveWindowInfo& info, int64_t timestampMs);
+    // Records that nothing should be credited from timestampMs on (no window, idle, locked).
+    void RecordGap(int64_t timestampMs);
+
+    std::vector<UsageRow> Query(const UsageQuery& query) const;
+    void Clear();
+
+    size_t InternedStringCount() const { return strings_.size() - freeIds_.size(); }
+
+   private:
+    struct CellKey {
+        uint32_t app = 0;
+        uint32_t website = 0;
+        uint32_t title = 0;
+        bool operator==(const CellKey& other) const {
+            return app == other.app && website == other.website && title == other.title;
+        }
+    };
+    struct CellKeyHash {
+        size_t operator()(const CellKey& key) const {
+            uint64_t h = key.app;
+            h = h * 0x9E3779B97F4A7C15ULL + key.website;
+            h = h * 0x9E3779B97F4A7C15ULL + key.title;
+            return static_cast<size_t>(h ^ (h >> 29));
+        }
+    };
+    struct Cell {
+        int64_t durationMs = 0;
+        uint64_t samples = 0;
+    };
+    using BucketCells = std::unordered_map<CellKey, Cell, CellKeyHash>;
+
+    // Returns value's id with one more reference; Release drops it.
+    uint32_t Intern(const std::string& value);
+    void Retain(const CellKey& key);
+    void Release(const CellKey& key);
+    void Release(uint32_t id);
+    int64_t BucketStart(UsageBucket bucket, int64_t timestampMs) const;
+    void Credit(const CellKey& key, int64_t startMs, int64_t endMs, bool countSample);
+    void Prune(int64_t nowMs);
+
+    UsageAggregatorOptions options_;
+    std::vector<std::string> strings_;
+    std::unordered_map<std::string, uint32_t> stringIds_;
+    // Per id: cells plus the pending sample referencing it. Unreferenced ids are reused.
+    std::vector<uint32_t> refs_;
+    std::vector<uint32_t> freeIds_;
+    std::map<int64_t, BucketCells> rollups_[3];
+
+    bool hasPending_ = false;
+    CellKey pendingKey_;
+    int64_t pendingStart_ = 0;
+    int64_t lastPruneMs_ = 0;
+};
+
+bool ParseUsageBucket(const std::string& name, UsageBucket& bucket);
+bool ParseUsageGroupBy(const std::string& name, uint32_t& groupBy);
+
+// Mirrors the `website` field computed in index.js: "<scheme>//<host>", or empty.
+std::string NormalizeWebsite(const std::string& url);
@@ -0,0 +1,225 @@
+#include "window_capture.h"
+
+#include <cstdlib>
+
+#ifdef __linux__
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <algorithm>
+#include <mutex>
+
+#include "debug_log.h"
+#include "geometry_tracker.h"
+#include "pixel_kernels.h"
+#include "x11_util.h"
+
+namespace {
+
+// One connection and one shared-memory segment for the process, reused by every capture so
+// a grab costs a single XShmGetImage round trip and no allocation on the server side.
+struct CaptureState {
+    std::mutex mutex;
+    Display* display = nullptr;
+    bool opened = false;
+    bool useShm = false;
+    XShmSegmentInfo shm{};
+    size_t shmSize = 0;
+};
+
+// Leaked: the segment is already marked for removal and dies with the process.
+CaptureState& SharedCaptureState() {
+    static CaptureState* state = new CaptureState();
+    return *state;
+}
+
+void DetachSegment(CaptureState& state) {
+    if (state.shmSize == 0) {
+        return;
+    }
+    XShmDetach(state.display, &state.shm);
+    XSync(state.display, False);
+    shmdt(state.shm.shmaddr);
+    state.shm = XShmSegmentInfo{};
+    state.shmSize = 0;
+}
+
+bool EnsureSegment(CaptureState& state, size_t size) {
+    if (state.shmSize >= size) {
+        return true;
+    }
+    DetachSegment(state);
+    int id = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+    if (id < 0) {
+        return false;
+    }
+    void* address = shmat(id, nullptr, 0);
+    if (address == reinterpret_cast<void*>(-1)) {
+        shmctl(id, IPC_RMID, nullptr);
+        return false;
+    }
+    state.shm.shmid = id;
+    state.shm.shmaddr = static_cast<char*>(address);
+    state.shm.readOnly = False;
+    bool attached = XShmAttach(state.display, &state.shm);
+    XSync(state.display, False);
+    // Marked for removal now; it stays alive until both sides detach, and cannot leak if
+    // the process dies.
+    shmctl(id, IPC_RMID, nullptr);
+    if (!attached) {
+        shmdt(address);
+        state.shm = XShmSegmentInfo{};
+        return false;
+    }
+    state.shmSize = size;
+    return true;
+}
+
+bool OpenCaptureDisplay(CaptureState& state) {
+    if (state.opened) {
+        return state.display != nullptr;
+    }
+    state.opened = true;
+    state.display = XOpenDisplay(nullptr);
+    if (!state.display) {
+        DebugLog("Capture: cannot open display");
+        return false;
+    }
+    InstallNonFatalXErrorHandler(state.display);
+    // A remote server cannot map our segment; XShmQueryExtension still says yes then, but
+    // XShmAttach or XShmGetImage fails and capture drops to XGetImage for good.
+    state.useShm = XShmQueryExtension(state.display);
+    DebugLog("Capture: MIT-SHM %s", state.useShm ? "available" : "unavailable");
+    return true;
+}
+
+// ZPixmap with BGRX byte order, which is what the kernels expect.
+bool IsBgrx(const XImage* image) {
+    return image->bits_per_pixel == 32 && image->byte_order == LSBFirst &&
+           image->red_mask == 0xff0000 && image->green_mask == 0xff00 &&
+           image->blue_mask == 0xff;
+}
+
+XImage* GrabWithShm(CaptureState& state, Window root, const WindowBounds& area) {
+    Screen* screen = DefaultScreenOfDisplay(state.display);
+    XImage* image = XShmCreateImage(state.display, DefaultVisualOfScreen(screen),
+                                    DefaultDepthOfScreen(screen), ZPixmap, nullptr, &state.shm,
+                                    area.width, area.height);
+    if (!image) {
+        return nullptr;
+    }
+    size_t size = static_cast<size_t>(image->bytes_per_line) * image->height;
+    if (!EnsureSegment(state, size)) {
+        XDestroyImage(image);
+        DebugLog("Capture: shared memory segment unavailable; using XGetImage");
+        state.useShm = false;
+        return nullptr;
+    }
+    image->data = state.shm.shmaddr;
+    if (!XShmGetImage(state.display, root, image, area.x, area.y, AllPlanes)) {
+        image->data = nullptr;
+        XDestroyImage(image);
+        DebugLog("Capture: XShmGetImage failed; using XGetImage");
+        DetachSegment(state);
+        state.useShm = false;
+        return nullptr;
+    }
+    return image;
+}
+
+// Releases an image from either path; the shared segment is not the image's to free.
+void ReleaseImage(CaptureState& state, XImage* image) {
+    if (state.shmSize != 0 && image->data == state.shm.shmaddr) {
+        image->data = nullptr;
+    }
+    XDestroyImage(image);
+}
+
+}  // namespace
+
+bool CaptureActiveWindow(const CaptureOptions& options, CapturedImage& result) {
+    CaptureState& state = SharedCaptureState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!OpenCaptureDisplay(state)) {
+        return false;
+    }
+    Display* display = state.display;
+    Window window = options.windowId ? static_cast<Window>(options.windowId)
+                                     : QueryActiveWindow(display);
+    if (!window) {
+        return false;
+    }
+
+    WindowBounds bounds;
+    FrameExtents frameExtents;
+    if (!geometry_tracker::CachedGeometry(window, bounds, frameExtents)) {
+        bounds = ReadWindowBounds(display, window);
+    }
+
+    // Clip to the screen: XGetImage on the root fails outright for areas outside it.
+    Window root = DefaultRootWindow(display);
+    long screenWidth = DisplayWidth(display, DefaultScreen(display));
+    long screenHeight = DisplayHeight(display, DefaultScreen(display));
+    WindowBounds area;
+    area.x = std::max(0L, bounds.x);
+    area.y = std::max(0L, bounds.y);
+    area.width = std::min(bounds.x + bounds.width, screenWidth) - area.x;
+    area.height = std::min(bounds.y + bounds.height, screenHeight) - area.y;
+    if (area.width <= 0 || area.height <= 0) {
+        return false;
+    }
+
+    XImage* image = state.useShm ? GrabWithShm(state, root, area) : nullptr;
+    if (!image) {
+        image = XGetImage(display, root, area.x, area.y, area.width, area.height, AllPlanes,
+                          ZPixmap);
+    }
+    if (!image) {
+        return false;
+    }
+    if (!IsBgrx(image)) {
+        DebugLog("Capture: unsupported image format (%d bpp)", image->bits_per_pixel);
+        ReleaseImage(state, image);
+        return false;
+    }
+
+    uint32_t width = static_cast<uint32_t>(area.width);
+    uint32_t height = static_cast<uint32_t>(area.height);
+    if (options.maxWidth != 0 && options.maxWidth < width) {
+        height = std::max<uint32_t>(
+            1, static_cast<uint32_t>(static_cast<uint64_t>(height) * options.maxWidth / width));
+        width = options.maxWidth;
+    }
+    uint8_t* pixels = static_cast<uint8_t*>(std::malloc(static_cast<size_t>(width) * height * 4));
+    if (!pixels) {
+        ReleaseImage(state, image);
+        return false;
+    }
+    ScaleBgrxToRgba(reinterpret_cast<uint8_t*>(image->data), image->bytes_per_line,
+                    static_cast<uint32_t>(area.width), static_cast<uint32_t>(area.height), pixels,
+                    width, height);
+    ReleaseImage(state, image);
+
+    result.windowId = window;
+    result.bounds = area;
+    result.width = width;
+    result.height = height;
+    result.pixels = pixels;
+    return true;
+}
+
+#else
+
+bool CaptureActiveWindow(const CaptureOptions&, CapturedImage&) {
+    return false;
+}
+
+#endif  // __linux__
+
+void FreeCapturePixels(uint8_t* pixels) {
+    std::free(pixels);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+#include "active_window.h"
+
+struct CaptureOptions {
+    // Downscale (keeping the aspect ratio) when the window is wider; 0 keeps full size.
+    uint32_t maxWidth = 0;
+    // Window to capture; 0 captures the active window.
+    uint64_t windowId = 0;
+};
+
+struct CapturedImage {
+    uint64_t windowId = 0;
+    WindowBounds bounds;  // captured area in root coordinates, clipped to the screen
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // Tightly packed RGBA, width * height * 4 bytes. Owned by the caller; release with
+    // FreeCapturePixels (the addon hands it to an external ArrayBuffer instead of copying).
+    uint8_t* pixels = nullptr;
+};
+
+// Grabs what is on screen over the window (X11: XShmGetImage into a shared-memory segment
+// reused across calls, plain XGetImage when the server cannot share memory). Safe to call
+// from any thread; captures are serialized.
+bool CaptureActiveWindow(const CaptureOptions& options, CapturedImage& image);
+void FreeCapturePixels(uint8_t* pixels);
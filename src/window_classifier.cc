@@ -0,0 +1,161 @@
+#include "window_classifier.h"
+
+#include "debug_log.h"
+
+namespace {
+
+// The DFA behind a large set can outgrow RE2's 8 MB default; past the budget RE2 fails
+// the match instead of backtracking, so give hundreds of rules some room.
+const int64_t kSetMaxMem = 64 << 20;
+
+const char* const kFieldNames[] = {"processName", "title", "url"};
+
+const char* MatchErrorName(RE2::Set::ErrorKind kind) {
+    switch (kind) {
+        case RE2::Set::kOutOfMemory:
+            return "out of memory";
+        case RE2::Set::kNotCompiled:
+            return "not compiled";
+        case RE2::Set::kInconsistent:
+            return "inconsistent result";
+        default:
+            return "unknown error";
+    }
+}
+
+}  // namespace
+
+WindowClassifier::WindowClassifier(size_t cacheSize) : cacheSize_(cacheSize) {}
+
+WindowClassifier::~WindowClassifier() = default;
+
+bool WindowClassifier::Compile(const std::vector<ClassifierRule>& rules, std::string& error) {
+    RE2::Options options;
+    options.set_never_capture(true);
+    options.set_log_errors(false);
+    options.set_max_mem(kSetMaxMem);
+
+    std::unique_ptr<RE2::Set> sets[kFieldCount];
+    std::vector<int> setRules[kFieldCount];
+    std::vector<uint8_t> requiredFields(rules.size(), 0);
+    for (int field = 0; field < kFieldCount; ++field) {
+        sets[field] = std::make_unique<RE2::Set>(options, RE2::UNANCHORED);
+    }
+
+    for (size_t i = 0; i < rules.size(); ++i) {
+        const std::string* patterns[kFieldCount] = {&rules[i].processName, &rules[i].title,
+                                                    &rules[i].url};
+        for (int field = 0; field < kFieldCount; ++field) {
+            if (patterns[field]->empty()) {
+                continue;
+            }
+            // Options are per set, so case folding is switched on per pattern.
+            std::string pattern =
+                rules[i].caseInsensitive ? "(?i:" + *patterns[field] + ")" : *patterns[field];
+            std::string message;
+            if (sets[field]->Add(pattern, &message) < 0) {
+                error = "rule " + std::to_string(i) + " " + kFieldNames[field] + ": " + message;
+                return false;
+            }
+            setRules[field].push_back(static_cast<int>(i));
+            requiredFields[i] |= static_cast<uint8_t>(1u << field);
+        }
+    }
+    for (int field = 0; field < kFieldCount; ++field) {
+        if (setRules[field].empty()) {
+            sets[field].reset();
+        } else if (!sets[field]->Compile()) {
+            error = std::string("out of memory compiling ") + kFieldNames[field] + " patterns";
+            return false;
+        }
+    }
+    // The DFA is built on first use; a set whose automaton cannot start within kSetMaxMem
+    // fails every match, so find out now rather than on each window.
+    for (int field = 0; field < kFieldCount; ++field) {
+        RE2::Set::ErrorInfo info;
+        if (sets[field] && !sets[field]->Match("", nullptr, &info) &&
+            info.kind == RE2::Set::kOutOfMemory) {
+            error = std::string(kFieldNames[field]) + " patterns need more than " +
+                    std::to_string(kSetMaxMem >> 20) + " MB of automaton memory";
+            return false;
+        }
+    }
+
+    for (int field = 0; field < kFieldCount; ++field) {
+        sets_[field] = std::move(sets[field]);
+        setRules_[field] = std::move(setRules[field]);
+    }
+    requiredFields_ = std::move(requiredFields);
+    lru_.clear();
+    cache_.clear();
+    DebugLog("Classifier compiled %zu rules", rules.size());
+    return true;
+}
+
+bool WindowClassifier::Match(const std::string* fields[kFieldCount], int& rule,
+                             std::string& error) const {
+    std::vector<uint8_t> matched(requiredFields_.size(), 0);
+    std::vector<int> hits;
+    for (int field = 0; field < kFieldCount; ++field) {
+        if (!sets_[field]) {
+            continue;
+        }
+        hits.clear();
+        RE2::Set::ErrorInfo info;
+        if (!sets_[field]->Match(*fields[field], &hits, &info) &&
+            info.kind != RE2::Set::kNoError) {
+            // A partial answer could pick a later rule than the right one.
+            error = std::string(kFieldNames[field]) + " match failed: " + MatchErrorName(info.kind);
+            DebugLog("Classifier %s", error.c_str());
+            return false;
+        }
+        for (int hit : hits) {
+            int rule = setRules_[field][hit];
+            matched[rule] |= static_cast<uint8_t>(1u << field);
+        }
+    }
+    rule = -1;
+    for (size_t i = 0; i < requiredFields_.size(); ++i) {
+        if (matched[i] == requiredFields_[i]) {
+            rule = static_cast<int>(i);
+            break;
+        }
+    }
+    return true;
+}
+
+int WindowClassifier::Classify(const std::string& processName, const std::string& title,
+                               const std::string& url) {
+    ++stats_.lookups;
+    std::string key;
+    key.reserve(processName.size() + title.size() + url.size() + 2);
+    key.append(processName).push_back('\0');
+    key.append(title).push_back('\0');
+    key.append(url);
+
+    auto it = cache_.find(key);
+    if (it != cache_.end()) {
+        ++stats_.cacheHits;
+        lru_.splice(lru_.begin(), lru_, it->second.recent);
+        return it->second.rule;
+    }
+
+    const std::string* fields[kFieldCount] = {&processName, &title, &url};
+    int rule = -1;
+    if (!Match(fields, rule, lastError_)) {
+        ++stats_.matchErrors;
+        return kMatchFailed;
+    }
+    if (cacheSize_ == 0) {
+        return rule;
+    }
+    if (cache_.size() >= cacheSize_) {
+        cache_.erase(*lru_.back());
+        lru_.pop_back();
+    }
+    auto inserted = cache_.emplace(std::move(key), CacheEntry()).first;
+    lru_.push_front(&inserted->first);
+    inserted->second.rule = rule;
+    inserted->second.recent = lru_.begin();
+    return rule;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <re2/set.h>
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// RE2 syntax, unanchored. A rule matches when every non-empty pattern matches its field;
+// a rule without patterns matches everything (a catch-all placed last).
+struct ClassifierRule {
+    std::string processName;
+    std::string title;
+    std::string url;
+    bool caseInsensitive = false;
+};
+
+struct ClassifierStats {
+    uint64_t lookups = 0;
+    uint64_t cacheHits = 0;
+    uint64_t matchErrors = 0;
+};
+
+// Assigns windows to the first matching rule. All patterns on one field are compiled into
+// a single RE2::Set, so a window costs one linear-time pass per field however many rules
+// there are, and no pattern can backtrack. Results are cached per (process, title, url)
+// in an LRU, so an unchanged window costs one hash lookup. Not thread-safe.
+class WindowClassifier {
+   public:
+    explicit WindowClassifier(size_t cacheSize = 4096);
+    ~WindowClassifier();
+
+    static const int kMatchFailed = -2;
+
+    // Replaces the rule set and clears the cache. On failure error names the rule and the
+    // RE2 message (or the field whose automaton does not fit the memory budget), and the
+    // previous rules stay in effect.
+    bool Compile(const std::vector<ClassifierRule>& rules, std::string& error);
+
+    // Index of the first matching rule, -1 when none matches, or kMatchFailed when RE2 gave
+    // up on a field (see lastError()). Failures are not cached.
+    int Classify(const std::string& processName, const std::string& title,
+                 const std::string& url);
+
+    size_t ruleCount() const { return requiredFields_.size(); }
+    const ClassifierStats& stats() const { return stats_; }
+    const std::string& lastError() const { return lastError_; }
+
+   private:
+    static const int kFieldCount = 3;
+
+    // False when a set failed to match; error then says which and why.
+    bool Match(const std::string* fields[kFieldCount], int& rule, std::string& error) const;
+
+    size_t cacheSize_;
+    std::unique_ptr<RE2::Set> sets_[kFieldCount];
+    // Set entry -> rule index, per field.
+    std::vector<int> setRules_[kFieldCount];
+    // Bit i set when the rule has a pattern on field i.
+    std::vector<uint8_t> requiredFields_;
+
+    struct CacheEntry {
+        int rule = -1;
+        std::list<const std::string*>::iterator recent;
+    };
+    // Most recent first; points at the map's keys, which never move.
+    std::list<const std::string*> lru_;
+    std::unordered_map<std::string, CacheEntry> cache_;
+    ClassifierStats stats_;
+    std::string lastError_;
+};
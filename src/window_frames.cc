@@ -0,0 +1,26 @@
+#include "window_frames.h"
+
+NodeRef WindowFrameCache::Find(uint64_t windowId) const {
+    auto found = frames_.find(windowId);
+    return found == frames_.end() ? NodeRef() : found->second.Share();
+}
+
+void WindowFrameCache::Put(uint64_t windowId, AccessibleTree::Node frame) {
+    if (!frame) {
+        return;
+    }
+    if (frames_.size() >= capacity_ && frames_.count(windowId) == 0) {
+        frames_.clear();
+    }
+    frames_[windowId] = NodeRef(&tree_, tree_.Ref(frame));
+}
+
+void WindowFrameCache::Forget(AccessibleTree::Node frame) {
+    for (auto it = frames_.begin(); it != frames_.end();) {
+        if (it->second.get() == frame) {
+            it = frames_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+#include "accessible_tree.h"
+
+// Window id -> the accessible frame the URL search matched for that window, so a browser
+// with several top-level windows is not matched again on every poll. Entries are checked
+// by the caller before use and dropped when their frame is destroyed. Holds one reference
+// per frame; at most capacity entries. Not thread-safe.
+class WindowFrameCache {
+   public:
+    explicit WindowFrameCache(AccessibleTree& tree, size_t capacity = 64)
+        : tree_(tree), capacity_(capacity) {}
+
+    WindowFrameCache(const WindowFrameCache&) = delete;
+    WindowFrameCache& operator=(const WindowFrameCache&) = delete;
+
+    // A new reference to windowId's frame; null when none is remembered.
+    NodeRef Find(uint64_t windowId) const;
+    void Put(uint64_t windowId, AccessibleTree::Node frame);
+    void Remove(uint64_t windowId) { frames_.erase(windowId); }
+    // Drops every window matched to frame (an AT-SPI window:destroy).
+    void Forget(AccessibleTree::Node frame);
+
+   private:
+    AccessibleTree& tree_;
+    size_t capacity_;
+    std::unordered_map<uint64_t, NodeRef> frames_;
+};
@@ -0,0 +1,323 @@
+#include "window_icon.h"
+
+#ifdef __linux__
+
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "debug_log.h"
+#include "pixel_kernels.h"
+#include "x11_util.h"
+
+namespace {
+
+const size_t kCacheEntries = 64;
+const size_t kKnownWindows = 256;
+const long kChunkItems = 16384;  // 64 KiB of pixels per request
+const uint64_t kMaxIconSide = 1024;
+const int kMaxImages = 32;
+// An application can set its icon after mapping its first window.
+const int64_t kMissRetryMs = 5000;
+
+struct CachedIcon {
+    bool found = false;
+    int64_t fetchedMs = 0;
+    WindowIcon icon;
+    std::list<const std::string*>::iterator recent;
+};
+
+// One connection for the process, like window capture's.
+struct IconState {
+    std::mutex mutex;
+    Display* display = nullptr;
+    bool opened = false;
+    Atom iconAtom = 0;
+    // Window -> the application part of its cache key, so a window seen before costs no
+    // X call at all. Entries go when the window is destroyed, since X reuses window ids.
+    std::unordered_map<uint64_t, std::string> windowKeys;
+    // Most recent first; points at the map's keys, which never move.
+    std::list<const std::string*> lru;
+    std::unordered_map<std::string, CachedIcon> cache;
+};
+
+IconState& SharedIconState() {
+    static IconState* state = new IconState();
+    return *state;
+}
+
+int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+bool OpenIconDisplay(IconState& state) {
+    if (state.opened) {
+        return state.display != nullptr;
+    }
+    state.opened = true;
+    state.display = XOpenDisplay(nullptr);
+    if (!state.display) {
+        DebugLog("Icons: cannot open display");
+        return false;
+    }
+    InstallNonFatalXErrorHandler(state.display);
+    state.iconAtom = CachedAtom(state.display, "_NET_WM_ICON");
+    return true;
+}
+
+std::string ExePath(pid_t pid) {
+    char buffer[4096];
+    std::string link = "/proc/" + std::to_string(pid) + "/exe";
+    ssize_t length = readlink(link.c_str(), buffer, sizeof(buffer) - 1);
+    return length > 0 ? std::string(buffer, static_cast<size_t>(length)) : std::string();
+}
+
+// Reads the DestroyNotify events of the windows WindowKey selected them on. XPending only
+// takes what has already arrived, so this costs no round trip; a destroyed id's event is
+// always in before anything about the window that reuses the id.
+void ForgetDestroyedWindows(IconState& state) {
+    while (XPending(state.display) > 0) {
+        XEvent event;
+        XNextEvent(state.display, &event);
+        if (event.type != DestroyNotify) {
+            continue;
+        }
+        auto known = state.windowKeys.find(event.xdestroywindow.window);
+        if (known == state.windowKeys.end()) {
+            continue;
+        }
+        // A key made from the window id alone names no application that outlives it.
+        if (known->second.compare(0, 7, "window:") == 0) {
+            for (auto it = state.cache.begin(); it != state.cache.end();) {
+                if (it->first.compare(0, known->second.size(), known->second) == 0) {
+                    state.lru.erase(it->second.recent);
+                    it = state.cache.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        state.windowKeys.erase(known);
+    }
+}
+
+// Executable and WM_CLASS: windows of one application share an icon, except where one
+// executable runs several (browser web apps get their own WM_CLASS).
+const std::string& WindowKey(IconState& state, Window window) {
+    ForgetDestroyedWindows(state);
+    auto known = state.windowKeys.find(window);
+    if (known != state.windowKeys.end()) {
+        return known->second;
+    }
+    pid_t pid = 0;
+    std::string key = QueryWindowPid(state.display, window, pid) ? ExePath(pid) : std::string();
+    if (key.empty()) {
+        key = "window:" + std::to_string(window);
+    }
+    std::string instance;
+    std::string className;
+    ReadWmClass(state.display, window, instance, className);
+    key.append(1, '\0').append(instance).append(1, '\0').append(className).append(1, '\0');
+    if (state.windowKeys.size() >= kKnownWindows) {
+        state.windowKeys.clear();
+    }
+    // Our own connection, so the mask is not shared with anyone. Windows dropped by the
+    // clear above keep theirs; their events are read and ignored.
+    XSelectInput(state.display, window, StructureNotifyMask);
+    return state.windowKeys.emplace(window, std::move(key)).first->second;
+}
+
+// Reads up to count 32-bit items of _NET_WM_ICON from offset (in items), handing them to
+// consume as Xlib returns them (one per long); remaining gets the items after them.
+template <typename Consume>
+bool ReadIconItems(IconState& state, Window window, long offset, long count,
+                   unsigned long& remaining, Consume consume) {
+    Atom actualType;
+    int actualFormat;
+    unsigned long itemCount = 0;
+    unsigned long bytesAfter = 0;
+    unsigned char* data = nullptr;
+    if (XGetWindowProperty(state.display, window, state.iconAtom, offset, count, False,
+                           XA_CARDINAL, &actualType, &actualFormat, &itemCount, &bytesAfter,
+                           &data) != Success ||
+        !data || itemCount == 0 || actualFormat != 32) {
+        if (data) {
+            XFree(data);
+        }
+        return false;
+    }
+    remaining = bytesAfter / 4;
+    consume(reinterpret_cast<const unsigned long*>(data), static_cast<size_t>(itemCount));
+    XFree(data);
+    return true;
+}
+
+struct IconImage {
+    long offset = 0;  // of the first pixel, in items
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+// The property holds width, height, pixels, repeated per size. Only the headers are read
+// here: the offsets follow from the sizes.
+std::vector<IconImage> ReadIconImages(IconState& state, Window window) {
+    std::vector<IconImage> images;
+    long offset = 0;
+    for (int i = 0; i < kMaxImages; ++i) {
+        unsigned long header[2] = {0, 0};
+        size_t read = 0;
+        unsigned long remaining = 0;
+        if (!ReadIconItems(state, window, offset, 2, remaining,
+                           [&](const unsigned long* items, size_t count) {
+                               read = std::min<size_t>(count, 2);
+                               std::copy(items, items + read, header);
+                           }) ||
+            read < 2) {
+            break;
+        }
+        uint64_t width = header[0] & 0xFFFFFFFFu;
+        uint64_t height = header[1] & 0xFFFFFFFFu;
+        if (width == 0 || height == 0 || width > kMaxIconSide || height > kMaxIconSide ||
+            width * height > remaining) {
+            break;
+        }
+        images.push_back(IconImage{offset + 2, static_cast<uint32_t>(width),
+                                   static_cast<uint32_t>(height)});
+        offset += 2 + static_cast<long>(width * height);
+        if (width * height == remaining) {
+            break;
+        }
+    }
+    return images;
+}
+
+// The smallest image covering size x size, else the largest.
+const IconImage* PickImage(const std::vector<IconImage>& images, uint32_t size) {
+    const IconImage* best = nullptr;
+    for (const IconImage& image : images) {
+        uint32_t side = std::min(image.width, image.height);
+        uint64_t area = static_cast<uint64_t>(image.width) * image.height;
+        if (!best) {
+            best = &image;
+            continue;
+        }
+        uint32_t bestSide = std::min(best->width, best->height);
+        uint64_t bestArea = static_cast<uint64_t>(best->width) * best->height;
+        bool covers = side >= size;
+        bool bestCovers = bestSide >= size;
+        if (covers ? (!bestCovers || area < bestArea) : (!bestCovers && area > bestArea)) {
+            best = &image;
+        }
+    }
+    return best;
+}
+
+bool FetchIcon(IconState& state, Window window, uint32_t size, WindowIcon& icon) {
+    std::vector<IconImage> images = ReadIconImages(state, window);
+    const IconImage* image = PickImage(images, size);
+    if (!image) {
+        return false;
+    }
+
+    // Pixels stream in chunks straight into RGBA; no copy of the whole property is made.
+    size_t total = static_cast<size_t>(image->width) * image->height;
+    std::vector<uint8_t> rgba(total * 4);
+    size_t done = 0;
+    while (done < total) {
+        long count = static_cast<long>(std::min<size_t>(kChunkItems, total - done));
+        size_t converted = 0;
+        unsigned long remaining = 0;
+        if (!ReadIconItems(state, window, image->offset + static_cast<long>(done), count,
+                           remaining, [&](const unsigned long* items, size_t itemCount) {
+                               converted = std::min(itemCount, total - done);
+                               ArgbCardinalsToRgba(items, rgba.data() + done * 4, converted);
+                           }) ||
+            converted == 0) {
+            DebugLog("Icons: _NET_WM_ICON of 0x%lx changed while being read", window);
+            return false;
+        }
+        done += converted;
+    }
+
+    uint32_t width = size;
+    uint32_t height = size;
+    if (image->width >= image->height) {
+        height = std::max<uint32_t>(
+            1, static_cast<uint32_t>(static_cast<uint64_t>(image->height) * size / image->width));
+    } else {
+        width = std::max<uint32_t>(
+            1, static_cast<uint32_t>(static_cast<uint64_t>(image->width) * size / image->height));
+    }
+    icon.width = width;
+    icon.height = height;
+    if (width == image->width && height == image->height) {
+        icon.pixels = std::move(rgba);
+        return true;
+    }
+    PremultiplyRgba(rgba.data(), total);
+    icon.pixels.assign(static_cast<size_t>(width) * height * 4, 0);
+    ScaleRgba(rgba.data(), static_cast<size_t>(image->width) * 4, image->width, image->height,
+              icon.pixels.data(), width, height);
+    UnpremultiplyRgba(icon.pixels.data(), static_cast<size_t>(width) * height);
+    return true;
+}
+
+CachedIcon& Remember(IconState& state, const std::string& key) {
+    auto found = state.cache.find(key);
+    if (found != state.cache.end()) {
+        state.lru.splice(state.lru.begin(), state.lru, found->second.recent);
+        return found->second;
+    }
+    if (state.cache.size() >= kCacheEntries) {
+        state.cache.erase(*state.lru.back());
+        state.lru.pop_back();
+    }
+    auto inserted = state.cache.emplace(key, CachedIcon()).first;
+    state.lru.push_front(&inserted->first);
+    inserted->second.recent = state.lru.begin();
+    return inserted->second;
+}
+
+}  // namespace
+
+bool GetWindowIcon(uint64_t windowId, uint32_t size, WindowIcon& icon) {
+    IconState& state = SharedIconState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!OpenIconDisplay(state) || size == 0) {
+        return false;
+    }
+    Window window = windowId ? static_cast<Window>(windowId) : QueryActiveWindow(state.display);
+    if (!window) {
+        return false;
+    }
+
+    std::string key = WindowKey(state, window) + std::to_string(size);
+    bool cached = state.cache.count(key) != 0;
+    CachedIcon& entry = Remember(state, key);
+    int64_t now = NowMs();
+    if (cached && (entry.found || now - entry.fetchedMs < kMissRetryMs)) {
+        icon = entry.icon;
+        return entry.found;
+    }
+    entry.found = FetchIcon(state, window, size, entry.icon);
+    entry.fetchedMs = now;
+    icon = entry.icon;
+    return entry.found;
+}
+
+#else
+
+bool GetWindowIcon(uint64_t, uint32_t, WindowIcon&) {
+    return false;
+}
+
+#endif  // __linux__
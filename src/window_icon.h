@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct WindowIcon {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> pixels;  // straight RGBA, width * height * 4 bytes
+};
+
+// The window's _NET_WM_ICON scaled to fit size x size (aspect kept): the smallest image
+// at least that large, else the largest. windowId 0 means the active window. Icons are
+// cached per (executable, WM_CLASS, size) in an LRU, so a window of an application seen
+// before costs two property reads; a miss reads only the image headers and then the chosen
+// image in chunks. False when the window has no icon. Linux; safe to call from any thread.
+bool GetWindowIcon(uint64_t windowId, uint32_t size, WindowIcon& icon);
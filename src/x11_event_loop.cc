@@ -0,0 +1,246 @@
+#include "x11_event_loop.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <future>
+
+#include "debug_log.h"
+#include "x11_util.h"
+
+X11EventLoop& X11EventLoop::Get() {
+    // Leaked on purpose: the thread may still be blocked in poll() during static teardown.
+    static X11EventLoop* loop = new X11EventLoop();
+    return *loop;
+}
+
+bool X11EventLoop::Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_.load()) {
+        return true;
+    }
+    display_ = XOpenDisplay(nullptr);
+    if (!display_) {
+        DebugLog("Event loop could not open the X display");
+        return false;
+    }
+    wakeFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeFd_ < 0) {
+        XCloseDisplay(display_);
+        display_ = nullptr;
+        return false;
+    }
+    InstallNonFatalXErrorHandler(display_);
+    quit_ = false;
+    threadExited_.store(false);
+    running_.store(true);
+    thread_ = std::thread(&X11EventLoop::ThreadMain, this);
+    return true;
+}
+
+void X11EventLoop::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_.load()) {
+            return;
+        }
+        quit_ = true;
+    }
+    Wake();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.clear();
+    handlers_.clear();
+    inputMasks_.clear();
+    close(wakeFd_);
+    wakeFd_ = -1;
+    ForgetDisplayAtoms(display_);
+    ReleaseNonFatalXErrorHandler(display_);
+    XCloseDisplay(display_);
+    display_ = nullptr;
+    running_.store(false);
+}
+
+void X11EventLoop::Wake() {
+    uint64_t one = 1;
+    if (wakeFd_ >= 0) {
+        ssize_t written = write(wakeFd_, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+void X11EventLoop::Post(std::function<void(Display*)> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_.load()) {
+            return;
+        }
+        tasks_.push_back(std::move(task));
+    }
+    Wake();
+}
+
+bool X11EventLoop::Run(std::function<void(Display*)> task) {
+    if (!running_.load() || threadExited_.load()) {
+        return false;
+    }
+    if (std::this_thread::get_id() == thread_.get_id()) {
+        task(display_);
+        return true;
+    }
+    auto done = std::make_shared<std::promise<void>>();
+    std::future<void> finished = done->get_future();
+    Post([task = std::move(task), done](Display* display) {
+        task(display);
+        done->set_value();
+    });
+    // A task queued while the loop shuts down is dropped; do not wait forever for it.
+    while (finished.wait_for(std::chrono::milliseconds(200)) != std::future_status::ready) {
+        if (!running_.load() || threadExited_.load()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void X11EventLoop::AddHandler(Handler* handler, std::function<void(Display*)> attach) {
+    Run([this, handler, attach = std::move(attach)](Display* display) {
+        if (attach) {
+            attach(display);
+        }
+        handlers_.push_back(handler);
+        XFlush(display);
+    });
+}
+
+void X11EventLoop::RemoveHandler(Handler* handler, std::function<void(Display*)> detach) {
+    Run([this, handler, detach = std::move(detach)](Display* display) {
+        handlers_.erase(std::remove(handlers_.begin(), handlers_.end(), handler),
+                        handlers_.end());
+        if (detach) {
+            detach(display);
+        }
+        XFlush(display);
+    });
+}
+
+void X11EventLoop::AddInputMask(Display* display, Window window, long mask) {
+    if (window == None) {
+        return;
+    }
+    auto& masks = inputMasks_[window];
+    long combined = 0;
+    for (long bit = 1; bit != 0 && bit <= mask; bit <<= 1) {
+        if (mask & bit) {
+            ++masks[bit];
+        }
+    }
+    for (const auto& entry : masks) {
+        combined |= entry.first;
+    }
+    XSelectInput(display, window, combined);
+}
+
+void X11EventLoop::RemoveInputMask(Display* display, Window window, long mask) {
+    auto it = inputMasks_.find(window);
+    if (it == inputMasks_.end()) {
+        return;
+    }
+    auto& masks = it->second;
+    long combined = 0;
+    for (long bit = 1; bit != 0 && bit <= mask; bit <<= 1) {
+        auto bitIt = masks.find(bit);
+        if ((mask & bit) && bitIt != masks.end() && --bitIt->second <= 0) {
+            masks.erase(bitIt);
+        }
+    }
+    for (const auto& entry : masks) {
+        combined |= entry.first;
+    }
+    if (masks.empty()) {
+        inputMasks_.erase(it);
+    }
+    XSelectInput(display, window, combined);
+}
+
+void X11EventLoop::DrainTasks() {
+    std::vector<std::function<void(Display*)>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks.swap(tasks_);
+    }
+    for (auto& task : tasks) {
+        task(display_);
+    }
+}
+
+void X11EventLoop::DispatchPendingEvents() {
+    while (XPending(display_) > 0) {
+        XEvent event;
+        XNextEvent(display_, &event);
+        // Copy: a handler may detach itself (and others) while handling an event.
+        std::vector<Handler*> handlers = handlers_;
+        for (Handler* handler : handlers) {
+            if (std::find(handlers_.begin(), handlers_.end(), handler) != handlers_.end()) {
+                handler->OnEvent(display_, event);
+            }
+        }
+    }
+}
+
+void X11EventLoop::ThreadMain() {
+    DebugLog("X11 event loop started");
+    int xfd = ConnectionNumber(display_);
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (quit_) {
+                break;
+            }
+        }
+        DrainTasks();
+        DispatchPendingEvents();
+        XFlush(display_);
+
+        int timeoutMs = -1;
+        for (Handler* handler : handlers_) {
+            int64_t next = handler->NextTimerMs();
+            if (next >= 0 && (timeoutMs < 0 || next < timeoutMs)) {
+                timeoutMs = static_cast<int>(std::min<int64_t>(next, 60 * 60 * 1000));
+            }
+        }
+
+        if (timeoutMs != 0) {
+            pollfd fds[2] = {{xfd, POLLIN, 0}, {wakeFd_, POLLIN, 0}};
+            int ready = poll(fds, 2, timeoutMs);
+            if (ready < 0 && errno != EINTR) {
+                DebugLog("X11 event loop poll failed (errno %d)", errno);
+                break;
+            }
+            if (fds[1].revents & POLLIN) {
+                uint64_t counter = 0;
+                ssize_t drained = read(wakeFd_, &counter, sizeof(counter));
+                (void)drained;
+            }
+            if (fds[0].revents & (POLLERR | POLLHUP)) {
+                DebugLog("X11 event loop lost its display connection");
+                break;
+            }
+        }
+
+        std::vector<Handler*> handlers = handlers_;
+        for (Handler* handler : handlers) {
+            if (handler->NextTimerMs() == 0) {
+                handler->OnTimer(display_);
+            }
+        }
+    }
+    threadExited_.store(true);
+    DebugLog("X11 event loop stopped");
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <X11/Xlib.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Background thread that owns a dedicated X connection and dispatches its events. Modules
+// that want push notifications from the X server (idle alarms, window geometry, damage)
+// register a Handler instead of polling from the JS thread. Every Handler callback and
+// every posted task runs on the loop thread, so handlers never need their own locking
+// for X calls.
+class X11EventLoop {
+   public:
+    class Handler {
+       public:
+        virtual ~Handler() = default;
+        // Called for every event read from the connection; ignore unrelated ones.
+        virtual void OnEvent(Display* display, XEvent& event) = 0;
+        // Milliseconds until the handler wants OnTimer, or -1 for no timer.
+        virtual int64_t NextTimerMs() { return -1; }
+        virtual void OnTimer(Display*) {}
+    };
+
+    static X11EventLoop& Get();
+
+    // Opens the connection and starts the thread if needed. Returns false without a display.
+    bool Start();
+    bool running() const { return running_.load() && !threadExited_.load(); }
+
+    // Handlers are attached and detached on the loop thread; AddHandler runs `attach` there
+    // before the handler starts receiving events.
+    void AddHandler(Handler* handler, std::function<void(Display*)> attach = nullptr);
+    // Blocks until the handler is detached, so it may be destroyed right after.
+    void RemoveHandler(Handler* handler, std::function<void(Display*)> detach = nullptr);
+
+    // Input masks on the loop connection are per window, so handlers that watch the same
+    // window must merge their masks instead of calling XSelectInput directly. Loop thread only.
+    void AddInputMask(Display* display, Window window, long mask);
+    void RemoveInputMask(Display* display, Window window, long mask);
+
+    // Runs task on the loop thread. Post returns immediately; Run waits for completion.
+    void Post(std::function<void(Display*)> task);
+    bool Run(std::function<void(Display*)> task);
+
+    void Stop();
+
+   private:
+    X11EventLoop() = default;
+    X11EventLoop(const X11EventLoop&) = delete;
+    X11EventLoop& operator=(const X11EventLoop&) = delete;
+
+    void ThreadMain();
+    void Wake();
+    void DrainTasks();
+    void DispatchPendingEvents();
+
+    std::mutex mutex_;
+    std::vector<std::function<void(Display*)>> tasks_;
+    // Only touched on the loop thread.
+    std::vector<Handler*> handlers_;
+    std::map<Window, std::map<long, int>> inputMasks_;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> threadExited_{false};
+    bool quit_ = false;
+    Display* display_ = nullptr;
+    int wakeFd_ = -1;
+};
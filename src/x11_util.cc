@@ -0,0 +1,255 @@
+#include "x11_util.h"
+
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "debug_log.h"
+
+namespace {
+
+// XSetErrorHandler is process-wide, but the host (or another native module) may have
+// connections of its own; their errors go to whatever handler was installed before ours.
+std::mutex gOwnedMutex;
+std::unordered_set<Display*> gOwnedDisplays;
+std::atomic<XErrorHandler> gPreviousHandler{nullptr};
+std::once_flag gHandlerInstalled;
+
+int NonFatalXErrorHandler(Display* display, XErrorEvent* error) {
+    bool owned;
+    {
+        std::lock_guard<std::mutex> lock(gOwnedMutex);
+        owned = gOwnedDisplays.count(display) != 0;
+    }
+    if (!owned) {
+        XErrorHandler previous = gPreviousHandler.load();
+        return previous ? previous(display, error) : 0;
+    }
+    char text[128] = {0};
+    XGetErrorText(display, error->error_code, text, sizeof(text));
+    // Windows vanish between events and the requests that react to them; the default
+    // handler would terminate the host process for an ordinary BadWindow.
+    DebugLog("X error %d (%s) for request %d on resource 0x%lx", error->error_code, text,
+             error->request_code, error->resourceid);
+    return 0;
+}
+
+// Atoms are per server; key the cache by connection so sessions on different displays
+// never share ids. Interning with only_if_exists=False keeps the result cacheable.
+std::mutex gAtomMutex;
+std::unordered_map<Display*, std::unordered_map<std::string, Atom>> gAtomCache;
+
+}  // namespace
+
+void InstallNonFatalXErrorHandler(Display* display) {
+    {
+        std::lock_guard<std::mutex> lock(gOwnedMutex);
+        gOwnedDisplays.insert(display);
+    }
+    // Never under gOwnedMutex: the handler takes it while Xlib holds its own locks.
+    std::call_once(gHandlerInstalled,
+                   []() { gPreviousHandler.store(XSetErrorHandler(NonFatalXErrorHandler)); });
+}
+
+void ReleaseNonFatalXErrorHandler(Display* display) {
+    std::lock_guard<std::mutex> lock(gOwnedMutex);
+    gOwnedDisplays.erase(display);
+}
+
+Atom CachedAtom(Display* display, const char* name) {
+    std::lock_guard<std::mutex> lock(gAtomMutex);
+    auto& atoms = gAtomCache[display];
+    auto it = atoms.find(name);
+    if (it != atoms.end()) {
+        return it->second;
+    }
+    Atom atom = XInternAtom(display, name, False);
+    atoms.emplace(name, atom);
+    return atom;
+}
+
+void ForgetDisplayAtoms(Display* display) {
+    std::lock_guard<std::mutex> lock(gAtomMutex);
+    gAtomCache.erase(display);
+}
+
+Window QueryActiveWindow(Display* display) {
+    Atom activeAtom = CachedAtom(display, "_NET_ACTIVE_WINDOW");
+    if (activeAtom == None) {
+        return 0;
+    }
+    Atom actualType;
+    int actualFormat;
+    unsigned long itemCount = 0;
+    unsigned long bytesLeft = 0;
+    unsigned char* data = nullptr;
+    if (XGetWindowProperty(display, DefaultRootWindow(display), activeAtom, 0, (~0L), False,
+                           AnyPropertyType, &actualType, &actualFormat, &itemCount, &bytesLeft,
+                           &data) != Success ||
+        !data || itemCount == 0) {
+        if (data) {
+            XFree(data);
+        }
+        return 0;
+    }
+    Window window = 0;
+    if (actualFormat == 32) {
+        window = reinterpret_cast<unsigned long*>(data)[0];
+    }
+    XFree(data);
+    return window;
+}
+
+bool QueryWindowPid(Display* display, Window window, pid_t& pid) {
+    Atom pidAtom = CachedAtom(display, "_NET_WM_PID");
+    if (pidAtom == None) {
+        return false;
+    }
+    Atom actualType;
+    int actualFormat;
+    unsigned long itemCount = 0;
+    unsigned long bytesLeft = 0;
+    unsigned char* data = nullptr;
+    if (XGetWindowProperty(display, window, pidAtom, 0, 1, False, XA_CARDINAL, &actualType,
+                           &actualFormat, &itemCount, &bytesLeft, &data) != Success ||
+        !data || itemCount == 0 || actualFormat != 32) {
+        if (data) {
+            XFree(data);
+        }
+        return false;
+    }
+    pid = static_cast<pid_t>(reinterpret_cast<unsigned long*>(data)[0]);
+    XFree(data);
+    return pid > 0;
+}
+
+std::string ReadUtf8Property(Display* display, Window window, const char* name) {
+    Atom property = CachedAtom(display, name);
+    if (property == None) {
+        return std::string();
+    }
+    Atom utf8Type = CachedAtom(display, "UTF8_STRING");
+    Atom actualType;
+    int actualFormat;
+    unsigned long itemCount = 0;
+    unsigned long bytesLeft = 0;
+    unsigned char* data = nullptr;
+    if (XGetWindowProperty(display, window, property, 0, (~0L), False,
+                           utf8Type != None ? utf8Type : AnyPropertyType, &actualType,
+                           &actualFormat, &itemCount, &bytesLeft, &data) != Success ||
+        !data || itemCount == 0) {
+        if (data) {
+            XFree(data);
+        }
+        return std::string();
+    }
+    std::string value(reinterpret_cast<char*>(data), itemCount);
+    XFree(data);
+    return value;
+}
+
+std::string QueryWindowTitle(Display* display, Window window) {
+    std::string title = ReadUtf8Property(display, window, "_NET_WM_NAME");
+    if (!title.empty()) {
+        return title;
+    }
+
+    XTextProperty textProp;
+    if (XGetWMName(display, window, &textProp) != 0 && textProp.value) {
+        std::string fallback(reinterpret_cast<char*>(textProp.value),
+                             textProp.nitems * textProp.format / 8);
+        XFree(textProp.value);
+        return fallback;
+    }
+    return std::string();
+}
+
+WindowBounds ReadWindowBounds(Display* display, Window window) {
+    WindowBounds bounds;
+    XWindowAttributes attributes;
+    if (XGetWindowAttributes(display, window, &attributes) == 0) {
+        return bounds;
+    }
+    bounds.width = attributes.width;
+    bounds.height = attributes.height;
+
+    Window child;
+    int x = 0;
+    int y = 0;
+    if (XTranslateCoordinates(display, window, DefaultRootWindow(display), 0, 0, &x, &y,
+                              &child) != 0) {
+        bounds.x = x;
+        bounds.y = y;
+    } else {
+        bounds.x = attributes.x;
+        bounds.y = attributes.y;
+    }
+    return bounds;
+}
+
+std::string ReadStringProperty(Display* display, Window window, const char* name) {
+    Atom property = CachedAtom(display, name);
+    Atom actualType;
+    int actualFormat;
+    unsigned long itemCount = 0;
+    unsigned long bytesLeft = 0;
+    unsigned char* data = nullptr;
+    if (XGetWindowProperty(display, window, property, 0, (~0L), False, AnyPropertyType,
+                           &actualType, &actualFormat, &itemCount, &bytesLeft, &data) != Success ||
+        !data || itemCount == 0 || actualFormat != 8) {
+        if (data) {
+            XFree(data);
+        }
+        return std::string();
+    }
+    std::string value(reinterpret_cast<char*>(data), itemCount);
+    XFree(data);
+    return value;
+}
+
+bool ReadWmClass(Display* display, Window window, std::string& instance, std::string& className) {
+    std::string value = ReadStringProperty(display, window, "WM_CLASS");
+    if (value.empty()) {
+        return false;
+    }
+    size_t separator = value.find('\0');
+    instance = value.substr(0, separator);
+    className.clear();
+    if (separator != std::string::npos) {
+        className = value.substr(separator + 1);
+        className = className.substr(0, className.find('\0'));
+    }
+    return true;
+}
+
+size_t ReadCardinalProperty(Display* display, Window window, const char* name,
+                            unsigned long* values, size_t maxItems) {
+    Atom property = CachedAtom(display, name);
+    if (property == None || maxItems == 0) {
+        return 0;
+    }
+    Atom actualType;
+    int actualFormat;
+    unsigned long itemCount = 0;
+    unsigned long bytesLeft = 0;
+    unsigned char* data = nullptr;
+    if (XGetWindowProperty(display, window, property, 0, static_cast<long>(maxItems), False,
+                           XA_CARDINAL, &actualType, &actualFormat, &itemCount, &bytesLeft,
+                           &data) != Success ||
+        !data || itemCount == 0 || actualFormat != 32) {
+        if (data) {
+            XFree(data);
+        }
+        return 0;
+    }
+    size_t count = itemCount < maxItems ? itemCount : maxItems;
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = reinterpret_cast<unsigned long*>(data)[i];
+    }
+    XFree(data);
+    return count;
+}
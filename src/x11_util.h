@@ -0,0 +1,56 @@
+#pragma once
+
+#include <X11/Xlib.h>
+#include <sys/types.h>
+
+#include <string>
+
+#include "active_window.h"
+
+// X errors on display are logged instead of terminating the process. The handler is
+// installed once per process; errors on connections the addon did not open are passed to
+// the handler that was installed before it.
+void InstallNonFatalXErrorHandler(Display* display);
+// Must be called before display is closed; Display pointers get reused.
+void ReleaseNonFatalXErrorHandler(Display* display);
+
+// Interns (creating if needed) and caches atoms per connection.
+Atom CachedAtom(Display* display, const char* name);
+// Must be called before a connection is closed; Display pointers get reused.
+void ForgetDisplayAtoms(Display* display);
+
+class DisplayHandle {
+   public:
+    // nullptr opens the display named by $DISPLAY.
+    explicit DisplayHandle(const char* name = nullptr) : display_(XOpenDisplay(name)) {
+        if (display_) {
+            InstallNonFatalXErrorHandler(display_);
+        }
+    }
+    ~DisplayHandle() {
+        if (display_) {
+            ForgetDisplayAtoms(display_);
+            ReleaseNonFatalXErrorHandler(display_);
+            XCloseDisplay(display_);
+        }
+    }
+
+    Display* get() const { return display_; }
+    bool valid() const { return display_ != nullptr; }
+
+   private:
+    Display* display_;
+};
+
+Window QueryActiveWindow(Display* display);
+bool QueryWindowPid(Display* display, Window window, pid_t& pid);
+std::string ReadUtf8Property(Display* display, Window window, const char* name);
+// Any 8-bit property (STRING, UTF8_STRING, ...) as raw bytes.
+std::string ReadStringProperty(Display* display, Window window, const char* name);
+// WM_CLASS's two strings; false when the window has none.
+bool ReadWmClass(Display* display, Window window, std::string& instance, std::string& className);
+std::string QueryWindowTitle(Display* display, Window window);
+WindowBounds ReadWindowBounds(Display* display, Window window);
+// Reads up to maxItems 32-bit CARDINAL values; returns how many were read.
+size_t ReadCardinalProperty(Display* display, Window window, const char* name,
+                            unsigned long* values, size_t maxItems);